@@ -1 +1 @@
-gcc cjson/cjson.c main.c -D CJSON_ENABLE_TIMER -O3 -g -o build/test
+gcc cjson/cjson.c main.c -D CJSON_ENABLE_TIMER -O3 -g -pthread -o build/test
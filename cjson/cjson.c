@@ -1,10 +1,53 @@
+// strtod_l and newlocale, see cjson_strtod.
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include "cjson.h"
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <limits.h>
 #include <string.h>
 #include <ctype.h>
 #include <time.h>
+#include <float.h>
+#include <math.h>
+#include <locale.h>
+
+// Doubles are converted with strtod_l in the "C" locale where it exists, define CJSON_DISABLE_STRTOD_L to use strtod.
+#if (defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__)) && !defined(CJSON_DISABLE_STRTOD_L)
+#define CJSON_STRTOD_L
+#ifdef __APPLE__
+#include <xlocale.h>
+#endif
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define CJSON_SCAN_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CJSON_POSIX
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <errno.h>
+#endif
+
+// Large top-level arrays can be parsed on several POSIX threads, define CJSON_DISABLE_THREADS to always parse serially.
+#if defined(CJSON_POSIX) && !defined(CJSON_DISABLE_THREADS)
+#define CJSON_THREADS
+#include <pthread.h>
+#endif
+
+// Files are memory-mapped instead of read on Linux, define CJSON_DISABLE_MMAP to always read them.
+#if defined(__linux__) && !defined(CJSON_DISABLE_MMAP)
+#define CJSON_MMAP
+#include <sys/mman.h>
+#include <fcntl.h>
+#endif
 
 #ifdef CJSON_ENABLE_TIMER
 #define TIMER_INIT() clock_t timer_start, timer_end; const char* timer_function;
@@ -16,8 +59,48 @@
 #define TIMER_END()
 #endif
 
+// Rounds allocation sizes inside of a document up so that every value stays properly aligned.
+#define CJSON_ALIGN(size) (((size) + 7) & ~(size_t)7)
+#define CJSON_DOCUMENT_MIN_CHUNK 4096
+#define CJSON_DOCUMENT_MAX_CHUNK (1024 * 1024)
+// Objects build a hash index over their keys once they hold this many key-values.
+#define CJSON_INDEX_THRESHOLD 16
+// Arrays keep a contiguous vector of their elements once they hold this many elements.
+#define CJSON_VECTOR_THRESHOLD 8
+// Numbers and identifiers shorter than this are copied into a stack buffer instead of the heap while parsing.
+#define CJSON_SCRATCH_SIZE 64
+
 cjson_settings* global_settings = 0;
 
+// Scanning kernels: each returns a pointer to the first byte in [p, end) that stops the scan, or end.
+typedef const char* (*cjson_scan_fn)(const char* p, const char* end);
+
+// Bitmasks of the structural characters in 64 bytes of input, bit i describes byte i.
+typedef struct {
+	unsigned long long quote;
+	unsigned long long backslash;
+	unsigned long long open; // '[' and '{'
+	unsigned long long close; // ']' and '}'
+	unsigned long long comma;
+	unsigned long long slash;
+	unsigned long long colon;
+	unsigned long long space; // whitespace, see cjson_is_space_table
+	unsigned long long high; // bytes above 0x7F
+} cjson_block;
+
+typedef void (*cjson_classify_fn)(const char* p, cjson_block* block);
+
+typedef struct {
+	cjson_scan_fn spaces; // first byte that is not whitespace
+	cjson_scan_fn string; // first '"' or '\\'
+	cjson_scan_fn structural; // first '"', '[', ']', '{', '}' or '/' (used when skipping over values)
+	cjson_classify_fn classify; // used to split input for parallel parsing and to build structural indexes
+	int claimed; // set by the thread that picks the kernels
+	int initialized;
+} cjson_scanner;
+
+cjson_scanner cjson_scan = { NULL, NULL, NULL, NULL, 0, 0 };
+
 typedef enum {
 	initial_state,
 	in_array,
@@ -35,21 +118,144 @@ typedef struct __cjson_state {
 	cjson_value* wip_value;
 	cjson_state_type type;
 	int parse_flags;
+	// Projection only (see cjson_parse_projected): the paths whose first depth steps led to this container, depth is
+	// -1 when the container is kept whole. elements counts all elements of an array, including the skipped ones.
+	unsigned long long paths;
+	int depth;
+	size_t elements;
 } cjson_state;
 
 
 
+// A key interned into a document, every key-value of the document with this key points at key. The hashes are kept
+// so that object indexes do not have to compute them again.
+typedef struct {
+	unsigned int hash; // see cjson_hash_key
+	unsigned int ihash;
+	size_t len;
+	char key[];
+} cjson_interned_key;
+
+// Open-addressing hash table over the interned keys of a document, keyed by their hash.
+typedef struct {
+	size_t capacity; // power of two
+	size_t used;
+	cjson_interned_key* slots[];
+} cjson_key_table;
+
+typedef struct __cjson_chunk {
+	struct __cjson_chunk* next;
+	size_t size; // usable bytes following the header
+	size_t used;
+} cjson_chunk;
+
+struct __cjson_document {
+	cjson_settings* settings;
+	cjson_chunk* chunks; // the head chunk is the one currently being bumped.
+	size_t next_chunk_size;
+	size_t foreign; // amount of heap values adopted by pooled values after parsing.
+	size_t refs; // references held on the document (see cjson_cache), it is freed once the last one is released.
+	cjson_key_table* keys; // NULL until the first key is interned.
+	cjson_value* root;
+};
+
+// Open-addressing hash table over the key-values of an object, keyed by the case-folded key hash so that
+// both the case-sensitive and case-insensitive searches can use it. Erased slots become tombstones and are
+// never reused, which keeps duplicate keys in insertion order along their probe sequence.
+typedef struct __cjson_index {
+	size_t capacity; // power of two
+	size_t used; // occupied slots, including tombstones
+	cjson_value* slots[];
+} cjson_index;
+
+cjson_value cjson_index_tombstone;
+
+// Element pointers of an array in order, kept in sync with the child list which still serves iteration.
+typedef struct __cjson_vector {
+	size_t capacity;
+	cjson_value* elements[];
+} cjson_vector;
+
+// Every pooled value is prefixed with its document, so that mutations can allocate from the same arena.
+typedef struct {
+	cjson_document* doc;
+	cjson_value value;
+} cjson_pooled_value;
+
+typedef enum {
+	cjson_path_key, // object member (and array element when index is not -1, see JSON Pointer)
+	cjson_path_index, // array element, negative indices count from the end
+	cjson_path_wildcard, // every member or element
+	cjson_path_slice, // array elements [start, end), negative bounds count from the end
+} cjson_path_step_type;
+
+typedef struct {
+	cjson_path_step_type type;
+	const char* key; // NUL-terminated, stored behind the steps
+	unsigned int hash; // of key, see cjson_hash_key
+	unsigned int ihash;
+	long long index; // cjson_path_index, or cjson_path_key on an array (-1 when the key is not an index)
+	long long start; // cjson_path_slice
+	long long end;
+	int has_start;
+	int has_end;
+} cjson_path_step;
+
+struct __cjson_path {
+	cjson_settings* settings;
+	size_t count;
+	cjson_path_step steps[];
+};
+
+// Paths of cjson_parse_projected, bit i of cjson_state.paths stands for paths[i].
+typedef struct {
+	cjson_path** paths;
+	size_t count;
+} cjson_projection;
+
 typedef struct __cjson_context {
 	cjson_state* root_state;
 	cjson_state* tail_state;
+	cjson_state* free_states; // popped states, reused by cjson_push_state.
 	cjson_settings* settings;
+	cjson_document* doc; // NULL unless parsing into a document.
+	char* insitu; // the mutable input buffer when parsing in place, NULL otherwise.
 	const char* buf;
 	size_t len;
 	cjson_pos* pos;
+	int final; // 0 when more input may follow buf (see cjson_parser), 1 otherwise.
+	int need_more; // set when parsing stopped at the end of a non-final buffer.
+	size_t token_start; // offset to resume from when need_more is set.
+	int single; // stop after the root value instead of failing on the next one (see cjson_stream).
+	const cjson_projection* projection; // NULL unless only some values are parsed (see cjson_parse_projected).
+	int utf8_checked; // set when the strings were validated up front (see cjson_index_structurals), they are then not checked again.
+	size_t utf8_invalid; // with utf8_checked: offset of the first invalid byte inside of a string, (size_t)-1 when there is none.
 } cjson_context;
 
-cjson_value* cjson_parse_ex(cjson_settings* settings, const char* buffer);
-cjson_value* cjson_parse_file_ex(cjson_settings* settings, const char* filename);
+#define CJSON_PARSER_CHUNK (64 * 1024)
+
+struct __cjson_parser {
+	cjson_context ctx;
+	cjson_pos pos;
+	char* buf; // input that has not been consumed yet
+	size_t len;
+	size_t cap;
+	size_t retry_len; // an incomplete token is only rescanned once this much input is pending.
+	int failed;
+};
+
+cjson_value* cjson_parse_internal(cjson_settings* settings, cjson_document* doc, const char* buffer, size_t len, int insitu);
+cjson_value* cjson_parse_projection(cjson_settings* settings, cjson_document* doc, const char* buffer, size_t len, int insitu, const cjson_projection* projection);
+char* cjson_parser_reserve(cjson_parser* parser, size_t size);
+int cjson_parser_commit(cjson_parser* parser, size_t len);
+size_t cjson_vector_capacity(size_t length);
+cjson_vector* cjson_vector_create(cjson_settings* settings, cjson_document* doc, size_t capacity);
+int cjson_insert_kv(cjson_settings* settings, cjson_document* doc, cjson_value* p, char* k, cjson_value* v, int kv_flags);
+void cjson_hash_key(const char* k, unsigned int* hash, unsigned int* ihash);
+unsigned int cjson_hash_bytes(const char* k, size_t len);
+void cjson_index_remove(cjson_value* p, cjson_value* kv);
+int cjson_erase_kv_from_tree(cjson_settings* settings, cjson_value* p, cjson_value* kv);
+int cjson_skip_container(cjson_context* ctx);
 
 cjson_value* cjson_end(cjson_value* parent)
 {
@@ -71,15 +277,24 @@ cjson_value* cjson_end(cjson_value* parent)
 
 int cjson_error_code()
 {
-	return global_settings->errc;
+	return cjson_global_settings()->errc;
 }
 
 const char* cjson_error_string()
 {
-	switch (global_settings->errc) {
+	return cjson_error_string_ex(cjson_global_settings());
+}
+
+const char* cjson_error_string_ex(cjson_settings* settings)
+{
+	switch (settings->errc) {
 		case cjson_error_code_ok: return "ok";
 		case cjson_error_code_oom: return "out of memory (increase settings->memory_limit)";
 		case cjson_error_code_alloc: return "allocation failure (settings->mem_alloc() returned NULL)";
+		case cjson_error_code_aborted: return "Parsing was aborted by a callback";
+		case cjson_error_code_invalid_path: return "Invalid path (i.e. an unclosed '[', or a bad index or escape)";
+		case cjson_error_code_invalid_tape: return "Invalid tape (i.e. not written by cjson_tape_encode, or damaged)";
+		case cjson_error_code_invalid_binary: return "Invalid MessagePack or CBOR (i.e. truncated, an extension type, or a map key that is not a string or integer)";
 		case cjson_error_code_syntax_unexpected_eof: return "Syntax error: Unexpected end of file";
 		case cjson_error_code_syntax_multiple_root_nodes: return "Syntax error: Multiple root values (i.e. attempting to parse '[1, 2][3]')";
 		case cjson_error_code_syntax_invalid_number: return "Syntax error: Invalid number encountered (i.e. invalid punctuation, or too many negative signs)";
@@ -87,6 +302,8 @@ const char* cjson_error_string()
 		case cjson_error_code_syntax_expected_key: return "Syntax error: Expected key (string) in object";
 		case cjson_error_code_syntax_expected_colon: return "Syntax error: Expected colon after key";
 		case cjson_error_code_syntax_unclosed_value: return "Syntax error: Unclosed value ([ but not ], or { but no }). Enable 'permissive' to allow";
+		case cjson_error_code_syntax_invalid_utf8: return "Syntax error: Invalid UTF-8 (i.e. a truncated or overlong sequence, or a surrogate)";
+		case cjson_error_code_syntax_unexpected_character: return "Syntax error: Unexpected character (i.e. not the start of a value, or an unknown identifier)";
 	}
 
 	return "unknown error (not in enum)";
@@ -99,39 +316,55 @@ void cjson_print_mem(void)
 #endif
 }
 
+void cjson_settings_init(cjson_settings* settings)
+{
+	settings->mem_alloc = &malloc;
+	settings->mem_free = &free;
+#ifdef CJSON_ENABLE_MEMORY_LOGGING
+	settings->memory_limit = INT_MAX;
+	settings->used_memory = 0;
+	settings->highest_memory_usage = 0;
+#endif
+	settings->errc = cjson_error_code_ok;
+	settings->permissive = 0;
+	settings->structural_index = 0;
+}
+
 void cjson_init(cjson_settings* settings) 
 {
+	global_settings = malloc(sizeof(cjson_settings));
 	if (!settings) {
-		global_settings = malloc(sizeof(cjson_settings));
-		global_settings->mem_alloc = &malloc;
-		global_settings->mem_free = &free;
-#ifdef CJSON_ENABLE_MULTITHREAD_SUPPORT
-		global_settings->mtx = NULL;
-		global_settings->multithreaded = 0;
-#endif
-#ifdef CJSON_ENABLE_MULTITHREAD_SUPPORT
-		global_settings->memory_limit = INT_MAX;
-		global_settings->used_memory = 0;
-		global_settings->highest_memory_usage = 0;
-#endif
-		global_settings->errc = cjson_error_code_ok;
-		global_settings->permissive = 0;
+		cjson_settings_init(global_settings);
 	}
 	else {
-		global_settings = malloc(sizeof(cjson_settings));
 		memcpy(global_settings, settings, sizeof(cjson_settings));
 	}
 }
 
+// Returns the settings used by the functions that do not take any, creating them on first use.
+cjson_settings* cjson_global_settings(void)
+{
+	if (!global_settings) {
+		cjson_init(NULL);
+	}
+
+	return global_settings;
+}
+
 void cjson_set_permissive(int permissive)
 {
-	if (!global_settings) cjson_init(NULL);
-	global_settings->permissive = permissive;
+	cjson_global_settings()->permissive = permissive;
+}
+
+void cjson_set_structural_index(int structural_index)
+{
+	cjson_global_settings()->structural_index = structural_index;
 }
 
 void cjson_shutdown()
 {
 	free(global_settings);
+	global_settings = NULL;
 }
 
 void* cjson_alloc(cjson_settings* settings, size_t size)
@@ -184,8 +417,222 @@ void cjson_free(cjson_settings* settings, void* ptr)
 	}
 }
 
-// Returns NULL on failure, if nonnull return then the ptr must be freed with cjson_free
-char* cjson_read_file(cjson_settings* settings, const char* filename)
+cjson_document* cjson_document_create(cjson_settings* settings)
+{
+	cjson_document* doc = cjson_alloc(settings, sizeof(cjson_document));
+	if (!doc) {
+		return NULL;
+	}
+
+	doc->settings = settings;
+	doc->chunks = NULL;
+	doc->next_chunk_size = CJSON_DOCUMENT_MIN_CHUNK;
+	doc->foreign = 0;
+	doc->refs = 1;
+	doc->keys = NULL;
+	doc->root = NULL;
+	return doc;
+}
+
+cjson_chunk* cjson_document_add_chunk(cjson_document* doc, size_t size)
+{
+	cjson_chunk* chunk = cjson_alloc(doc->settings, CJSON_ALIGN(sizeof(cjson_chunk)) + size);
+	if (!chunk) {
+		return NULL;
+	}
+
+	chunk->size = size;
+	chunk->used = 0;
+	chunk->next = doc->chunks;
+	doc->chunks = chunk;
+	return chunk;
+}
+
+// Bump-allocates size bytes from the document. The memory is only released by cjson_free_document.
+void* cjson_document_alloc(cjson_document* doc, size_t size)
+{
+	size = CJSON_ALIGN(size);
+
+	cjson_chunk* chunk = doc->chunks;
+	if (!chunk || chunk->size - chunk->used < size) {
+		if (chunk && size > doc->next_chunk_size / 4) {
+			// Oversized allocations get a chunk of their own, linked behind the head so it can keep being bumped.
+			chunk = cjson_document_add_chunk(doc, size);
+			if (!chunk) {
+				return NULL;
+			}
+			doc->chunks = chunk->next;
+			chunk->next = doc->chunks->next;
+			doc->chunks->next = chunk;
+			chunk->used = size;
+			return (char*)chunk + CJSON_ALIGN(sizeof(cjson_chunk));
+		}
+
+		size_t chunk_size = doc->next_chunk_size;
+		while (chunk_size < size) {
+			chunk_size *= 2;
+		}
+
+		chunk = cjson_document_add_chunk(doc, chunk_size);
+		if (!chunk) {
+			return NULL;
+		}
+
+		if (doc->next_chunk_size < CJSON_DOCUMENT_MAX_CHUNK) {
+			doc->next_chunk_size *= 2;
+		}
+	}
+
+	void* ptr = (char*)chunk + CJSON_ALIGN(sizeof(cjson_chunk)) + chunk->used;
+	chunk->used += size;
+	return ptr;
+}
+
+// Returns the document owning v, or NULL when v was allocated on its own.
+cjson_document* cjson_value_document(cjson_value* v)
+{
+	if (!(v->flags & cjson_pooled)) {
+		return NULL;
+	}
+
+	return ((cjson_pooled_value*)((char*)v - offsetof(cjson_pooled_value, value)))->doc;
+}
+
+// Must be called whenever p takes ownership of c, so that cjson_free_document knows it has to walk the tree.
+void cjson_adopt(cjson_value* p, cjson_value* c)
+{
+	if (c && (p->flags & cjson_pooled) && !(c->flags & cjson_pooled)) {
+		++cjson_value_document(p)->foreign;
+	}
+}
+
+void cjson_free_document(cjson_document* doc)
+{
+	if (!doc || __atomic_sub_fetch(&doc->refs, 1, __ATOMIC_ACQ_REL) != 0) {
+		return;
+	}
+
+	// Pooled values are never freed on their own, so the tree only has to be walked when heap values were put into it.
+	if (doc->foreign) {
+		cjson_free_value_ex(doc->settings, doc->root);
+	}
+
+	cjson_chunk* chunk = doc->chunks;
+	while (chunk != NULL) {
+		cjson_chunk* next = chunk->next;
+		cjson_free(doc->settings, chunk);
+		chunk = next;
+	}
+
+	cjson_free(doc->settings, doc);
+}
+
+cjson_value* cjson_document_root(cjson_document* doc)
+{
+	return doc ? doc->root : NULL;
+}
+
+size_t cjson_document_memory(cjson_document* doc)
+{
+	size_t bytes = 0;
+	for (cjson_chunk* chunk = doc ? doc->chunks : NULL; chunk != NULL; chunk = chunk->next) {
+		bytes += CJSON_ALIGN(sizeof(cjson_chunk)) + chunk->size;
+	}
+	return bytes;
+}
+
+cjson_interned_key* cjson_key_interned(const char* k)
+{
+	return (cjson_interned_key*)(k - offsetof(cjson_interned_key, key));
+}
+
+// Returns the slot of the key equal to the first len bytes of k, or the empty slot it would be put into.
+cjson_interned_key** cjson_key_table_slot(cjson_key_table* table, const char* k, size_t len, unsigned int hash)
+{
+	size_t mask = table->capacity - 1;
+	size_t i = hash & mask;
+	cjson_interned_key* key;
+	while ((key = table->slots[i]) != NULL) {
+		if (key->hash == hash && key->len == len && memcmp(key->key, k, len) == 0) {
+			break;
+		}
+		i = (i + 1) & mask;
+	}
+
+	return &table->slots[i];
+}
+
+// Doubles the key table of doc, the old one is left behind in the document.
+int cjson_key_table_grow(cjson_document* doc)
+{
+	cjson_key_table* old = doc->keys;
+	size_t capacity = old ? old->capacity * 2 : 64;
+	cjson_key_table* table = cjson_document_alloc(doc, sizeof(cjson_key_table) + capacity * sizeof(cjson_interned_key*));
+	if (!table) {
+		return 0;
+	}
+
+	table->capacity = capacity;
+	table->used = 0;
+	memset(table->slots, 0, capacity * sizeof(cjson_interned_key*));
+
+	for (size_t i = 0; old && i < old->capacity; ++i) {
+		cjson_interned_key* key = old->slots[i];
+		if (key) {
+			*cjson_key_table_slot(table, key->key, key->len, key->hash) = key;
+			++table->used;
+		}
+	}
+
+	doc->keys = table;
+	return 1;
+}
+
+// Returns the key of doc equal to the first len bytes of k, copying it into the document the first time it is seen.
+// Key-values using it must be flagged with cjson_interned. Returns NULL on failure.
+char* cjson_document_intern(cjson_document* doc, const char* k, size_t len)
+{
+	// The case-insensitive hash is only computed once for every distinct key.
+	unsigned int hash = cjson_hash_bytes(k, len);
+	cjson_interned_key** slot = doc->keys ? cjson_key_table_slot(doc->keys, k, len, hash) : NULL;
+	if (slot && *slot) {
+		return (*slot)->key;
+	}
+
+	if (!doc->keys || (doc->keys->used + 1) * 2 > doc->keys->capacity) {
+		if (!cjson_key_table_grow(doc)) {
+			return NULL;
+		}
+		slot = cjson_key_table_slot(doc->keys, k, len, hash);
+	}
+
+	cjson_interned_key* key = cjson_document_alloc(doc, sizeof(cjson_interned_key) + len + 1);
+	if (!key) {
+		return NULL;
+	}
+
+	key->len = len;
+	memcpy(key->key, k, len);
+	key->key[len] = 0;
+	cjson_hash_key(key->key, &key->hash, &key->ihash);
+	*slot = key;
+	++doc->keys->used;
+	return key->key;
+}
+
+const char* cjson_document_key(cjson_document* doc, const char* k)
+{
+	if (!doc || !k || !doc->keys) {
+		return NULL;
+	}
+
+	size_t len = strlen(k);
+	cjson_interned_key* key = *cjson_key_table_slot(doc->keys, k, len, cjson_hash_bytes(k, len));
+	return key ? key->key : NULL;
+}
+
+// Returns NULL on failure, if nonnull return then the ptr must be freed with cjson_free (unless it was allocated from doc).
+char* cjson_read_file(cjson_settings* settings, cjson_document* doc, const char* filename, size_t* out_len)
 {
 	FILE* file = fopen(filename, "r");
 
@@ -196,80 +643,235 @@ char* cjson_read_file(cjson_settings* settings, const char* filename)
 	fseek(file, 0, SEEK_END);
 	size_t len = ftell(file);
 	fseek(file, 0, SEEK_SET);
-	char* buf = cjson_alloc(settings, len + 1);
+	char* buf = doc ? cjson_document_alloc(doc, len + 1) : cjson_alloc(settings, len + 1);
 	if (!buf) {
 		fclose(file);
 		return NULL;
 	}
 
 	if (fread(buf, sizeof(char), len, file) != len) {
-		cjson_free(settings, buf);
+		if (!doc) cjson_free(settings, buf);
 		fclose(file);
 		return NULL;
 	}
 
 	fclose(file);
 	buf[len] = 0;
+	*out_len = len;
 	return buf;
 }
 
-cjson_value* cjson_parse_file(const char* filename)
+#ifdef CJSON_MMAP
+// Maps a regular file read-only for a single sequential pass. Returns NULL when the file can not be mapped
+// (i.e. it is empty, or not a regular file), the mapping must be released with munmap(map, *out_len).
+const char* cjson_map_file(const char* filename, size_t* out_len)
 {
-	if (!global_settings) {
-		cjson_init(NULL);
+	int fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return NULL;
 	}
 
-	return cjson_parse_file_ex(global_settings, filename);
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+		close(fd);
+		return NULL;
+	}
+
+	size_t len = (size_t)st.st_size;
+	void* map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // the mapping keeps the file open
+	if (map == MAP_FAILED) {
+		return NULL;
+	}
+
+	madvise(map, len, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+	// Only a hint, it is ignored when the file system does not support huge pages for the page cache.
+	if (len >= 2 * 1024 * 1024) {
+		madvise(map, len, MADV_HUGEPAGE);
+	}
+#endif
+
+	*out_len = len;
+	return map;
+}
+#endif
+
+cjson_value* cjson_parse_file(const char* filename)
+{
+	return cjson_parse_file_ex(cjson_global_settings(), filename);
 }
 
 cjson_value* cjson_parse(const char* buffer)
 {
-	if (!global_settings) {
-		cjson_init(NULL);
-	}
+	return cjson_parse_ex(cjson_global_settings(), buffer);
+}
+
+cjson_value* cjson_parse_n(const char* buffer, size_t len)
+{
+	return cjson_parse_n_ex(cjson_global_settings(), buffer, len);
+}
+
+cjson_document* cjson_parse_document_file(const char* filename)
+{
+	return cjson_parse_document_file_ex(cjson_global_settings(), filename);
+}
+
+cjson_document* cjson_parse_document(const char* buffer)
+{
+	return cjson_parse_document_ex(cjson_global_settings(), buffer);
+}
+
+cjson_document* cjson_parse_document_n(const char* buffer, size_t len)
+{
+	return cjson_parse_document_n_ex(cjson_global_settings(), buffer, len);
+}
+
+cjson_value* cjson_parse_insitu(char* buffer)
+{
+	return cjson_parse_insitu_ex(cjson_global_settings(), buffer);
+}
 
-	return cjson_parse_ex(global_settings, buffer);
+cjson_document* cjson_parse_document_insitu(char* buffer)
+{
+	return cjson_parse_document_insitu_ex(cjson_global_settings(), buffer);
 }
 
+// Parses the file straight from a read-only mapping when possible. Otherwise it is read in chunks through a
+// cjson_parser, so the whole file never has to be held in memory.
 cjson_value* cjson_parse_file_ex(cjson_settings* settings, const char* filename)
 {
 	TIMER_INIT();
 
+#ifdef CJSON_MMAP
+	size_t map_len;
+	const char* map = cjson_map_file(filename, &map_len);
+	if (map) {
+		TIMER_BEGIN("cjson_parse_file");
+		cjson_value* value = cjson_parse_internal(settings, NULL, map, map_len, 0);
+		TIMER_END();
+		munmap((void*)map, map_len);
+		return value;
+	}
+#endif
+
+	FILE* file = fopen(filename, "r");
+	if (!file) {
+		return NULL;
+	}
+
+	cjson_parser* parser = cjson_parser_create_ex(settings);
+	if (!parser) {
+		fclose(file);
+		return NULL;
+	}
+
+	TIMER_BEGIN("cjson_parse_file");
+	while (1) {
+		char* dst = cjson_parser_reserve(parser, CJSON_PARSER_CHUNK);
+		if (!dst) {
+			cjson_parser_free(parser);
+			fclose(file);
+			return NULL;
+		}
+
+		size_t len = fread(dst, sizeof(char), CJSON_PARSER_CHUNK, file);
+		if (!len) {
+			break;
+		}
+
+		if (!cjson_parser_commit(parser, len)) {
+			cjson_parser_free(parser);
+			fclose(file);
+			return NULL;
+		}
+	}
+
+	int read_error = ferror(file);
+	fclose(file);
+	if (read_error) {
+		cjson_parser_free(parser);
+		return NULL;
+	}
+
+	cjson_value* value = cjson_parser_finish(parser);
+	TIMER_END();
+	return value;
+}
+
+cjson_document* cjson_parse_document_file_ex(cjson_settings* settings, const char* filename)
+{
+	TIMER_INIT();
+
+	cjson_document* doc = cjson_document_create(settings);
+	if (!doc) {
+		return NULL;
+	}
+
+	// The file is read into the document itself, so its strings and keys can be parsed in place.
 	TIMER_BEGIN("cjson_read_file");
-	char* buf = cjson_read_file(settings, filename);
+	size_t len;
+	char* buf = cjson_read_file(settings, doc, filename, &len);
 	TIMER_END();
 	if (!buf) {
+		cjson_free_document(doc);
 		return NULL;
 	}
-	
-	cjson_value* value = cjson_parse_ex(settings, buf);
-	cjson_free(settings, buf);
-	return value;
+
+	doc->root = cjson_parse_internal(settings, doc, buf, len, 1);
+	if (!doc->root) {
+		cjson_free_document(doc);
+		return NULL;
+	}
+
+	return doc;
 }
 
-cjson_pos* cjson_make_pos(cjson_settings* settings, size_t row, size_t col, size_t ofs)
+// Allocates parse-time memory from the document when parsing into one, and from the settings allocator otherwise.
+void* cjson_ctx_alloc(cjson_context* ctx, size_t size)
 {
-	cjson_pos* pos = cjson_alloc(settings, sizeof(cjson_pos));
-	if (!pos) {
-		return NULL;
+	if (ctx->doc) {
+		return cjson_document_alloc(ctx->doc, size);
+	}
+
+	return cjson_alloc(ctx->settings, size);
+}
+
+void cjson_ctx_free(cjson_context* ctx, void* ptr)
+{
+	if (!ctx->doc) {
+		cjson_free(ctx->settings, ptr);
+	}
+}
+
+// Frees a string returned from cjson_consume_str.
+void cjson_ctx_free_string(cjson_context* ctx, char* str)
+{
+	if (!ctx->insitu) {
+		cjson_ctx_free(ctx, str);
 	}
-	pos->row = row;
-	pos->col = col;
-	pos->ofs = ofs;
-	return pos;
 }
 
 cjson_state* cjson_push_state(cjson_context* ctx, cjson_state_type type, cjson_value* wip, int parse_flags)
 {
-	cjson_state* state = cjson_alloc(ctx->settings, sizeof(cjson_state));
-	if (!state) {
-		return NULL;
+	cjson_state* state = ctx->free_states;
+	if (state) {
+		ctx->free_states = state->next;
+	}
+	else {
+		state = cjson_ctx_alloc(ctx, sizeof(cjson_state));
+		if (!state) {
+			return NULL;
+		}
 	}
 	state->next = NULL;
 	state->prev = NULL;
 	state->type = type;
 	state->wip_value = wip;
 	state->parse_flags = parse_flags;
+	state->paths = 0;
+	state->depth = -1;
+	state->elements = 0;
 
 	if (ctx->tail_state == NULL) {
 		ctx->root_state = state;
@@ -292,17 +894,26 @@ void cjson_pop_state(cjson_context* ctx)
 	if (ctx->tail_state) {
 		ctx->tail_state->next = NULL;
 	}
-	cjson_free(ctx->settings, old_tail);
+
+	// Keep the state around for the next push instead of handing it back to the allocator.
+	old_tail->next = ctx->free_states;
+	ctx->free_states = old_tail;
 }
 
 void cjson_free_remaining_states(cjson_context* ctx, int free_root_node)
 {
-	if (free_root_node && ctx->root_state) {
-		cjson_free_value(ctx->root_state->wip_value);
+	// Values parsed into a document are released together with the document.
+	if (free_root_node && ctx->root_state && !ctx->doc) {
+		cjson_free_value_ex(ctx->settings, ctx->root_state->wip_value);
 	}
 	while (ctx->tail_state) {
 		cjson_pop_state(ctx);
 	}
+	while (ctx->free_states) {
+		cjson_state* next = ctx->free_states->next;
+		cjson_ctx_free(ctx, ctx->free_states);
+		ctx->free_states = next;
+	}
 }
 
 int cjson_eof(cjson_context* ctx) 
@@ -310,9 +921,20 @@ int cjson_eof(cjson_context* ctx)
 	return ctx->pos->ofs >= ctx->len;
 }
 
+// Returns 1 (and suspends parsing) when the end of the buffer was reached, but more input may still follow.
+int cjson_need_more(cjson_context* ctx)
+{
+	if (ctx->final || !cjson_eof(ctx)) {
+		return 0;
+	}
+
+	ctx->need_more = 1;
+	return 1;
+}
+
 char cjson_peek(cjson_context* ctx, int offset)
 {
-	if (ctx->pos->ofs + offset > ctx->len) {
+	if (ctx->pos->ofs + offset >= ctx->len) {
 		return 0;
 	}
 
@@ -331,71 +953,543 @@ char cjson_consume(cjson_context* ctx)
 	}
 
 	char c = cjson_curc(ctx);
-
-	++ctx->pos->col;
 	++ctx->pos->ofs;
-	if (c == '\n') {
-		++ctx->pos->row;
-		ctx->pos->col = 0;
-	}
-
 	return c;
 }
 
-char* cjson_consume_digits(cjson_context* ctx, int* punctflag) // 1.23 etc
-{
-	int num_dots = 0;
-	int is_neg = 0;
-	size_t s_ofs = ctx->pos->ofs;
+unsigned char cjson_is_space_table[256] = {
+	['\t'] = 1, ['\n'] = 1, ['\v'] = 1, ['\f'] = 1, ['\r'] = 1, [' '] = 1,
+};
 
-	if (cjson_curc(ctx) == '-') {
-		is_neg = 1;
+const char* cjson_scan_spaces_scalar(const char* p, const char* end)
+{
+	while (p < end && cjson_is_space_table[(unsigned char)*p]) {
+		++p;
 	}
+	return p;
+}
 
-	while (!cjson_eof(ctx) && (isdigit(cjson_curc(ctx)) || cjson_curc(ctx) == '.' || cjson_curc(ctx) == '-')) {
-		char c = cjson_curc(ctx);
-		if (c == '.') {
-			++num_dots;
-			if (punctflag) *punctflag = 1;
+// Portable fallback, checks 8 bytes at a time for a quote or backslash before falling back to the bytewise loop.
+const char* cjson_scan_string_scalar(const char* p, const char* end)
+{
+	const unsigned long long ones = 0x0101010101010101ULL;
+	const unsigned long long highs = 0x8080808080808080ULL;
+
+	while (end - p >= 8) {
+		unsigned long long word;
+		memcpy(&word, p, sizeof(word));
+		unsigned long long quotes = word ^ (ones * '"');
+		unsigned long long slashes = word ^ (ones * '\\');
+		if (((quotes - ones) & ~quotes & highs) | ((slashes - ones) & ~slashes & highs)) {
+			break;
+		}
+		p += 8;
+	}
 
-			if (num_dots > 1) {
-				ctx->settings->errc = cjson_error_code_syntax_invalid_number;
-				return NULL;
+	while (p < end && *p != '"' && *p != '\\') {
+		++p;
+	}
+	return p;
+}
+
+unsigned char cjson_is_structural_table[256] = {
+	['"'] = 1, ['['] = 1, [']'] = 1, ['{'] = 1, ['}'] = 1, ['/'] = 1,
+};
+
+const char* cjson_scan_structural_scalar(const char* p, const char* end)
+{
+	while (p < end && !cjson_is_structural_table[(unsigned char)*p]) {
+		++p;
+	}
+	return p;
+}
+
+void cjson_classify_scalar(const char* p, cjson_block* block)
+{
+	memset(block, 0, sizeof(*block));
+	for (int i = 0; i < 64; ++i) {
+		unsigned long long bit = 1ULL << i;
+		switch (p[i]) {
+			case '"': block->quote |= bit; break;
+			case '\\': block->backslash |= bit; break;
+			case '[': case '{': block->open |= bit; break;
+			case ']': case '}': block->close |= bit; break;
+			case ',': block->comma |= bit; break;
+			case '/': block->slash |= bit; break;
+			case ':': block->colon |= bit; break;
+		}
+		if (cjson_is_space_table[(unsigned char)p[i]]) {
+			block->space |= bit;
+		}
+		if ((unsigned char)p[i] & 0x80) {
+			block->high |= bit;
+		}
+	}
+}
+
+#ifdef CJSON_SCAN_X86
+const char* cjson_scan_spaces_sse2(const char* p, const char* end)
+{
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i range = _mm_set1_epi8('\r' - '\t');
+
+	while (end - p >= 16) {
+		__m128i chunk = _mm_loadu_si128((const __m128i*)p);
+		// '\t'..'\r' are contiguous: (c - '\t') <= ('\r' - '\t') as unsigned bytes.
+		__m128i shifted = _mm_sub_epi8(chunk, tab);
+		__m128i ctrl = _mm_cmpeq_epi8(_mm_min_epu8(shifted, range), shifted);
+		__m128i ws = _mm_or_si128(ctrl, _mm_cmpeq_epi8(chunk, space));
+		unsigned mask = ~(unsigned)_mm_movemask_epi8(ws) & 0xFFFF;
+		if (mask) {
+			return p + __builtin_ctz(mask);
+		}
+		p += 16;
+	}
+
+	return cjson_scan_spaces_scalar(p, end);
+}
+
+const char* cjson_scan_string_sse2(const char* p, const char* end)
+{
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i slash = _mm_set1_epi8('\\');
+
+	while (end - p >= 16) {
+		__m128i chunk = _mm_loadu_si128((const __m128i*)p);
+		__m128i hits = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, slash));
+		unsigned mask = (unsigned)_mm_movemask_epi8(hits);
+		if (mask) {
+			return p + __builtin_ctz(mask);
+		}
+		p += 16;
+	}
+
+	return cjson_scan_string_scalar(p, end);
+}
+
+// '[' and ']' (0x5B, 0x5D) only differ from '{' and '}' (0x7B, 0x7D) in bit 5, so all four are matched after setting it.
+const char* cjson_scan_structural_sse2(const char* p, const char* end)
+{
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i slash = _mm_set1_epi8('/');
+	const __m128i curly_open = _mm_set1_epi8('{');
+	const __m128i curly_close = _mm_set1_epi8('}');
+	const __m128i fold = _mm_set1_epi8(0x20);
+
+	while (end - p >= 16) {
+		__m128i chunk = _mm_loadu_si128((const __m128i*)p);
+		__m128i folded = _mm_or_si128(chunk, fold);
+		__m128i hits = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, slash)),
+			_mm_or_si128(_mm_cmpeq_epi8(folded, curly_open), _mm_cmpeq_epi8(folded, curly_close)));
+		unsigned mask = (unsigned)_mm_movemask_epi8(hits);
+		if (mask) {
+			return p + __builtin_ctz(mask);
+		}
+		p += 16;
+	}
+
+	return cjson_scan_structural_scalar(p, end);
+}
+
+void cjson_classify_sse2(const char* p, cjson_block* block)
+{
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i comma = _mm_set1_epi8(',');
+	const __m128i slash = _mm_set1_epi8('/');
+	const __m128i curly_open = _mm_set1_epi8('{');
+	const __m128i curly_close = _mm_set1_epi8('}');
+	const __m128i fold = _mm_set1_epi8(0x20);
+	const __m128i colon = _mm_set1_epi8(':');
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i range = _mm_set1_epi8('\r' - '\t');
+
+	memset(block, 0, sizeof(*block));
+	for (int i = 0; i < 64; i += 16) {
+		__m128i chunk = _mm_loadu_si128((const __m128i*)(p + i));
+		__m128i folded = _mm_or_si128(chunk, fold);
+		block->quote |= (unsigned long long)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, quote)) << i;
+		block->backslash |= (unsigned long long)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, backslash)) << i;
+		block->open |= (unsigned long long)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(folded, curly_open)) << i;
+		block->close |= (unsigned long long)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(folded, curly_close)) << i;
+		block->comma |= (unsigned long long)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, comma)) << i;
+		block->slash |= (unsigned long long)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, slash)) << i;
+		block->colon |= (unsigned long long)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, colon)) << i;
+		__m128i shifted = _mm_sub_epi8(chunk, tab);
+		__m128i ctrl = _mm_cmpeq_epi8(_mm_min_epu8(shifted, range), shifted);
+		block->space |= (unsigned long long)(unsigned)_mm_movemask_epi8(_mm_or_si128(ctrl, _mm_cmpeq_epi8(chunk, space))) << i;
+		block->high |= (unsigned long long)(unsigned)_mm_movemask_epi8(chunk) << i;
+	}
+}
+
+__attribute__((target("avx2")))
+const char* cjson_scan_spaces_avx2(const char* p, const char* end)
+{
+	const __m256i space = _mm256_set1_epi8(' ');
+	const __m256i tab = _mm256_set1_epi8('\t');
+	const __m256i range = _mm256_set1_epi8('\r' - '\t');
+
+	while (end - p >= 32) {
+		__m256i chunk = _mm256_loadu_si256((const __m256i*)p);
+		__m256i shifted = _mm256_sub_epi8(chunk, tab);
+		__m256i ctrl = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, range), shifted);
+		__m256i ws = _mm256_or_si256(ctrl, _mm256_cmpeq_epi8(chunk, space));
+		unsigned mask = ~(unsigned)_mm256_movemask_epi8(ws);
+		if (mask) {
+			return p + __builtin_ctz(mask);
+		}
+		p += 32;
+	}
+
+	return cjson_scan_spaces_sse2(p, end);
+}
+
+__attribute__((target("avx2")))
+const char* cjson_scan_string_avx2(const char* p, const char* end)
+{
+	const __m256i quote = _mm256_set1_epi8('"');
+	const __m256i slash = _mm256_set1_epi8('\\');
+
+	while (end - p >= 32) {
+		__m256i chunk = _mm256_loadu_si256((const __m256i*)p);
+		__m256i hits = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote), _mm256_cmpeq_epi8(chunk, slash));
+		unsigned mask = (unsigned)_mm256_movemask_epi8(hits);
+		if (mask) {
+			return p + __builtin_ctz(mask);
+		}
+		p += 32;
+	}
+
+	return cjson_scan_string_sse2(p, end);
+}
+
+__attribute__((target("avx2")))
+const char* cjson_scan_structural_avx2(const char* p, const char* end)
+{
+	const __m256i quote = _mm256_set1_epi8('"');
+	const __m256i slash = _mm256_set1_epi8('/');
+	const __m256i curly_open = _mm256_set1_epi8('{');
+	const __m256i curly_close = _mm256_set1_epi8('}');
+	const __m256i fold = _mm256_set1_epi8(0x20);
+
+	while (end - p >= 32) {
+		__m256i chunk = _mm256_loadu_si256((const __m256i*)p);
+		__m256i folded = _mm256_or_si256(chunk, fold);
+		__m256i hits = _mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote), _mm256_cmpeq_epi8(chunk, slash)),
+			_mm256_or_si256(_mm256_cmpeq_epi8(folded, curly_open), _mm256_cmpeq_epi8(folded, curly_close)));
+		unsigned mask = (unsigned)_mm256_movemask_epi8(hits);
+		if (mask) {
+			return p + __builtin_ctz(mask);
+		}
+		p += 32;
+	}
+
+	return cjson_scan_structural_sse2(p, end);
+}
+
+__attribute__((target("avx2")))
+void cjson_classify_avx2(const char* p, cjson_block* block)
+{
+	const __m256i quote = _mm256_set1_epi8('"');
+	const __m256i backslash = _mm256_set1_epi8('\\');
+	const __m256i comma = _mm256_set1_epi8(',');
+	const __m256i slash = _mm256_set1_epi8('/');
+	const __m256i curly_open = _mm256_set1_epi8('{');
+	const __m256i curly_close = _mm256_set1_epi8('}');
+	const __m256i fold = _mm256_set1_epi8(0x20);
+	const __m256i colon = _mm256_set1_epi8(':');
+	const __m256i space = _mm256_set1_epi8(' ');
+	const __m256i tab = _mm256_set1_epi8('\t');
+	const __m256i range = _mm256_set1_epi8('\r' - '\t');
+
+	memset(block, 0, sizeof(*block));
+	for (int i = 0; i < 64; i += 32) {
+		__m256i chunk = _mm256_loadu_si256((const __m256i*)(p + i));
+		__m256i folded = _mm256_or_si256(chunk, fold);
+		block->quote |= (unsigned long long)(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, quote)) << i;
+		block->backslash |= (unsigned long long)(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, backslash)) << i;
+		block->open |= (unsigned long long)(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(folded, curly_open)) << i;
+		block->close |= (unsigned long long)(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(folded, curly_close)) << i;
+		block->comma |= (unsigned long long)(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, comma)) << i;
+		block->slash |= (unsigned long long)(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, slash)) << i;
+		block->colon |= (unsigned long long)(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, colon)) << i;
+		__m256i shifted = _mm256_sub_epi8(chunk, tab);
+		__m256i ctrl = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, range), shifted);
+		block->space |= (unsigned long long)(unsigned)_mm256_movemask_epi8(_mm256_or_si256(ctrl, _mm256_cmpeq_epi8(chunk, space))) << i;
+		block->high |= (unsigned long long)(unsigned)_mm256_movemask_epi8(chunk) << i;
+	}
+}
+#endif
+
+// Picks the widest kernels the CPU supports, called once before the first parse.
+void cjson_scan_init(void)
+{
+	if (__atomic_load_n(&cjson_scan.initialized, __ATOMIC_ACQUIRE)) {
+		return;
+	}
+
+	// Parses may start on several threads at once, the first one picks the kernels and the others wait for it.
+	if (__atomic_exchange_n(&cjson_scan.claimed, 1, __ATOMIC_ACQ_REL)) {
+		while (!__atomic_load_n(&cjson_scan.initialized, __ATOMIC_ACQUIRE)) {
+		}
+		return;
+	}
+
+	cjson_scan.spaces = &cjson_scan_spaces_scalar;
+	cjson_scan.string = &cjson_scan_string_scalar;
+	cjson_scan.structural = &cjson_scan_structural_scalar;
+	cjson_scan.classify = &cjson_classify_scalar;
+#ifdef CJSON_SCAN_X86
+	cjson_scan.spaces = &cjson_scan_spaces_sse2;
+	cjson_scan.string = &cjson_scan_string_sse2;
+	cjson_scan.structural = &cjson_scan_structural_sse2;
+	cjson_scan.classify = &cjson_classify_sse2;
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		cjson_scan.spaces = &cjson_scan_spaces_avx2;
+		cjson_scan.string = &cjson_scan_string_avx2;
+		cjson_scan.structural = &cjson_scan_structural_avx2;
+		cjson_scan.classify = &cjson_classify_avx2;
+	}
+#endif
+	__atomic_store_n(&cjson_scan.initialized, 1, __ATOMIC_RELEASE);
+}
+
+// Number parsed by cjson_consume_number.
+typedef struct {
+	int flags; // cjson_integer (optionally | cjson_unsigned) or cjson_double
+	long long intval;
+	double doubleval;
+} cjson_number_value;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+// Returns 1 when all of the 8 bytes at p are digits, their value is then stored in *out.
+int cjson_parse_8_digits(const char* p, unsigned long long* out)
+{
+	unsigned long long v;
+	memcpy(&v, p, 8);
+	if ((v & 0xF0F0F0F0F0F0F0F0ULL) != 0x3030303030303030ULL || ((v + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) != 0x3030303030303030ULL) {
+		return 0;
+	}
+
+	// Combines neighbouring digits, then pairs, then quads (the first digit is in the lowest byte).
+	v -= 0x3030303030303030ULL;
+	v = (v * 10) + (v >> 8);
+	v = (((v & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) + (((v >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+	*out = v;
+	return 1;
+}
+#endif
+
+// Exactly representable powers of ten, see cjson_consume_number.
+const double cjson_pow10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+#ifdef CJSON_STRTOD_L
+locale_t cjson_c_locale;
+
+void cjson_c_locale_init(void)
+{
+	cjson_c_locale = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
+}
+
+#ifdef CJSON_THREADS
+pthread_once_t cjson_c_locale_once = PTHREAD_ONCE_INIT;
+#endif
+#endif
+
+// strtod of a null-terminated JSON number, independent of the program's locale (a ',' decimal point would
+// otherwise stop strtod at the '.'). buf may be modified.
+double cjson_strtod(char* buf)
+{
+#ifdef CJSON_STRTOD_L
+#ifdef CJSON_THREADS
+	pthread_once(&cjson_c_locale_once, cjson_c_locale_init);
+#else
+	if (!cjson_c_locale) {
+		cjson_c_locale_init();
+	}
+#endif
+	if (cjson_c_locale) {
+		return strtod_l(buf, NULL, cjson_c_locale);
+	}
+#endif
+
+	// Without strtod_l the '.' is swapped for the decimal point of the current locale.
+	char point = localeconv()->decimal_point[0];
+	char* dot = strchr(buf, '.');
+	if (dot && point && point != '.') {
+		*dot = point;
+	}
+	return strtod(buf, NULL);
+}
+
+// Parses a number straight from the buffer ("-12", "3.5", "1e-7", also ".5" and "5."). Integers which do not fit
+// in 64 bits become doubles. Returns 0 on failure.
+int cjson_consume_number(cjson_context* ctx, cjson_number_value* out) // 1.23 etc
+{
+	const char* start = ctx->buf + ctx->pos->ofs;
+	const char* end = ctx->buf + ctx->len;
+	const char* p = start;
+	unsigned long long mantissa = 0;
+	int neg = 0;
+	int overflow = 0;
+	int is_double = 0;
+	int digits = 0;
+	long long exp10 = 0;
+
+	if (p < end && *p == '-') {
+		neg = 1;
+		++p;
+	}
+
+	const char* int_start = p;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	// 19 digits always fit, so up to two chunks of 8 are taken without checking for overflow.
+	unsigned long long chunk;
+	while (end - p >= 8 && p - int_start < 16 && cjson_parse_8_digits(p, &chunk)) {
+		mantissa = mantissa * 100000000ULL + chunk;
+		p += 8;
+	}
+#endif
+	while (p < end && (unsigned)(*p - '0') < 10) {
+		if (__builtin_mul_overflow(mantissa, 10, &mantissa) || __builtin_add_overflow(mantissa, (unsigned)(*p - '0'), &mantissa)) {
+			overflow = 1;
+		}
+		++p;
+	}
+	digits = (int)(p - int_start);
+
+	if (p < end && *p == '.') {
+		is_double = 1;
+		const char* frac_start = ++p;
+		while (p < end && (unsigned)(*p - '0') < 10) {
+			if (!overflow && mantissa < 1000000000000000000ULL) {
+				mantissa = mantissa * 10 + (unsigned)(*p - '0');
+				--exp10;
 			}
+			else {
+				overflow = 1;
+			}
+			++p;
 		}
+		digits += (int)(p - frac_start);
+	}
 
-		if (is_neg && c == '-' && ctx->pos->ofs > s_ofs) {
-			// error
+	if (!digits) {
+		ctx->pos->ofs = p - ctx->buf;
+		if (!cjson_need_more(ctx)) {
 			ctx->settings->errc = cjson_error_code_syntax_invalid_number;
-			return NULL;
 		}
+		return 0;
+	}
 
-		cjson_consume(ctx);
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		is_double = 1;
+		++p;
+		int exp_neg = 0;
+		if (p < end && (*p == '+' || *p == '-')) {
+			exp_neg = *p == '-';
+			++p;
+		}
+		const char* exp_start = p;
+		long long e = 0;
+		while (p < end && (unsigned)(*p - '0') < 10) {
+			if (e < 100000) {
+				e = e * 10 + (*p - '0');
+			}
+			++p;
+		}
+		if (p == exp_start) {
+			ctx->pos->ofs = p - ctx->buf;
+			if (!cjson_need_more(ctx)) {
+				ctx->settings->errc = cjson_error_code_syntax_invalid_number;
+			}
+			return 0;
+		}
+		exp10 += exp_neg ? -e : e;
 	}
-	size_t e_ofs = ctx->pos->ofs;
-	
-	size_t len = e_ofs - s_ofs;
-	char* buf = cjson_alloc(ctx->settings, len + 1);
-	if (!buf) {
-		return NULL;
+
+	ctx->pos->ofs = p - ctx->buf;
+	if (cjson_need_more(ctx)) {
+		return 0;
 	}
-	memcpy(buf, ctx->buf + s_ofs, len);
+
+	// A second '.' or a '-' in the middle of a number (i.e. "1.2.3" or "1-2").
+	if (p < end && (*p == '.' || *p == '-')) {
+		ctx->settings->errc = cjson_error_code_syntax_invalid_number;
+		return 0;
+	}
+
+	if (!is_double && !overflow) {
+		if (!neg) {
+			out->flags = cjson_integer | (mantissa > LLONG_MAX ? cjson_unsigned : 0);
+			out->intval = (long long)mantissa;
+			return 1;
+		}
+		if (mantissa <= (unsigned long long)LLONG_MAX + 1) {
+			out->flags = cjson_integer;
+			out->intval = (long long)(0 - mantissa);
+			return 1;
+		}
+	}
+
+	out->flags = cjson_double;
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+	// Clinger's fast path: both the mantissa and the power of ten are exact doubles, so a single rounding
+	// (the multiplication or division) gives the correctly rounded result.
+	if (!overflow && mantissa <= (1ULL << 53) && exp10 >= -22 && exp10 <= 22) {
+		double d = (double)mantissa;
+		d = exp10 < 0 ? d / cjson_pow10[-exp10] : d * cjson_pow10[exp10];
+		out->doubleval = neg ? -d : d;
+		return 1;
+	}
+#endif
+
+	// Everything else (long mantissas, large exponents) is left to strtod, which rounds correctly.
+	char scratch[CJSON_SCRATCH_SIZE];
+	size_t len = p - start;
+	char* buf = scratch;
+	if (len >= CJSON_SCRATCH_SIZE) {
+		buf = cjson_alloc(ctx->settings, len + 1);
+		if (!buf) {
+			return 0;
+		}
+	}
+	memcpy(buf, start, len);
 	buf[len] = 0;
-	return buf;
+	out->doubleval = cjson_strtod(buf);
+	if (buf != scratch) {
+		cjson_free(ctx->settings, buf);
+	}
+	return 1;
 }
 
-char* cjson_consume_ident(cjson_context* ctx) // null, true, false
+// Copies the consumed identifier into scratch (CJSON_SCRATCH_SIZE bytes) when it fits, otherwise into a buffer that must be freed with cjson_free.
+char* cjson_consume_ident(cjson_context* ctx, char* scratch) // null, true, false
 {
 	size_t s_ofs = ctx->pos->ofs;
 	while (!cjson_eof(ctx) && isalnum(cjson_curc(ctx))) {
 		cjson_consume(ctx);
 	}
+	if (cjson_need_more(ctx)) {
+		return NULL;
+	}
 	size_t e_ofs = ctx->pos->ofs;
 
 	size_t len = e_ofs - s_ofs;
-	char* buf = cjson_alloc(ctx->settings, len + 1);
-	if (!buf) {
-		return NULL;
+	char* buf = scratch;
+	if (len >= CJSON_SCRATCH_SIZE) {
+		buf = cjson_alloc(ctx->settings, len + 1);
+		if (!buf) {
+			return NULL;
+		}
 	}
 
 	memcpy(buf, ctx->buf + s_ofs, len);
@@ -403,69 +1497,182 @@ char* cjson_consume_ident(cjson_context* ctx) // null, true, false
 	return buf;
 }
 
-// TODO: Take cjson_pos** as out parameter
-char* cjson_consume_str(cjson_context* ctx) // "string"
+// Returns NULL when the string contents [p, end) are valid UTF-8, otherwise the first byte that is not (end when the
+// last sequence is cut short by the closing quote). Runs of ASCII are skipped 8 bytes at a time.
+const char* cjson_utf8_validate_string(const char* p, const char* end)
 {
-	if (cjson_curc(ctx) != '"') {
-		return NULL;
-	}
-	cjson_consume(ctx); // "
+	const unsigned long long highs = 0x8080808080808080ULL;
+	const unsigned char* u = (const unsigned char*)p;
+	const unsigned char* e = (const unsigned char*)end;
+
+	while (u < e) {
+		unsigned long long word;
+		if (e - u >= 8 && (memcpy(&word, u, sizeof(word)), !(word & highs))) {
+			u += 8;
+			continue;
+		}
 
-	size_t s_ofs = ctx->pos->ofs;
-	while (!cjson_eof(ctx)) {
-		char c = cjson_curc(ctx);
+		unsigned char c = *u;
+		if (c < 0x80) {
+			++u;
+			continue;
+		}
 
-		if (c == '\\') {
-			// next character is escaped as wel
-			cjson_consume(ctx);
-			cjson_consume(ctx);
+		// The range of the second byte rules out overlong forms, surrogates and code points above U+10FFFF.
+		if (c < 0xC2 || c > 0xF4) {
+			return (const char*)u;
 		}
-		else if (c == '"') {
-			break; // Break out here.
+		unsigned char lo = c == 0xE0 ? 0xA0 : c == 0xF0 ? 0x90 : 0x80;
+		unsigned char hi = c == 0xED ? 0x9F : c == 0xF4 ? 0x8F : 0xBF;
+		if (u + 1 == e || u[1] < lo || u[1] > hi) {
+			return (const char*)u + 1;
 		}
-		else {
-			cjson_consume(ctx);
+		if (c < 0xE0) {
+			u += 2;
+			continue;
 		}
+		if (u + 2 == e || (u[2] & 0xC0) != 0x80) {
+			return (const char*)u + 2;
+		}
+		if (c < 0xF0) {
+			u += 3;
+			continue;
+		}
+		if (u + 3 == e || (u[3] & 0xC0) != 0x80) {
+			return (const char*)u + 3;
+		}
+		u += 4;
+	}
+	return NULL;
+}
+
+// Consumes a string, pointing *str at its (still escaped) contents inside of the buffer. Returns 0 on failure.
+int cjson_consume_str_view(cjson_context* ctx, const char** str, size_t* len) // "string"
+{
+	if (cjson_curc(ctx) != '"') {
+		return 0;
+	}
+	cjson_consume(ctx); // "
+
+	size_t s_ofs = ctx->pos->ofs;
+	const char* end = ctx->buf + ctx->len;
+	const char* p = cjson_scan.string(ctx->buf + s_ofs, end);
+	while (p < end && *p == '\\') {
+		// next character is escaped as well
+		p = end - p > 2 ? cjson_scan.string(p + 2, end) : end;
 	}
+	ctx->pos->ofs = p - ctx->buf;
 	size_t e_ofs = ctx->pos->ofs;
 
 	if (cjson_eof(ctx)) {
-		ctx->settings->errc = cjson_error_code_syntax_unexpected_eof;
-		return NULL;
+		if (!cjson_need_more(ctx)) {
+			ctx->settings->errc = cjson_error_code_syntax_unexpected_eof;
+		}
+		return 0;
+	}
+
+	const char* invalid = NULL;
+	if (!ctx->utf8_checked) {
+		invalid = cjson_utf8_validate_string(ctx->buf + s_ofs, p);
+	}
+	else if (ctx->utf8_invalid >= s_ofs && ctx->utf8_invalid <= e_ofs) {
+		invalid = ctx->buf + ctx->utf8_invalid;
+	}
+	if (invalid) {
+		ctx->pos->ofs = invalid - ctx->buf;
+		ctx->settings->errc = cjson_error_code_syntax_invalid_utf8;
+		return 0;
 	}
 	cjson_consume(ctx); // "
 
+	*str = ctx->buf + s_ofs;
+	*len = e_ofs - s_ofs;
+	return 1;
+}
+
+// Returns the contents of a string consumed by cjson_consume_str_view as a NUL-terminated string (see cjson_ctx_free_string).
+char* cjson_ctx_string(cjson_context* ctx, const char* str, size_t len)
+{
 	// TODO: escape!
-	size_t len = e_ofs - s_ofs;
-	char* buf = cjson_alloc(ctx->settings, len + 1);
-	memcpy(buf, ctx->buf + s_ofs, len);
+	if (ctx->insitu) {
+		// Terminate the string by overwriting its closing quote, it is then used straight from the buffer.
+		ctx->insitu[str + len - ctx->buf] = 0;
+		return (char*)str;
+	}
+
+	char* buf = cjson_ctx_alloc(ctx, len + 1);
+	if (!buf) {
+		return NULL;
+	}
+	memcpy(buf, str, len);
 	buf[len] = 0;
 
 	return buf;
 }
 
+// Same as cjson_ctx_string for keys, which are interned when parsing into a document. *kv_flags receives the flags the
+// key-value of the key has to be inserted with.
+char* cjson_ctx_key(cjson_context* ctx, const char* str, size_t len, int* kv_flags)
+{
+	if (ctx->doc) {
+		*kv_flags = cjson_interned;
+		return cjson_document_intern(ctx->doc, str, len);
+	}
+
+	*kv_flags = ctx->insitu ? cjson_borrowed : 0;
+	return cjson_ctx_string(ctx, str, len);
+}
+
+// TODO: Take cjson_pos** as out parameter
+char* cjson_consume_str(cjson_context* ctx) // "string"
+{
+	const char* str;
+	size_t len;
+	if (!cjson_consume_str_view(ctx, &str, &len)) {
+		return NULL;
+	}
+
+	return cjson_ctx_string(ctx, str, len);
+}
+
 int cjson_consume_comments(cjson_context* ctx) 
 {
+	const char* p = ctx->buf + ctx->pos->ofs;
+	const char* end = ctx->buf + ctx->len;
+
+	// Incomplete comments are left alone until the rest of the input arrives.
+	if (cjson_curc(ctx) == '/' && !ctx->final && end - p < 2) {
+		ctx->need_more = 1;
+		return 0;
+	}
+
 	if (cjson_curc(ctx) == '/' && cjson_peek(ctx, 1) == '/') {
-		while (!cjson_eof(ctx) && cjson_curc(ctx) != '\n') {
-			cjson_consume(ctx);
+		// consume up to and including the final newline
+		const char* nl = memchr(p, '\n', end - p);
+		if (!nl && !ctx->final) {
+			ctx->need_more = 1;
+			return 0;
 		}
-
-		cjson_consume(ctx); // consume final newline
+		ctx->pos->ofs = nl ? (size_t)(nl + 1 - ctx->buf) : ctx->len;
 		return 1;
 	}
 	
 	if (cjson_curc(ctx) == '/' && cjson_peek(ctx, 1) == '*') {
-		while (!cjson_eof(ctx) && cjson_curc(ctx) != '*' && cjson_peek(ctx, 1) != '/') {
-			cjson_consume(ctx);
+		// consume up to and including the trailing */, or everything if it is missing
+		const char* star = p + 2;
+		while (star < end && (star = memchr(star, '*', end - star)) != NULL) {
+			if (star + 1 < end && star[1] == '/') {
+				ctx->pos->ofs = star + 2 - ctx->buf;
+				return 1;
+			}
+			++star;
 		}
 
-		// Remove trailing */
-		if (cjson_curc(ctx) == '*' && cjson_peek(ctx, 1) == '/') {
-			cjson_consume(ctx);
-			cjson_consume(ctx);
+		if (!ctx->final) {
+			ctx->need_more = 1;
+			return 0;
 		}
-
+		ctx->pos->ofs = ctx->len;
 		return 1;
 	}
 
@@ -473,31 +1680,51 @@ int cjson_consume_comments(cjson_context* ctx)
 }
 
 void cjson_consume_spaces(cjson_context* ctx) {
-	while (!cjson_eof(ctx) && isspace(cjson_curc(ctx))) {
-		cjson_consume(ctx);
-	}
+	ctx->pos->ofs = cjson_scan.spaces(ctx->buf + ctx->pos->ofs, ctx->buf + ctx->len) - ctx->buf;
 }
 
-cjson_value* cjson_value_create(cjson_settings* settings)
+// Allocates a value from doc when it is nonnull, otherwise from the settings allocator.
+cjson_value* cjson_value_create(cjson_settings* settings, cjson_document* doc)
 {
-	cjson_value* value = cjson_alloc(settings, sizeof(cjson_value));
-	if (!value) {
-		return NULL;
+	cjson_value* value;
+	int flags = cjson_invalid;
+
+	if (doc) {
+		cjson_pooled_value* pooled = cjson_document_alloc(doc, sizeof(cjson_pooled_value));
+		if (!pooled) {
+			return NULL;
+		}
+		pooled->doc = doc;
+		value = &pooled->value;
+		flags |= cjson_pooled;
+	}
+	else {
+		value = cjson_alloc(settings, sizeof(cjson_value));
+		if (!value) {
+			return NULL;
+		}
 	}
 
 	value->prev = NULL;
 	value->next = NULL;
 	value->child = NULL;
 	value->childtail = NULL;
-	value->flags = cjson_invalid;
+	value->flags = flags;
 	value->string = NULL;
-	value->doubleval = 0;
+	value->doubleval = 0; // also clears index, vector and keyhash
 	value->intval = 0;
 
 	return value;
 }
 
 void cjson_free_value(cjson_value *v)
+{
+	if (v) {
+		cjson_free_value_ex(cjson_global_settings(), v);
+	}
+}
+
+void cjson_free_value_ex(cjson_settings* settings, cjson_value* v)
 {
 	if (v) {
 		cjson_value* next = v->next;
@@ -506,12 +1733,24 @@ void cjson_free_value(cjson_value *v)
 			next = next->next;
 
 			tmp->next = NULL;
-			cjson_free_value(tmp);
+			cjson_free_value_ex(settings, tmp);
 		}
 
-		cjson_free_value(v->child);
-		cjson_free(global_settings, v->string);
-		cjson_free(global_settings, v);
+		cjson_free_value_ex(settings, v->child);
+
+		// Pooled values (and their strings) belong to a document, only their heap children are freed here.
+		if (!(v->flags & cjson_pooled)) {
+			if (!(v->flags & cjson_borrowed)) {
+				cjson_free(settings, v->string);
+			}
+			if (v->flags & cjson_object) {
+				cjson_free(settings, v->index);
+			}
+			else if (v->flags & cjson_array) {
+				cjson_free(settings, v->vector);
+			}
+			cjson_free(settings, v);
+		}
 	}
 }
 
@@ -530,104 +1769,227 @@ int cjson_partial_parse(cjson_context* ctx, cjson_value** out)
 	if (!out) {
 		return 0;
 	}
-	
-	const char *reason = 0;
+
 	if (!*out) {
-		*out = cjson_value_create(ctx->settings);
+		*out = cjson_value_create(ctx->settings, ctx->doc);
 	}
 
 	if (!*out) {
-		fprintf(stderr, "Panic! memory failure\n");
-		exit(1);
+		return 0; // errc was set by the allocator
+	}
+
+	if (cjson_need_more(ctx)) {
+		goto error;
 	}
 
 	char c = cjson_curc(ctx);
+	char scratch[CJSON_SCRATCH_SIZE];
+	int pooled = (*out)->flags & cjson_pooled;
+	int borrowed = ctx->insitu ? cjson_borrowed : 0;
 
 	if (c == '{') {
-		(*out)->flags = cjson_object;
+		(*out)->flags = cjson_object | pooled;
 		cjson_consume(ctx);
 	}
 	else if (c == '[') {
-		(*out)->flags = cjson_array;
+		(*out)->flags = cjson_array | pooled;
 		cjson_consume(ctx);
 	}
 	else if (c == '"') {
-		(*out)->flags = cjson_string;
+		(*out)->flags = cjson_string | pooled | borrowed;
 		(*out)->string = cjson_consume_str(ctx);
 
 		if (!(*out)->string) {
-			reason = "string parse failed";
 			goto error;
 		}
 	}
 	else if (isdigit(c) || c == '.' || c == '-') {
-		int punctflag = 0;
-		char* buf = cjson_consume_digits(ctx, &punctflag);
-		if (!buf) {
-			reason = "digits parse failed";
+		cjson_number_value number;
+		if (!cjson_consume_number(ctx, &number)) {
 			goto error;
 		}
 
-		if (punctflag) {
-			(*out)->flags = cjson_number | cjson_double;
-			(*out)->doubleval = strtod(buf, NULL);
+		(*out)->flags = cjson_number | number.flags | pooled;
+		if (number.flags & cjson_double) {
+			(*out)->doubleval = number.doubleval;
 		}
 		else {
-			(*out)->flags = cjson_number | cjson_integer;
-			(*out)->intval = strtol(buf, NULL, 0);
+			(*out)->intval = number.intval;
 		}
-
-		cjson_free(ctx->settings, buf);
 	}
 	else if (isalnum(c)) {
-		char* buf = cjson_consume_ident(ctx);
+		char* buf = cjson_consume_ident(ctx, scratch);
 
 		if (!buf) {
-			reason = "identifier parse failed";
 			goto error;
 		}
 
+		int known = 1;
 		if (stricmp(buf, "null") == 0) {
-			(*out)->flags = cjson_null;
+			(*out)->flags = cjson_null | pooled;
 		}
 		else if (stricmp(buf, "true") == 0 || stricmp(buf, "false") == 0) {
-			(*out)->flags = cjson_boolean;
+			(*out)->flags = cjson_boolean | pooled;
 			(*out)->intval = tolower(buf[0]) == 't';
 		}
 		else {
-			printf("could not find anything from ident: %s\n", buf);
+			ctx->settings->errc = cjson_error_code_syntax_unexpected_character;
+			known = 0;
+		}
+
+		if (buf != scratch) {
 			cjson_free(ctx->settings, buf);
+		}
+		if (!known) {
 			goto error;
 		}
-
-		cjson_free(ctx->settings, buf);
 	}
 	else {
-		reason = "Unknown character";
+		// i.e. '{"a":' where the input ends instead of the value.
+		ctx->settings->errc = cjson_eof(ctx) ? cjson_error_code_syntax_unexpected_eof : cjson_error_code_syntax_unexpected_character;
 		goto error;
 	}
 
 	return 1;
 
 	error:
-	printf("partial parse failed with reason '%s' for character '%c'\n", reason, c);
-	cjson_free(ctx->settings, *out);
+	cjson_ctx_free(ctx, *out);
 	*out = NULL;
 	return 0;
 }
 
+// Decides what happens to the member key (of key_len bytes, not NUL-terminated) or the element at index key_len
+// (when key is NULL) of a container that is being projected:
+// returns -2 when no path leads into it, -1 when a path ends at it so that it is kept whole, and the depth of the child
+// otherwise. *paths then holds the paths that continue into the child, which is only kept when it is a container.
+int cjson_project(cjson_context* ctx, cjson_state* state, const char* key, size_t key_len, unsigned long long* paths)
+{
+	size_t index = key_len;
+	*paths = 0;
+	for (unsigned long long left = state->paths; left; left &= left - 1) {
+		int i = __builtin_ctzll(left);
+		const cjson_path* path = ctx->projection->paths[i];
+		const cjson_path_step* step = &path->steps[state->depth];
+
+		int match = 0;
+		switch (step->type) {
+			case cjson_path_key: match = key ? strncmp(step->key, key, key_len) == 0 && !step->key[key_len] : step->index == (long long)index; break;
+			case cjson_path_index: match = !key && step->index == (long long)index; break;
+			case cjson_path_wildcard: match = 1; break;
+			case cjson_path_slice: match = !key && (!step->has_start || (long long)index >= step->start) && (!step->has_end || (long long)index < step->end); break;
+		}
+
+		if (match) {
+			if ((size_t)state->depth + 1 == path->count) {
+				return -1;
+			}
+			*paths |= 1ULL << i;
+		}
+	}
+
+	if (!*paths) {
+		return -2;
+	}
+
+	char c = cjson_curc(ctx);
+	return c == '[' || c == '{' ? state->depth + 1 : -2;
+}
+
+// Called when the container of state is closed. A projected container (other than the root) that none of the paths
+// continuing into it matched is dropped from its parent, i.e. "*>y" over {"a":[]} does not keep "a".
+void cjson_project_close(cjson_context* ctx, cjson_state* state)
+{
+	if (state->depth <= 0 || state->wip_value->intval != 0) {
+		return;
+	}
+
+	cjson_value* p = state->prev->wip_value;
+	if (cjson_is_object(p)) {
+		cjson_erase_kv_from_tree(ctx->settings, p, cjson_end(p));
+	}
+	else {
+		cjson_eraseidx_ex(ctx->settings, p, p->intval - 1);
+	}
+}
+
+// Consumes the value at the current position without building it. Containers are only checked for balanced
+// brackets (see cjson_skip_container), skipped scalars are not checked at all.
+int cjson_skip_value(cjson_context* ctx)
+{
+	char c = cjson_curc(ctx);
+	if (c == '"') {
+		const char* str;
+		size_t len;
+		return cjson_consume_str_view(ctx, &str, &len);
+	}
+	if (c == '[' || c == '{') {
+		cjson_consume(ctx);
+		return cjson_skip_container(ctx);
+	}
+
+	size_t start = ctx->pos->ofs;
+	while (!cjson_eof(ctx)) {
+		c = cjson_curc(ctx);
+		if (cjson_is_space_table[(unsigned char)c] || c == ',' || c == ':' || c == ']' || c == '}' || c == '/') {
+			break;
+		}
+		cjson_consume(ctx);
+	}
+
+	if (ctx->pos->ofs == start) {
+		ctx->settings->errc = cjson_error_code_syntax_unexpected_character;
+		return 0;
+	}
+	return 1;
+}
+
+// Pushes the state of a value that was just parsed into a container, when it is a container itself.
+// Enters val when it is a container. Returns 0 if its state could not be allocated.
+int cjson_push_value_state(cjson_context* ctx, cjson_value* val, int depth, unsigned long long paths)
+{
+	cjson_state* state = NULL;
+	if (cjson_is_array(val)) {
+		state = cjson_push_state(ctx, in_array, val, parse_flag_expecting_valuetype);
+	}
+	else if (cjson_is_object(val)) {
+		state = cjson_push_state(ctx, in_object, val, parse_flag_expecting_valuetype);
+	}
+	else {
+		return 1;
+	}
+
+	if (!state) {
+		return 0;
+	}
+
+	state->depth = depth;
+	state->paths = paths;
+	return 1;
+}
+
 cjson_value* cjson_parse_impl(cjson_context* ctx)
 {
 	while (1) {
+		// Everything consumed in this iteration is rolled back when it runs out of (non-final) input.
+		ctx->token_start = ctx->pos->ofs;
+
 		// Whitespace and comments
 		do {
 			cjson_consume_spaces(ctx);
 		} while(cjson_consume_comments(ctx));
 
+		if (ctx->need_more || cjson_need_more(ctx)) {
+			return NULL;
+		}
+
 		if (cjson_eof(ctx)) {
 			break;
 		}
 
+		if (ctx->single && ctx->tail_state == ctx->root_state && ctx->root_state->wip_value != NULL) {
+			break;
+		}
+
 		char c = cjson_curc(ctx);
 
 		switch (ctx->tail_state->type) {
@@ -635,7 +1997,6 @@ cjson_value* cjson_parse_impl(cjson_context* ctx)
 			{
 				// Has a root node already been discovered?
 				if (ctx->root_state->wip_value != NULL) {
-					cjson_free_value(ctx->root_state->wip_value);
 					ctx->settings->errc = cjson_error_code_syntax_multiple_root_nodes;
 					return NULL;
 				}
@@ -643,11 +2004,21 @@ cjson_value* cjson_parse_impl(cjson_context* ctx)
 					return NULL;
 				}
 
-				if (cjson_is_array(ctx->root_state->wip_value)) {
-					cjson_push_state(ctx, in_array, ctx->root_state->wip_value, parse_flag_expecting_valuetype);
+				// When projecting, every path starts out at the root (unless a path selects the whole root).
+				int depth = -1;
+				unsigned long long paths = 0;
+				if (ctx->projection) {
+					for (size_t i = 0; i < ctx->projection->count; ++i) {
+						paths |= 1ULL << i;
+						if (ctx->projection->paths[i]->count == 0) {
+							paths = 0;
+							break;
+						}
+					}
+					depth = paths ? 0 : -1;
 				}
-				else if (cjson_is_object(ctx->root_state->wip_value)) {
-					cjson_push_state(ctx, in_object, ctx->root_state->wip_value, parse_flag_expecting_valuetype);
+				if (!cjson_push_value_state(ctx, ctx->root_state->wip_value, depth, paths)) {
+					return NULL;
 				}
 			}
 			break;
@@ -669,24 +2040,40 @@ cjson_value* cjson_parse_impl(cjson_context* ctx)
 				}
 
 				if (c == ']') {
+					// The root state is only an array for the chunks of cjson_parse_parallel, which never contain its end.
+					if (state == ctx->root_state) {
+						ctx->settings->errc = cjson_error_code_syntax_multiple_root_nodes;
+						return NULL;
+					}
+
 					// End of array.
 					cjson_consume(ctx);
+					cjson_project_close(ctx, state);
 					cjson_pop_state(ctx);
 					continue;
 				}
 
-				// Otherwise we are expecting a value.
-				cjson_value* child = NULL;
-				if (!cjson_partial_parse(ctx, &child)) {
-					return NULL;
+				// Otherwise we are expecting a value, which is skipped when no projected path leads into it.
+				int depth = -1;
+				unsigned long long paths = 0;
+				if (state->depth >= 0) {
+					depth = cjson_project(ctx, state, NULL, state->elements++, &paths);
 				}
-				cjson_append(state->wip_value, child);
-				
-				if (cjson_is_array(child)) {
-					cjson_push_state(ctx, in_array, child, parse_flag_expecting_valuetype);
+
+				if (depth == -2) {
+					if (!cjson_skip_value(ctx)) {
+						return NULL;
+					}
 				}
-				else if (cjson_is_object(child)) {
-					cjson_push_state(ctx, in_object, child, parse_flag_expecting_valuetype);
+				else {
+					cjson_value* child = NULL;
+					if (!cjson_partial_parse(ctx, &child)) {
+						return NULL;
+					}
+					cjson_append_ex(ctx->settings, state->wip_value, child);
+					if (!cjson_push_value_state(ctx, child, depth, paths)) {
+						return NULL;
+					}
 				}
 
 				// Remove expecting value type and add after value parse flags
@@ -714,6 +2101,7 @@ cjson_value* cjson_parse_impl(cjson_context* ctx)
 				if (c == '}') {
 					// End of array.
 					cjson_consume(ctx);
+					cjson_project_close(ctx, state);
 					cjson_pop_state(ctx);
 					continue;
 				}
@@ -723,35 +2111,61 @@ cjson_value* cjson_parse_impl(cjson_context* ctx)
 					return NULL;
 				}
 
-				// Key
-				char* key = cjson_consume_str(ctx);
-				if (!key) {
+				// Key, it is only copied once its value turns out to be kept.
+				const char* key_view;
+				size_t key_len;
+				if (!cjson_consume_str_view(ctx, &key_view, &key_len)) {
 					return NULL;
 				}
 
 				cjson_consume_spaces(ctx); // consume ws
+				if (cjson_need_more(ctx)) {
+					return NULL;
+				}
 				if (cjson_curc(ctx) != ':') {
 					ctx->settings->errc = cjson_error_code_syntax_expected_colon;
-					cjson_free(ctx->settings, key);
 					return NULL;
 				}
 				cjson_consume(ctx);
 				cjson_consume_spaces(ctx); // consume ws
 
+				// Values no projected path leads into are skipped without being built.
+				int depth = -1;
+				unsigned long long paths = 0;
+				if (state->depth >= 0) {
+					depth = cjson_project(ctx, state, key_view, key_len, &paths);
+				}
+
+				if (depth == -2) {
+					if (!cjson_skip_value(ctx)) {
+						return NULL;
+					}
+					state->parse_flags &= ~parse_flag_expecting_valuetype;
+					state->parse_flags |= parse_flag_after_value;
+					continue;
+				}
+
+				int kv_flags;
+				char* key = cjson_ctx_key(ctx, key_view, key_len, &kv_flags);
+				if (!key) {
+					return NULL;
+				}
+
 				cjson_value* val = 0;
 				if (!cjson_partial_parse(ctx, &val)) {
-					cjson_free(ctx->settings, key);
+					cjson_ctx_free_string(ctx, key);
 					return NULL;
 				}
 
-				cjson_insert(state->wip_value, key, val);
-				cjson_free(ctx->settings, key);
-
-				if (cjson_is_array(val)) {
-					cjson_push_state(ctx, in_array, val, parse_flag_expecting_valuetype);
+				// The key is adopted by the kv instead of being copied once more.
+				if (!cjson_insert_kv(ctx->settings, ctx->doc, state->wip_value, key, val, kv_flags)) {
+					cjson_ctx_free_string(ctx, key);
+					cjson_free_value_ex(ctx->settings, val);
+					return NULL;
 				}
-				else if (cjson_is_object(val)) {
-					cjson_push_state(ctx, in_object, val, parse_flag_expecting_valuetype);
+
+				if (!cjson_push_value_state(ctx, val, depth, paths)) {
+					return NULL;
 				}
 
 				// Remove expecting value type and add after value parse flags
@@ -771,536 +2185,5698 @@ cjson_value* cjson_parse_impl(cjson_context* ctx)
 		ctx->root_state->wip_value : NULL;
 }
 
-cjson_value* cjson_parse_ex(cjson_settings* settings, const char* buffer)
+/*================ Structural index engine ================*/
+
+// Offsets of the tokens of the input, built by cjson_index_structurals.
+typedef struct {
+	unsigned int* offsets;
+	size_t count;
+	size_t capacity;
+	int comments; // set when a '/' is found outside of strings, such input is left to cjson_parse_impl.
+	size_t utf8_invalid; // offset of the first byte inside of a string that is not valid UTF-8, (size_t)-1 when there is none.
+} cjson_structural_index;
+
+// UTF-8 decoder state carried across blocks: pending is the amount of continuation bytes that must still follow,
+// [lo, hi] the range of the next one (which rules out overlong forms, surrogates and code points above U+10FFFF).
+typedef struct {
+	int pending;
+	unsigned char lo;
+	unsigned char hi;
+} cjson_utf8_state;
+
+// Returns a pointer to the first byte in [p, end) that is not valid UTF-8, or end.
+const char* cjson_utf8_validate(cjson_utf8_state* state, const char* p, const char* end)
 {
-	TIMER_INIT();
-
-	if (!settings) {
-		return NULL;
-	}
-	if (!buffer) {
-		return NULL;
-	}
-
-	if (global_settings != settings) {
-		free(global_settings);
-		global_settings = settings;
-	}
-
-	size_t len = strlen(buffer);
-	if (!len) {
-		return NULL;
-	}
-
-	cjson_context ctx;
-	ctx.root_state = NULL;
-	ctx.tail_state = NULL;
-	ctx.settings = settings;
-	ctx.buf = buffer;
-	ctx.len = len;
-	ctx.pos = cjson_make_pos(ctx.settings, 0, 0, 0); 
-	cjson_push_state(&ctx, initial_state, NULL, 0);
-	cjson_value* val = cjson_parse_impl(&ctx);
-	int free_root_node = 0;
-	if (!val) {
-		free_root_node = 1;
+	for (; p < end; ++p) {
+		unsigned char c = (unsigned char)*p;
+		if (state->pending) {
+			if (c < state->lo || c > state->hi) {
+				return p;
+			}
+			state->lo = 0x80;
+			state->hi = 0xBF;
+			--state->pending;
+		}
+		else if (c >= 0x80) {
+			if (c < 0xC2 || c > 0xF4) {
+				return p;
+			}
+			state->pending = c < 0xE0 ? 1 : c < 0xF0 ? 2 : 3;
+			state->lo = c == 0xE0 ? 0xA0 : c == 0xF0 ? 0x90 : 0x80;
+			state->hi = c == 0xED ? 0x9F : c == 0xF4 ? 0x8F : 0xBF;
+		}
 	}
-	cjson_free(settings, ctx.pos);
-	cjson_free_remaining_states(&ctx, free_root_node);
-	return val;
+	return p;
 }
 
-cjson_value* cjson_create_empty()
+// Returns the bytes of a block that are escaped by a backslash. *carry is 1 when the first byte of the next block is.
+unsigned long long cjson_block_escaped(unsigned long long backslash, unsigned long long* carry)
 {
-	if (!global_settings) cjson_init(NULL);
-
-	cjson_value* empty = cjson_value_create(global_settings);
-	if (!empty) {
-		return NULL;
-	}
-
-	return empty;
+	const unsigned long long even = 0x5555555555555555ULL;
+
+	// Runs of backslashes escape the byte after them when they are of odd length.
+	backslash &= ~*carry;
+	unsigned long long follows_escape = backslash << 1 | *carry;
+	unsigned long long odd_starts = backslash & ~even & ~follows_escape;
+	unsigned long long even_runs;
+	*carry = __builtin_add_overflow(odd_starts, backslash, &even_runs);
+	return (even ^ (even_runs << 1)) & follows_escape;
 }
 
-cjson_value* cjson_create_object()
-{
-	cjson_value* obj = cjson_create_empty();
-	if (!obj) return NULL;
-
-	obj->flags = cjson_object;
-	return obj;
-}
-cjson_value* cjson_create_array()
+// Bit i of the result is the xor of bits 0..i of x, which turns the (unescaped) quotes into the bytes inside of strings.
+unsigned long long cjson_prefix_xor(unsigned long long x)
 {
-	cjson_value* arr = cjson_create_empty();
-	if (!arr) return NULL;
-
-	arr->flags = cjson_array;
-	return arr;
+	x ^= x << 1;
+	x ^= x << 2;
+	x ^= x << 4;
+	x ^= x << 8;
+	x ^= x << 16;
+	x ^= x << 32;
+	return x;
 }
-cjson_value* cjson_create_null()
-{
-	cjson_value* nil = cjson_create_empty();
-	if (!nil) return NULL;
 
-	nil->flags = cjson_null;
-	return nil;
-}
-cjson_value* cjson_create_boolean(int value)
+int cjson_structural_index_grow(cjson_settings* settings, cjson_structural_index* index)
 {
-	cjson_value* b = cjson_create_empty();
-	if (!b) return NULL;
+	unsigned int* offsets = cjson_alloc(settings, index->capacity * 2 * sizeof(unsigned int));
+	if (!offsets) {
+		return 0;
+	}
 
-	b->flags = cjson_boolean;
-	b->intval = value;
-	return b;
+	memcpy(offsets, index->offsets, index->count * sizeof(unsigned int));
+	cjson_free(settings, index->offsets);
+	index->offsets = offsets;
+	index->capacity *= 2;
+	return 1;
 }
-cjson_value* cjson_create_int(int value)
-{
-	cjson_value* i = cjson_create_empty();
-	if (!i) return NULL;
 
-	i->flags = cjson_number | cjson_integer;
-	i->intval = value;
-	return i;
-}
-cjson_value* cjson_create_double(double value)
+// Stage one: classifies the input 64 bytes at a time and records the offset of every token, that is every bracket,
+// comma and colon outside of strings, every opening quote and the first byte of every other scalar (numbers and
+// literals). UTF-8 is validated along the way (blocks without any bytes above 0x7F are skipped), see utf8_invalid.
+// Returns 0 on failure.
+int cjson_index_structurals(cjson_context* ctx, cjson_structural_index* index)
 {
-	cjson_value* d = cjson_create_empty();
-	if (!d) return NULL;
+	const char* buffer = ctx->buf;
+	size_t len = ctx->len;
+	unsigned long long escaped = 0; // 1 when the next block starts with an escaped byte
+	unsigned long long in_string = 0; // all ones when the next block starts inside of a string
+	unsigned long long in_scalar = 0; // 1 when the previous block ends inside of a scalar
+	cjson_utf8_state utf8 = { 0, 0x80, 0xBF };
+	char tail[64];
+
+	index->count = 0;
+	index->capacity = len / 4 + 64;
+	index->comments = 0;
+	index->utf8_invalid = (size_t)-1;
+	index->offsets = cjson_alloc(ctx->settings, index->capacity * sizeof(unsigned int));
+	if (!index->offsets) {
+		return 0;
+	}
 
-	d->flags = cjson_number | cjson_double;
-	d->doubleval = value;
-	return d;
-}
-cjson_value* cjson_create_string(const char* string)
-{
-	cjson_value* s = cjson_create_empty();
-	if (!s) return NULL;
+	for (size_t ofs = 0; ofs < len; ofs += 64) {
+		const char* p = buffer + ofs;
+		if (len - ofs < 64) {
+			memset(tail, ' ', sizeof(tail));
+			memcpy(tail, p, len - ofs);
+			p = tail;
+		}
 
-	s->flags = cjson_string;
-	cjson_set_string(s, string);
-	return s;
-}
+		cjson_block block;
+		cjson_scan.classify(p, &block);
+		unsigned long long quotes = block.quote & ~cjson_block_escaped(block.backslash, &escaped);
+		unsigned long long strings = cjson_prefix_xor(quotes) ^ in_string; // includes the opening quotes
+		in_string = 0 - (strings >> 63);
+		if (block.slash & ~strings) {
+			// Left to cjson_parse_impl before this block is validated, so that neither engine checks comments.
+			index->comments = 1;
+			return 1;
+		}
 
-int cjson_is_string(cjson_value* v) { return v->flags & cjson_string; }
-int cjson_is_number(cjson_value* v) { return v->flags & cjson_number; }
-int cjson_is_double(cjson_value* v) { return (v->flags & (cjson_number | cjson_double)) == (cjson_number | cjson_double); }
-int cjson_is_integer(cjson_value* v) { return (v->flags & (cjson_number | cjson_integer)) == (cjson_number | cjson_integer); }
-int cjson_is_object(cjson_value* v) { return v->flags & cjson_object; }
-int cjson_is_array(cjson_value* v) { return v->flags & cjson_array; }
-int cjson_array_length(cjson_value* v) { return v->intval; }
-cjson_value* cjson_array_at(cjson_value* v, int i)
-{
-	int j = 0;
-	v = v->child;
-	while (v != NULL) {
-		if (j == i) {
-			return v;
+		// Invalid UTF-8 inside of a string (or cut short by its closing quote) only fails once stage two reaches that
+		// string, elsewhere it is an unexpected character. Either way the first error in the input is the one reported.
+		if (block.high || utf8.pending) {
+			unsigned long long contents = (strings & ~quotes) | (quotes & ~strings);
+			const char* q = p;
+			while ((q = cjson_utf8_validate(&utf8, q, p + 64)) != p + 64) {
+				if (index->utf8_invalid == (size_t)-1 && (contents >> (q - p) & 1)) {
+					index->utf8_invalid = ofs + (q - p);
+				}
+				utf8.pending = 0;
+				++q;
+			}
 		}
 
-		++j;
-		v = v->next;
+		unsigned long long ops = (block.open | block.close | block.comma | block.colon) & ~strings;
+		unsigned long long scalars = ~(ops | block.space | quotes | strings);
+		unsigned long long tokens = ops | (quotes & strings) | (scalars & ~(scalars << 1 | in_scalar));
+		in_scalar = scalars >> 63;
+
+		if (index->capacity - index->count < 64 && !cjson_structural_index_grow(ctx->settings, index)) {
+			return 0;
+		}
+		while (tokens) {
+			index->offsets[index->count++] = (unsigned int)(ofs + __builtin_ctzll(tokens));
+			tokens &= tokens - 1;
+		}
 	}
 
-	return NULL;
+	return 1;
 }
-int cjson_is_boolean(cjson_value* v) { return v->flags & cjson_boolean; }
-int cjson_is_null(cjson_value* v) { return v->flags & cjson_null; }
-
-const char* cjson_get_string(cjson_value* v) { return v->string; }
-double cjson_get_double(cjson_value* v) { return v->doubleval; }
-int cjson_get_integer(cjson_value* v) { return v->intval; }
 
-int cjson_true(cjson_value* v)
-{
-	return v && v->intval == 1;
-}
-int cjson_false(cjson_value* v)
+// Returns nonzero when the value just parsed is directly followed by more bytes of its scalar run (i.e. "true-1"), next
+// being the offset of the following token. cjson_parse_impl reads those bytes as the next token, so they are handled
+// the same way here.
+int cjson_indexed_trailing(cjson_context* ctx, size_t next)
 {
-	return v && v->intval == 0;
+	size_t end = ctx->pos->ofs;
+	return end != next && !cjson_is_space_table[(unsigned char)ctx->buf[end]];
 }
 
-void cjson_set_string(cjson_value* v, const char* str)
+// Stage two: builds the tree by walking the index. Accepts the same input as cjson_parse_impl, but the next token
+// is read from the index instead of being searched for byte by byte.
+cjson_value* cjson_parse_indexed(cjson_context* ctx, const cjson_structural_index* index)
 {
-	if (!cjson_is_string(v)) {
-		return;
-	}
+	const unsigned int* offsets = index->offsets;
+	size_t count = index->count;
 
-	if (v->string) {
-		cjson_free(global_settings, v->string);
-	}
+	for (size_t i = 0; i < count; ++i) {
+		ctx->pos->ofs = offsets[i];
+		char c = ctx->buf[offsets[i]];
+		cjson_state* state = ctx->tail_state;
+		cjson_value* val = NULL;
 
-	size_t len = strlen(str);
-	v->string = cjson_alloc(global_settings, len + 1);
+		switch (state->type) {
+			case initial_state:
+			{
+				if (state->wip_value != NULL) {
+					ctx->settings->errc = cjson_error_code_syntax_multiple_root_nodes;
+					return NULL;
+				}
+				if (!cjson_partial_parse(ctx, &state->wip_value)) {
+					return NULL;
+				}
+				if (cjson_indexed_trailing(ctx, i + 1 < count ? offsets[i + 1] : ctx->len)) {
+					ctx->settings->errc = cjson_error_code_syntax_multiple_root_nodes;
+					return NULL;
+				}
+				val = state->wip_value;
+			}
+			break;
+			case in_array:
+			{
+				if (c == ',') {
+					if (!(state->parse_flags & parse_flag_after_value)) {
+						ctx->settings->errc = cjson_error_code_syntax_unexpected_comma;
+						return NULL;
+					}
+					state->parse_flags &= ~parse_flag_after_value;
+					state->parse_flags |= parse_flag_expecting_valuetype;
+					continue;
+				}
 
-	if (v->string) {
-		strcpy(v->string, str);
-	}
-}
+				if (c == ']') {
+					cjson_pop_state(ctx);
+					continue;
+				}
 
-void cjson_set_double(cjson_value* v, double d)
-{
-	if (!cjson_is_number(v)) {
+				if (!cjson_partial_parse(ctx, &val)) {
+					return NULL;
+				}
+				cjson_append_ex(ctx->settings, state->wip_value, val);
+
+				// Elements do not need a comma in between, trailing bytes are the next (scalar) element.
+				while (cjson_indexed_trailing(ctx, i + 1 < count ? offsets[i + 1] : ctx->len)) {
+					cjson_value* next = NULL;
+					if (!cjson_partial_parse(ctx, &next)) {
+						return NULL;
+					}
+					cjson_append_ex(ctx->settings, state->wip_value, next);
+				}
+
+				state->parse_flags &= ~parse_flag_expecting_valuetype;
+				state->parse_flags |= parse_flag_after_value;
+			}
+			break;
+			case in_object:
+			{
+				if (c == ',') {
+					if (!(state->parse_flags & parse_flag_after_value)) {
+						ctx->settings->errc = cjson_error_code_syntax_unexpected_comma;
+						return NULL;
+					}
+					state->parse_flags &= ~parse_flag_after_value;
+					state->parse_flags |= parse_flag_expecting_valuetype;
+					continue;
+				}
+
+				if (c == '}') {
+					cjson_pop_state(ctx);
+					continue;
+				}
+
+				if (c != '"') {
+					ctx->settings->errc = cjson_error_code_syntax_expected_key;
+					return NULL;
+				}
+
+				const char* key_view;
+				size_t key_len;
+				if (!cjson_consume_str_view(ctx, &key_view, &key_len)) {
+					return NULL;
+				}
+
+				int kv_flags;
+				char* key = cjson_ctx_key(ctx, key_view, key_len, &kv_flags);
+				if (!key) {
+					return NULL;
+				}
+
+				// Only whitespace can be between the key and its colon, anything else would be a token of its own.
+				if (i + 1 >= count || ctx->buf[offsets[i + 1]] != ':') {
+					ctx->pos->ofs = i + 1 < count ? offsets[i + 1] : ctx->len;
+					ctx->settings->errc = cjson_error_code_syntax_expected_colon;
+					cjson_ctx_free_string(ctx, key);
+					return NULL;
+				}
+				if (i + 2 >= count) {
+					ctx->pos->ofs = ctx->len;
+					ctx->settings->errc = cjson_error_code_syntax_unexpected_eof;
+					cjson_ctx_free_string(ctx, key);
+					return NULL;
+				}
+
+				i += 2;
+				ctx->pos->ofs = offsets[i];
+				if (!cjson_partial_parse(ctx, &val)) {
+					cjson_ctx_free_string(ctx, key);
+					return NULL;
+				}
+				if (cjson_indexed_trailing(ctx, i + 1 < count ? offsets[i + 1] : ctx->len)) {
+					ctx->settings->errc = cjson_error_code_syntax_expected_key;
+					cjson_ctx_free_string(ctx, key);
+					cjson_free_value_ex(ctx->settings, val);
+					return NULL;
+				}
+
+				if (!cjson_insert_kv(ctx->settings, ctx->doc, state->wip_value, key, val, kv_flags)) {
+					cjson_ctx_free_string(ctx, key);
+					cjson_free_value_ex(ctx->settings, val);
+					return NULL;
+				}
+
+				state->parse_flags &= ~parse_flag_expecting_valuetype;
+				state->parse_flags |= parse_flag_after_value;
+			}
+			break;
+		}
+
+		if (!cjson_push_value_state(ctx, val, -1, 0)) {
+			return NULL;
+		}
+	}
+
+	ctx->pos->ofs = ctx->len;
+	if (ctx->root_state != ctx->tail_state && !ctx->settings->permissive) {
+		ctx->settings->errc = cjson_error_code_syntax_unclosed_value;
+		return NULL;
+	}
+
+	return ctx->root_state->wip_value;
+}
+
+// Parses ctx with the structural index engine (see cjson_settings.structural_index) into *out. Returns 0 when the
+// input has to be parsed by cjson_parse_impl instead, that is when it has comments or is too large to index.
+int cjson_parse_structural(cjson_context* ctx, cjson_value** out)
+{
+	if (ctx->len > UINT_MAX) {
+		return 0;
+	}
+
+	cjson_structural_index index;
+	*out = NULL;
+	if (cjson_index_structurals(ctx, &index)) {
+		if (index.comments) {
+			cjson_free(ctx->settings, index.offsets);
+			return 0;
+		}
+		ctx->utf8_checked = 1;
+		ctx->utf8_invalid = index.utf8_invalid;
+		*out = cjson_parse_indexed(ctx, &index);
+	}
+
+	cjson_free(ctx->settings, index.offsets);
+	return 1;
+}
+
+// Parses the first len bytes of buffer, which does not have to be NUL-terminated unless insitu is nonzero.
+// When insitu is nonzero buffer is modified and strings of the result point into it.
+cjson_value* cjson_parse_internal(cjson_settings* settings, cjson_document* doc, const char* buffer, size_t len, int insitu)
+{
+	return cjson_parse_projection(settings, doc, buffer, len, insitu, NULL);
+}
+
+// Same as cjson_parse_internal, but only builds the values selected by projection when it is nonnull.
+cjson_value* cjson_parse_projection(cjson_settings* settings, cjson_document* doc, const char* buffer, size_t len, int insitu, const cjson_projection* projection)
+{
+	if (!settings) {
+		return NULL;
+	}
+	if (!buffer) {
+		return NULL;
+	}
+
+	settings->errc = cjson_error_code_ok;
+	if (!len) {
+		return NULL;
+	}
+
+	cjson_scan_init();
+
+	cjson_pos pos = { 0 };
+	cjson_context ctx;
+	ctx.root_state = NULL;
+	ctx.tail_state = NULL;
+	ctx.free_states = NULL;
+	ctx.settings = settings;
+	ctx.doc = doc;
+	ctx.insitu = insitu ? (char*)buffer : NULL;
+	ctx.buf = buffer;
+	ctx.len = len;
+	ctx.pos = &pos;
+	ctx.final = 1;
+	ctx.need_more = 0;
+	ctx.token_start = 0;
+	ctx.single = 0;
+	ctx.projection = projection;
+	ctx.utf8_checked = 0;
+	if (!cjson_push_state(&ctx, initial_state, NULL, 0)) {
+		return NULL;
+	}
+	cjson_value* val;
+	if (!settings->structural_index || projection || !cjson_parse_structural(&ctx, &val)) {
+		val = cjson_parse_impl(&ctx);
+	}
+	int free_root_node = 0;
+	if (!val) {
+		free_root_node = 1;
+	}
+	cjson_free_remaining_states(&ctx, free_root_node);
+	return val;
+}
+
+cjson_value* cjson_parse_ex(cjson_settings* settings, const char* buffer)
+{
+	return cjson_parse_internal(settings, NULL, buffer, buffer ? strlen(buffer) : 0, 0);
+}
+
+cjson_value* cjson_parse_n_ex(cjson_settings* settings, const char* buffer, size_t len)
+{
+	return cjson_parse_internal(settings, NULL, buffer, len, 0);
+}
+
+cjson_value* cjson_parse_insitu_ex(cjson_settings* settings, char* buffer)
+{
+	return cjson_parse_internal(settings, NULL, buffer, buffer ? strlen(buffer) : 0, 1);
+}
+
+cjson_document* cjson_parse_document_internal(cjson_settings* settings, const char* buffer, size_t len, int insitu)
+{
+	if (!settings || !buffer) {
+		return NULL;
+	}
+
+	cjson_document* doc = cjson_document_create(settings);
+	if (!doc) {
+		return NULL;
+	}
+
+	doc->root = cjson_parse_internal(settings, doc, buffer, len, insitu);
+	if (!doc->root) {
+		cjson_free_document(doc);
+		return NULL;
+	}
+
+	return doc;
+}
+
+cjson_document* cjson_parse_document_ex(cjson_settings* settings, const char* buffer)
+{
+	return cjson_parse_document_internal(settings, buffer, buffer ? strlen(buffer) : 0, 0);
+}
+
+cjson_document* cjson_parse_document_n_ex(cjson_settings* settings, const char* buffer, size_t len)
+{
+	return cjson_parse_document_internal(settings, buffer, len, 0);
+}
+
+cjson_document* cjson_parse_document_insitu_ex(cjson_settings* settings, char* buffer)
+{
+	return cjson_parse_document_internal(settings, buffer, buffer ? strlen(buffer) : 0, 1);
+}
+
+cjson_parser* cjson_parser_create_ex(cjson_settings* settings)
+{
+	if (!settings) {
+		return NULL;
+	}
+
+	settings->errc = cjson_error_code_ok;
+	cjson_scan_init();
+
+	cjson_parser* parser = cjson_alloc(settings, sizeof(cjson_parser));
+	if (!parser) {
+		return NULL;
+	}
+
+	parser->pos.ofs = 0;
+	parser->ctx.root_state = NULL;
+	parser->ctx.tail_state = NULL;
+	parser->ctx.free_states = NULL;
+	parser->ctx.settings = settings;
+	parser->ctx.doc = NULL;
+	parser->ctx.insitu = NULL;
+	parser->ctx.buf = NULL;
+	parser->ctx.len = 0;
+	parser->ctx.pos = &parser->pos;
+	parser->ctx.final = 0;
+	parser->ctx.need_more = 0;
+	parser->ctx.token_start = 0;
+	parser->ctx.single = 0;
+	parser->ctx.projection = NULL;
+	parser->ctx.utf8_checked = 0;
+	parser->buf = NULL;
+	parser->len = 0;
+	parser->cap = 0;
+	parser->retry_len = 0;
+	parser->failed = 0;
+
+	if (!cjson_push_state(&parser->ctx, initial_state, NULL, 0)) {
+		cjson_free(settings, parser);
+		return NULL;
+	}
+
+	return parser;
+}
+
+cjson_parser* cjson_parser_create(void)
+{
+	return cjson_parser_create_ex(cjson_global_settings());
+}
+
+// Returns room for at least size more bytes of input, to be committed with cjson_parser_commit.
+char* cjson_parser_reserve(cjson_parser* parser, size_t size)
+{
+	if (parser->len + size + 1 > parser->cap) {
+		size_t cap = parser->cap ? parser->cap : CJSON_PARSER_CHUNK;
+		while (cap < parser->len + size + 1) {
+			cap *= 2;
+		}
+
+		char* buf = cjson_alloc(parser->ctx.settings, cap);
+		if (!buf) {
+			return NULL;
+		}
+		if (parser->len) {
+			memcpy(buf, parser->buf, parser->len);
+		}
+		cjson_free(parser->ctx.settings, parser->buf);
+		parser->buf = buf;
+		parser->cap = cap;
+	}
+
+	return parser->buf + parser->len;
+}
+
+// Parses as much of the pending input as possible. Returns the root value once the final input has been parsed.
+cjson_value* cjson_parser_run(cjson_parser* parser, int final)
+{
+	cjson_context* ctx = &parser->ctx;
+	ctx->buf = parser->buf ? parser->buf : "";
+	ctx->len = parser->len;
+	ctx->pos->ofs = 0;
+	ctx->final = final;
+	ctx->need_more = 0;
+
+	cjson_value* val = cjson_parse_impl(ctx);
+	if (ctx->need_more) {
+		// Drop everything consumed so far, only the incomplete token is kept around.
+		parser->len -= ctx->token_start;
+		memmove(parser->buf, parser->buf + ctx->token_start, parser->len);
+		parser->buf[parser->len] = 0;
+		parser->retry_len = parser->len * 2;
+		return NULL;
+	}
+
+	if (!val) {
+		parser->failed = 1;
+	}
+	return val;
+}
+
+int cjson_parser_commit(cjson_parser* parser, size_t len)
+{
+	parser->len += len;
+	parser->buf[parser->len] = 0;
+
+	if (parser->len >= parser->retry_len) {
+		cjson_parser_run(parser, 0);
+	}
+
+	return !parser->failed;
+}
+
+int cjson_parser_feed(cjson_parser* parser, const char* chunk, size_t len)
+{
+	if (parser->failed) {
+		return 0;
+	}
+
+	char* dst = cjson_parser_reserve(parser, len);
+	if (!dst) {
+		parser->failed = 1;
+		return 0;
+	}
+
+	memcpy(dst, chunk, len);
+	return cjson_parser_commit(parser, len);
+}
+
+cjson_value* cjson_parser_finish(cjson_parser* parser)
+{
+	if (!parser) {
+		return NULL;
+	}
+
+	cjson_value* val = parser->failed ? NULL : cjson_parser_run(parser, 1);
+	cjson_free_remaining_states(&parser->ctx, val == NULL);
+	cjson_free(parser->ctx.settings, parser->buf);
+	cjson_free(parser->ctx.settings, parser);
+	return val;
+}
+
+void cjson_parser_free(cjson_parser* parser)
+{
+	if (parser) {
+		cjson_free_remaining_states(&parser->ctx, 1);
+		cjson_free(parser->ctx.settings, parser->buf);
+		cjson_free(parser->ctx.settings, parser);
+	}
+}
+
+cjson_value* cjson_create_empty_ex(cjson_settings* settings)
+{
+	return cjson_value_create(settings, NULL);
+}
+cjson_value* cjson_create_object_ex(cjson_settings* settings)
+{
+	cjson_value* obj = cjson_create_empty_ex(settings);
+	if (!obj) return NULL;
+
+	obj->flags = cjson_object;
+	return obj;
+}
+cjson_value* cjson_create_array_ex(cjson_settings* settings)
+{
+	cjson_value* arr = cjson_create_empty_ex(settings);
+	if (!arr) return NULL;
+
+	arr->flags = cjson_array;
+	return arr;
+}
+cjson_value* cjson_create_null_ex(cjson_settings* settings)
+{
+	cjson_value* nil = cjson_create_empty_ex(settings);
+	if (!nil) return NULL;
+
+	nil->flags = cjson_null;
+	return nil;
+}
+cjson_value* cjson_create_boolean_ex(cjson_settings* settings, int value)
+{
+	cjson_value* b = cjson_create_empty_ex(settings);
+	if (!b) return NULL;
+
+	b->flags = cjson_boolean;
+	b->intval = value;
+	return b;
+}
+cjson_value* cjson_create_int64_ex(cjson_settings* settings, long long value)
+{
+	cjson_value* i = cjson_create_empty_ex(settings);
+	if (!i) return NULL;
+
+	i->flags = cjson_number | cjson_integer;
+	i->intval = value;
+	return i;
+}
+cjson_value* cjson_create_uint64_ex(cjson_settings* settings, unsigned long long value)
+{
+	cjson_value* i = cjson_create_empty_ex(settings);
+	if (!i) return NULL;
+
+	i->flags = cjson_number | cjson_integer | (value > LLONG_MAX ? cjson_unsigned : 0);
+	i->intval = (long long)value;
+	return i;
+}
+cjson_value* cjson_create_double_ex(cjson_settings* settings, double value)
+{
+	cjson_value* d = cjson_create_empty_ex(settings);
+	if (!d) return NULL;
+
+	d->flags = cjson_number | cjson_double;
+	d->doubleval = value;
+	return d;
+}
+cjson_value* cjson_create_string_ex(cjson_settings* settings, const char* string)
+{
+	cjson_value* s = cjson_create_empty_ex(settings);
+	if (!s) return NULL;
+
+	s->flags = cjson_string;
+	cjson_set_string_ex(settings, s, string);
+	return s;
+}
+
+cjson_value* cjson_create_empty()
+{
+	return cjson_create_empty_ex(cjson_global_settings());
+}
+cjson_value* cjson_create_object()
+{
+	return cjson_create_object_ex(cjson_global_settings());
+}
+cjson_value* cjson_create_array()
+{
+	return cjson_create_array_ex(cjson_global_settings());
+}
+cjson_value* cjson_create_null()
+{
+	return cjson_create_null_ex(cjson_global_settings());
+}
+cjson_value* cjson_create_boolean(int value)
+{
+	return cjson_create_boolean_ex(cjson_global_settings(), value);
+}
+cjson_value* cjson_create_int(int value)
+{
+	return cjson_create_int64_ex(cjson_global_settings(), value);
+}
+cjson_value* cjson_create_int64(long long value)
+{
+	return cjson_create_int64_ex(cjson_global_settings(), value);
+}
+cjson_value* cjson_create_uint64(unsigned long long value)
+{
+	return cjson_create_uint64_ex(cjson_global_settings(), value);
+}
+cjson_value* cjson_create_double(double value)
+{
+	return cjson_create_double_ex(cjson_global_settings(), value);
+}
+cjson_value* cjson_create_string(const char* string)
+{
+	return cjson_create_string_ex(cjson_global_settings(), string);
+}
+
+int cjson_is_string(cjson_value* v) { return v->flags & cjson_string; }
+int cjson_is_number(cjson_value* v) { return v->flags & cjson_number; }
+int cjson_is_double(cjson_value* v) { return (v->flags & (cjson_number | cjson_double)) == (cjson_number | cjson_double); }
+int cjson_is_integer(cjson_value* v) { return (v->flags & (cjson_number | cjson_integer)) == (cjson_number | cjson_integer); }
+int cjson_is_int64(cjson_value* v) { return cjson_is_integer(v) && !(v->flags & cjson_unsigned); }
+int cjson_is_uint64(cjson_value* v) { return cjson_is_integer(v) && ((v->flags & cjson_unsigned) || v->intval >= 0); }
+int cjson_is_object(cjson_value* v) { return v->flags & cjson_object; }
+int cjson_is_array(cjson_value* v) { return v->flags & cjson_array; }
+int cjson_array_length(cjson_value* v) { return v->intval; }
+cjson_value* cjson_array_at(cjson_value* v, int i)
+{
+	if (i < 0 || i >= v->intval) {
+		return NULL;
+	}
+
+	if ((v->flags & cjson_array) && v->vector) {
+		return v->vector->elements[i];
+	}
+
+	int j = 0;
+	v = v->child;
+	while (v != NULL) {
+		if (j == i) {
+			return v;
+		}
+
+		++j;
+		v = v->next;
+	}
+
+	return NULL;
+}
+int cjson_is_boolean(cjson_value* v) { return v->flags & cjson_boolean; }
+int cjson_is_null(cjson_value* v) { return v->flags & cjson_null; }
+
+const char* cjson_get_string(cjson_value* v) { return v->string; }
+double cjson_get_double(cjson_value* v)
+{
+	if (v->flags & cjson_double) {
+		return v->doubleval;
+	}
+
+	return (v->flags & cjson_unsigned) ? (double)(unsigned long long)v->intval : (double)v->intval;
+}
+
+int cjson_get_integer(cjson_value* v) { return (int)v->intval; }
+long long cjson_get_int64(cjson_value* v) { return v->intval; }
+unsigned long long cjson_get_uint64(cjson_value* v) { return (unsigned long long)v->intval; }
+
+int cjson_true(cjson_value* v)
+{
+	return v && v->intval == 1;
+}
+int cjson_false(cjson_value* v)
+{
+	return v && v->intval == 0;
+}
+
+void cjson_set_string(cjson_value* v, const char* str)
+{
+	cjson_set_string_ex(cjson_global_settings(), v, str);
+}
+
+void cjson_set_string_ex(cjson_settings* settings, cjson_value* v, const char* str)
+{
+	if (!cjson_is_string(v)) {
+		return;
+	}
+
+	// Strings of pooled values are allocated from (and left behind in) their document.
+	cjson_document* doc = cjson_value_document(v);
+	size_t len = strlen(str);
+
+	if (doc) {
+		v->string = cjson_document_alloc(doc, len + 1);
+	}
+	else {
+		if (!(v->flags & cjson_borrowed)) {
+			cjson_free(settings, v->string);
+		}
+		v->string = cjson_alloc(settings, len + 1);
+	}
+	v->flags &= ~cjson_borrowed;
+
+	if (v->string) {
+		strcpy(v->string, str);
+	}
+}
+
+void cjson_set_double(cjson_value* v, double d)
+{
+	if (!cjson_is_number(v)) {
+		return;
+	}
+
+	v->flags &= ~(cjson_integer | cjson_unsigned);
+	v->flags |= cjson_double;
+	v->doubleval = d;
+	v->intval = 0;
+}
+
+void cjson_set_integer(cjson_value* v, int i)
+{
+	cjson_set_int64(v, i);
+}
+
+void cjson_set_int64(cjson_value* v, long long i)
+{
+	if (!cjson_is_number(v)) {
+		return;
+	}
+
+	v->flags &= ~(cjson_double | cjson_unsigned);
+	v->flags |= cjson_integer;
+	v->intval = i;
+	v->doubleval = 0;
+}
+
+void cjson_set_uint64(cjson_value* v, unsigned long long i)
+{
+	cjson_set_int64(v, (long long)i);
+	if (cjson_is_number(v) && i > LLONG_MAX) {
+		v->flags |= cjson_unsigned;
+	}
+}
+
+
+// Smallest power of two, and at least twice the threshold, that holds length elements.
+size_t cjson_vector_capacity(size_t length)
+{
+	size_t capacity = CJSON_VECTOR_THRESHOLD * 2;
+	while (capacity < length) {
+		capacity *= 2;
+	}
+	return capacity;
+}
+
+cjson_vector* cjson_vector_create(cjson_settings* settings, cjson_document* doc, size_t capacity)
+{
+	size_t size = sizeof(cjson_vector) + capacity * sizeof(cjson_value*);
+	cjson_vector* vector = doc ? cjson_document_alloc(doc, size) : cjson_alloc(settings, size);
+	if (!vector) {
+		return NULL;
+	}
+
+	vector->capacity = capacity;
+	return vector;
+}
+
+// Called after c has been appended to p. If the vector cannot grow it is dropped and cjson_array_at walks the list again.
+void cjson_vector_push(cjson_settings* settings, cjson_value* p, cjson_value* c)
+{
+	cjson_document* doc = cjson_value_document(p);
+	size_t length = p->intval;
+
+	if (!p->vector) {
+		// Also rebuilds a vector that was dropped, so the array may already be far past the threshold.
+		if (length >= CJSON_VECTOR_THRESHOLD) {
+			p->vector = cjson_vector_create(settings, doc, cjson_vector_capacity(length));
+			if (p->vector) {
+				size_t i = 0;
+				cjson_value* e = p->child;
+				while (e != NULL) {
+					p->vector->elements[i++] = e;
+					e = e->next;
+				}
+			}
+		}
+		return;
+	}
+
+	if (length > p->vector->capacity) {
+		cjson_vector* grown = cjson_vector_create(settings, doc, p->vector->capacity * 2);
+		if (grown) {
+			memcpy(grown->elements, p->vector->elements, (length - 1) * sizeof(cjson_value*));
+		}
+		if (!doc) {
+			cjson_free(settings, p->vector);
+		}
+		p->vector = grown;
+		if (!grown) {
+			return;
+		}
+	}
+
+	p->vector->elements[length - 1] = c;
+}
+
+int cjson_replaceidx(cjson_value* p, int idx, cjson_value* replacement, cjson_value** old_value)
+{
+	return cjson_replaceidx_ex(cjson_global_settings(), p, idx, replacement, old_value);
+}
+
+int cjson_replaceidx_ex(cjson_settings* settings, cjson_value* p, int idx, cjson_value* replacement, cjson_value** old_value)
+{
+	cjson_value* c = cjson_array_at(p, idx);
+	if (!c) {
+		return 0;
+	}
+
+	// replace
+	if (c->prev) c->prev->next = replacement;
+	if (c->next) c->next->prev = replacement;
+	if (c == p->child) p->child = replacement;
+	if (c == p->childtail) p->childtail = replacement;
+	if ((p->flags & cjson_array) && p->vector) p->vector->elements[idx] = replacement;
+
+	replacement->next = c->next;
+	replacement->prev = c->prev;
+	c->next = NULL;
+	c->prev = NULL;
+	cjson_adopt(p, replacement);
+
+	if (old_value) {
+		*old_value = c;
+	}
+	else {
+		cjson_free_value_ex(settings, c);
+	}
+
+	return 1;
+}
+int cjson_eraseidx(cjson_value* p, int idx)
+{
+	return cjson_eraseidx_ex(cjson_global_settings(), p, idx);
+}
+
+int cjson_eraseidx_ex(cjson_settings* settings, cjson_value* p, int idx)
+{
+	cjson_value* c = cjson_array_at(p, idx);
+	if (!c) {
+		return 0;
+	}
+
+	if (c->prev) c->prev->next = c->next;
+	if (c->next) c->next->prev = c->prev;
+	if (c == p->child) p->child = c->next;
+	if (c == p->childtail) p->childtail = c->prev;
+	if (p->flags & cjson_object) cjson_index_remove(p, c);
+	if ((p->flags & cjson_array) && p->vector) {
+		memmove(&p->vector->elements[idx], &p->vector->elements[idx + 1], (p->intval - idx - 1) * sizeof(cjson_value*));
+	}
+	c->next = NULL;
+	c->prev = NULL;
+
+	cjson_free_value_ex(settings, c);
+	--p->intval;
+	return 1;
+}
+
+void cjson_append(cjson_value* p, cjson_value *c)
+{
+	cjson_append_ex(cjson_global_settings(), p, c);
+}
+
+void cjson_append_ex(cjson_settings* settings, cjson_value* p, cjson_value* c)
+{
+	++p->intval;
+	cjson_adopt(p, c);
+	if (!p->child) {
+		p->child = c;
+	}
+	else {
+		cjson_value* insertion_point = cjson_end(p);
+		insertion_point->next = c;
+		c->prev = insertion_point;		 
+	}
+
+	if (p->flags & cjson_array) {
+		cjson_vector_push(settings, p, c);
+	}
+}
+
+int cjson_object_size(cjson_value* p)
+{
+	if (cjson_is_object(p)) {
+		return p->intval;
+	}
+
+	return 0;
+}
+
+int cjson_empty(cjson_value* p)
+{
+	if (p == NULL) return -1; // Maybe this should be true?
+
+	if (cjson_is_string(p)) {
+		return p->string == NULL || strlen(p->string) == 0;
+	}
+
+	if (cjson_is_array(p) || cjson_is_object(p)) {
+		return p->intval == 0;
+	}
+
+	return -1; // not applicable
+}
+
+// FNV-1a over the key, and over the key folded the same way stricmp does.
+void cjson_hash_key(const char* k, unsigned int* hash, unsigned int* ihash)
+{
+	unsigned int h = 2166136261u;
+	unsigned int ih = 2166136261u;
+
+	for (; *k; ++k) {
+		h = (h ^ (unsigned char)*k) * 16777619u;
+		ih = (ih ^ (unsigned char)tolower((unsigned char)*k)) * 16777619u;
+	}
+
+	*hash = h;
+	*ihash = ih;
+}
+
+// Same as the case-sensitive hash of cjson_hash_key, over the first len bytes of k.
+unsigned int cjson_hash_bytes(const char* k, size_t len)
+{
+	unsigned int h = 2166136261u;
+	for (size_t i = 0; i < len; ++i) {
+		h = (h ^ (unsigned char)k[i]) * 16777619u;
+	}
+	return h;
+}
+
+void cjson_index_put(cjson_index* index, cjson_value* kv)
+{
+	size_t mask = index->capacity - 1;
+	size_t i = kv->keyhash[1] & mask;
+
+	while (index->slots[i] != NULL) {
+		i = (i + 1) & mask;
+	}
+
+	index->slots[i] = kv;
+	++index->used;
+}
+
+// (Re)builds the index of p sized for its current key-values, hashing their keys first when rehash is nonzero.
+int cjson_index_build(cjson_settings* settings, cjson_document* doc, cjson_value* p, int rehash)
+{
+	size_t capacity = 32;
+	while (capacity < (size_t)(p->intval + 1) * 2) {
+		capacity *= 2;
+	}
+
+	size_t size = sizeof(cjson_index) + capacity * sizeof(cjson_value*);
+	cjson_index* index = doc ? cjson_document_alloc(doc, size) : cjson_alloc(settings, size);
+	if (!index) {
+		return 0;
+	}
+
+	index->capacity = capacity;
+	index->used = 0;
+	memset(index->slots, 0, capacity * sizeof(cjson_value*));
+
+	cjson_value* c = p->child;
+	while (c != NULL) {
+		if (rehash && !(c->flags & cjson_interned)) {
+			cjson_hash_key(c->string, &c->keyhash[0], &c->keyhash[1]);
+		}
+		cjson_index_put(index, c);
+		c = c->next;
+	}
+
+	if (!doc) {
+		cjson_free(settings, p->index);
+	}
+	p->index = index;
+	return 1;
+}
+
+// Called after kv has been linked into p. Lookups fall back to the linear search if the index cannot be allocated.
+void cjson_index_add(cjson_settings* settings, cjson_document* doc, cjson_value* p, cjson_value* kv)
+{
+	if (!p->index) {
+		if (p->intval >= CJSON_INDEX_THRESHOLD) {
+			cjson_index_build(settings, doc, p, 1);
+		}
+		return;
+	}
+
+	if (!(kv->flags & cjson_interned)) {
+		cjson_hash_key(kv->string, &kv->keyhash[0], &kv->keyhash[1]);
+	}
+	if ((p->index->used + 1) * 2 > p->index->capacity) {
+		cjson_index_build(settings, doc, p, 0);
+	}
+	else {
+		cjson_index_put(p->index, kv);
+	}
+}
+
+void cjson_index_remove(cjson_value* p, cjson_value* kv)
+{
+	if (!p->index) {
+		return;
+	}
+
+	size_t mask = p->index->capacity - 1;
+	size_t i = kv->keyhash[1] & mask;
+	while (p->index->slots[i] != NULL) {
+		if (p->index->slots[i] == kv) {
+			p->index->slots[i] = &cjson_index_tombstone;
+			return;
+		}
+		i = (i + 1) & mask;
+	}
+}
+
+cjson_value* cjson_index_find_hashed(cjson_index* index, const char* k, unsigned int hash, unsigned int ihash, int insensitive)
+{
+	size_t mask = index->capacity - 1;
+	size_t i = ihash & mask;
+	cjson_value* c;
+	while ((c = index->slots[i]) != NULL) {
+		if (c != &cjson_index_tombstone) {
+			if (insensitive) {
+				if (c->keyhash[1] == ihash && (c->string == k || stricmp(c->string, k) == 0)) {
+					return c;
+				}
+			}
+			else if (c->keyhash[0] == hash && (c->string == k || strcmp(c->string, k) == 0)) {
+				return c;
+			}
+		}
+		i = (i + 1) & mask;
+	}
+
+	return NULL;
+}
+
+cjson_value* cjson_index_find(cjson_index* index, const char* k, int insensitive)
+{
+	unsigned int hash, ihash;
+	cjson_hash_key(k, &hash, &ihash);
+	return cjson_index_find_hashed(index, k, hash, ihash, insensitive);
+}
+
+cjson_value* cjson_search_kv(cjson_value* p, const char* k)
+{
+	if (p->index) {
+		return cjson_index_find(p->index, k, 0);
+	}
+
+	// Keys from cjson_document_key are the very pointers held by the key-values of their document.
+	cjson_value* c = p->child;
+	while (c != NULL) {
+		if (c->string == k || strcmp(c->string, k) == 0) {
+			return c; // Return the KV
+		}
+
+		c = c->next;
+	}
+	return NULL;
+}
+
+cjson_value* cjson_searchi_kv(cjson_value* p, const char* k)
+{
+	if (p->index) {
+		return cjson_index_find(p->index, k, 1);
+	}
+
+	cjson_value* c = p->child;
+	while (c != NULL) {
+		if (c->string == k || stricmp(c->string, k) == 0) {
+			return c; // Return the KV
+		}
+
+		c = c->next;
+	}
+	return NULL;
+}
+
+int cjson_erase_kv_from_tree(cjson_settings* settings, cjson_value* p, cjson_value* kv)
+{
+	if (!kv) return 0;
+
+	// remove item from tree
+	cjson_index_remove(p, kv);
+	if (kv->prev) kv->prev->next = kv->next;
+	if (kv->next) kv->next->prev = kv->prev;
+	if (p->child == kv) p->child = NULL;
+	if (p->child == NULL && kv->next) p->child = kv->next;
+	if (p->childtail == kv) p->childtail = kv->prev;
+
+	kv->next = NULL;
+	kv->prev = NULL;
+	cjson_free_value_ex(settings, kv);
+	--p->intval;
+	return 1;
+}
+
+int cjson_erase(cjson_value* p, const char* k)
+{
+	return cjson_erase_kv_from_tree(cjson_global_settings(), p, cjson_search_kv(p, k));
+}
+
+int cjson_erasei(cjson_value* p, const char* k)
+{
+	return cjson_erase_kv_from_tree(cjson_global_settings(), p, cjson_searchi_kv(p, k));
+}
+
+int cjson_erase_ex(cjson_settings* settings, cjson_value* p, const char* k)
+{
+	return cjson_erase_kv_from_tree(settings, p, cjson_search_kv(p, k));
+}
+
+int cjson_erasei_ex(cjson_settings* settings, cjson_value* p, const char* k)
+{
+	return cjson_erase_kv_from_tree(settings, p, cjson_searchi_kv(p, k));
+}
+
+int cjson_replace(cjson_value* p, const char* k, cjson_value* replacement, cjson_value** old_value)
+{
+	return cjson_replace_ex(cjson_global_settings(), p, k, replacement, old_value);
+}
+
+int cjson_replace_ex(cjson_settings* settings, cjson_value* p, const char* k, cjson_value* replacement, cjson_value** old_value)
+{
+	cjson_value* kv = cjson_search_kv(p, k);
+	if (!kv) return 0;
+
+	if (old_value != NULL) {
+		*old_value = kv->child;
+	}
+	else {
+		cjson_free_value_ex(settings, kv->child);
+	}
+
+	// Set the replacement
+	kv->child = replacement;
+	cjson_adopt(p, replacement);
+	return 1;
+}
+
+// Inserts v into p with key k, where k is adopted by the kv rather than copied. Returns 0 if the kv could not be allocated.
+int cjson_insert_kv(cjson_settings* settings, cjson_document* doc, cjson_value* p, char* k, cjson_value* v, int kv_flags)
+{
+	cjson_value *c = cjson_value_create(settings, doc);
+
+	if (!c) {
+		return 0;
+	}
+
+	c->flags |= cjson_kv | kv_flags;
+	c->flags &= ~cjson_invalid;
+	c->string = k;
+	if (kv_flags & cjson_interned) {
+		cjson_interned_key* key = cjson_key_interned(k);
+		c->keyhash[0] = key->hash;
+		c->keyhash[1] = key->ihash;
+	}
+	c->child = v;
+	++p->intval;
+	cjson_adopt(p, v);
+
+	if (!p->child) {
+		p->child = c;
+	}
+	else {
+		cjson_value* insertion_point = cjson_end(p);
+		insertion_point->next = c;
+		c->prev = insertion_point;
+	}
+
+	cjson_index_add(settings, doc, p, c);
+	return 1;
+}
+
+void cjson_insert(cjson_value* p, const char* k, cjson_value* v)
+{
+	cjson_insert_ex(cjson_global_settings(), p, k, v);
+}
+
+void cjson_insert_ex(cjson_settings* settings, cjson_value* p, const char* k, cjson_value* v)
+{
+	// Keys inserted into a pooled object are interned into the same document as the object.
+	cjson_document* doc = cjson_value_document(p);
+	size_t len = strlen(k);
+	char* key = doc ? cjson_document_intern(doc, k, len) : cjson_alloc(settings, len + 1);
+
+	if (!key) {
+		return; // Error maybe?
+	}
+
+	if (doc) {
+		cjson_insert_kv(settings, doc, p, key, v, cjson_interned);
+		return;
+	}
+
+	memcpy(key, k, len + 1);
+	if (!cjson_insert_kv(settings, doc, p, key, v, 0)) {
+		cjson_free(settings, key);
+	}
+}
+
+cjson_value* cjson_search_item(cjson_value* p, const char* k)
+{
+	cjson_value* kv = cjson_search_kv(p, k);
+	if (!kv) return NULL;
+	return kv->child;
+}
+
+cjson_value* cjson_searchi_item(cjson_value* p, const char* k)
+{
+	cjson_value* kv = cjson_searchi_kv(p, k);
+	if (!kv) return NULL;
+	return kv->child;
+}
+
+const char* cjson_type_string(cjson_value* v)
+{
+	if ((v->flags & cjson_kv) == cjson_kv) return "cjson_kv";
+	if ((v->flags & cjson_string) == cjson_string) return "cjson_string";
+	if ((v->flags & cjson_number) == cjson_number) {
+		if ((v->flags & cjson_integer) == cjson_integer) return "cjson_number (int)";
+		if ((v->flags & cjson_double) == cjson_double) return "cjson_number (double)";
+		return "cjson_number (unk)";
+	}
+	if ((v->flags & cjson_object) == cjson_object) return "cjson_object";
+	if ((v->flags & cjson_boolean) == cjson_boolean) return "cjson_boolean";
+	if ((v->flags & cjson_null) == cjson_null) return "cjson_null";
+
+	return "invalid";
+}
+
+// Output of the serializer. The buffer grows geometrically, unless the writer is streaming (flush is set):
+// its buffer then has a fixed size and is handed to flush whenever it fills up.
+typedef struct __cjson_writer {
+	char* buf;
+	size_t len;
+	size_t cap;
+	int failed; // set once growing or flushing the buffer failed, everything written afterwards is dropped.
+	// Writes out the buffer followed by extra (data too large for the buffer, which is passed along without being copied).
+	int (*flush)(struct __cjson_writer* w, const char* extra, size_t extra_len);
+	void* target; // FILE* or callback user data
+	int fd;
+	cjson_write_callback callback;
+} cjson_writer;
+
+#define CJSON_WRITER_MIN_CAPACITY 256
+#define CJSON_STREAM_BUFFER (64 * 1024)
+
+int cjson_writer_flush(cjson_writer* w, const char* extra, size_t extra_len)
+{
+	if (w->failed) {
+		return 0;
+	}
+	if (!w->flush(w, extra, extra_len)) {
+		w->failed = 1;
+	}
+	w->len = 0;
+	return !w->failed;
+}
+
+// Makes room for n more bytes (and a terminator). Returns 0 on failure.
+int cjson_writer_reserve(cjson_writer* w, size_t n)
+{
+	if (w->failed) {
+		return 0;
+	}
+	if (w->cap - w->len > n) {
+		return 1;
+	}
+	if (w->flush) {
+		// Only small writes get here, cjson_write passes large ones along.
+		return cjson_writer_flush(w, NULL, 0) && w->cap > n;
+	}
+
+	size_t cap = w->cap ? w->cap : CJSON_WRITER_MIN_CAPACITY;
+	while (cap - w->len <= n) {
+		cap *= 2;
+	}
+
+	char* buf = realloc(w->buf, cap);
+	if (!buf) {
+		w->failed = 1;
+		return 0;
+	}
+	w->buf = buf;
+	w->cap = cap;
+	return 1;
+}
+
+void cjson_write(cjson_writer* w, const char* s, size_t n)
+{
+	if (w->flush && w->cap - w->len <= n && n >= w->cap / 4) {
+		cjson_writer_flush(w, s, n);
+		return;
+	}
+	if (!cjson_writer_reserve(w, n)) {
+		return;
+	}
+	memcpy(w->buf + w->len, s, n);
+	w->len += n;
+}
+
+void cjson_write_char(cjson_writer* w, char c)
+{
+	if (!cjson_writer_reserve(w, 1)) {
+		return;
+	}
+	w->buf[w->len++] = c;
+}
+
+const char cjson_digit_pairs[] =
+	"0001020304050607080910111213141516171819"
+	"2021222324252627282930313233343536373839"
+	"4041424344454647484950515253545556575859"
+	"6061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+// Writes two digits at a time from the end, with 32-bit divisions once the value fits.
+void cjson_write_uint(cjson_writer* w, unsigned long long u)
+{
+	char digits[20];
+	char* p = digits + sizeof(digits);
+	while (u > UINT_MAX) {
+		const char* pair = &cjson_digit_pairs[(u % 100) * 2];
+		u /= 100;
+		*--p = pair[1];
+		*--p = pair[0];
+	}
+
+	unsigned int u32 = (unsigned int)u;
+	while (u32 >= 100) {
+		const char* pair = &cjson_digit_pairs[(u32 % 100) * 2];
+		u32 /= 100;
+		*--p = pair[1];
+		*--p = pair[0];
+	}
+	if (u32 >= 10) {
+		*--p = cjson_digit_pairs[u32 * 2 + 1];
+		*--p = cjson_digit_pairs[u32 * 2];
+	}
+	else {
+		*--p = (char)('0' + u32);
+	}
+	cjson_write(w, p, digits + sizeof(digits) - p);
+}
+
+// Do-it-yourself floating point number (f * 2^e) for the Grisu2 double formatter below.
+typedef struct {
+	unsigned long long f;
+	int e;
+} cjson_diyfp;
+
+// Normalized 10^k for k = -348, -340, ..., 340.
+const unsigned long long cjson_cached_powers_f[] = {
+	0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL, 0xcf42894a5dce35eaULL,
+	0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL, 0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL,
+	0xbe5691ef416bd60cULL, 0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+	0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL, 0xc21094364dfb5637ULL,
+	0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL, 0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL,
+	0xb23867fb2a35b28eULL, 0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+	0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL, 0xb5b5ada8aaff80b8ULL,
+	0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL, 0x964e858c91ba2655ULL, 0xdff9772470297ebdULL,
+	0xa6dfbd9fb8e5b88fULL, 0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+	0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL, 0xaa242499697392d3ULL,
+	0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL, 0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL,
+	0x9c40000000000000ULL, 0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+	0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL, 0x9f4f2726179a2245ULL,
+	0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL, 0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL,
+	0x924d692ca61be758ULL, 0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+	0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL, 0x952ab45cfa97a0b3ULL,
+	0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL, 0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL,
+	0x88fcf317f22241e2ULL, 0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+	0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL, 0x8bab8eefb6409c1aULL,
+	0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL, 0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL,
+	0x80444b5e7aa7cf85ULL, 0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+	0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL,
+};
+const short cjson_cached_powers_e[] = {
+	-1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+	-901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+	-582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+	-263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+	56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+	375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+	694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+	1013, 1039, 1066,
+};
+
+const unsigned int cjson_pow10_u32[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+
+cjson_diyfp cjson_diyfp_mul(cjson_diyfp x, cjson_diyfp y)
+{
+	// Upper 64 bits of the 128 bit product, rounded.
+	const unsigned long long m32 = 0xFFFFFFFFULL;
+	unsigned long long a = x.f >> 32, b = x.f & m32, c = y.f >> 32, d = y.f & m32;
+	unsigned long long ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+	unsigned long long tmp = (bd >> 32) + (ad & m32) + (bc & m32) + (1ULL << 31);
+	cjson_diyfp r = { ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64 };
+	return r;
+}
+
+cjson_diyfp cjson_diyfp_normalize(cjson_diyfp x)
+{
+	int shift = __builtin_clzll(x.f);
+	x.f <<= shift;
+	x.e -= shift;
+	return x;
+}
+
+// Moves the last digit towards w as long as the result stays within the rounding interval.
+void cjson_grisu_round(char* buf, int len, unsigned long long delta, unsigned long long rest, unsigned long long ten_kappa, unsigned long long wp_w)
+{
+	while (rest < wp_w && delta - rest >= ten_kappa && (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+		buf[len - 1]--;
+		rest += ten_kappa;
+	}
+}
+
+// Writes the shortest digits of a positive, finite d into buf and returns their count, d is then buf * 10^*k.
+int cjson_grisu2(double d, char* buf, int* k)
+{
+	unsigned long long bits;
+	memcpy(&bits, &d, sizeof(bits));
+	int biased_e = (int)((bits >> 52) & 0x7FF);
+	unsigned long long significand = bits & ((1ULL << 52) - 1);
+	cjson_diyfp v = { significand, -1074 };
+	if (biased_e) {
+		v.f += 1ULL << 52;
+		v.e = biased_e - 1075;
+	}
+
+	// Boundaries halfway to the neighbouring doubles, with the same exponent.
+	cjson_diyfp plus = { (v.f << 1) + 1, v.e - 1 };
+	plus = cjson_diyfp_normalize(plus);
+	cjson_diyfp minus = { (v.f << 1) - 1, v.e - 1 };
+	if (v.f == 1ULL << 52 && biased_e > 1) {
+		minus.f = (v.f << 2) - 1;
+		minus.e = v.e - 2;
+	}
+	minus.f <<= minus.e - plus.e;
+	minus.e = plus.e;
+
+	// Scale by a cached power of ten so that the exponent ends up in [-60, -32].
+	double dk = (-61 - plus.e) * 0.30102999566398114 + 347;
+	int ck = (int)dk;
+	if (dk - ck > 0.0) {
+		++ck;
+	}
+	int index = (ck >> 3) + 1;
+	cjson_diyfp c = { cjson_cached_powers_f[index], cjson_cached_powers_e[index] };
+	*k = -(-348 + index * 8);
+
+	cjson_diyfp w = cjson_diyfp_mul(cjson_diyfp_normalize(v), c);
+	cjson_diyfp wp = cjson_diyfp_mul(plus, c);
+	cjson_diyfp wm = cjson_diyfp_mul(minus, c);
+	++wm.f;
+	--wp.f;
+
+	// Digit generation: integral part of wp first, then the fraction, until the digits are within delta.
+	unsigned long long delta = wp.f - wm.f;
+	cjson_diyfp one = { 1ULL << -wp.e, wp.e };
+	unsigned long long wp_w = wp.f - w.f;
+	unsigned int p1 = (unsigned int)(wp.f >> -one.e);
+	unsigned long long p2 = wp.f & (one.f - 1);
+	int kappa = 10;
+	while (kappa > 1 && p1 < cjson_pow10_u32[kappa - 1]) {
+		--kappa;
+	}
+
+	int len = 0;
+	while (kappa > 0) {
+		unsigned int digit = p1 / cjson_pow10_u32[kappa - 1];
+		p1 %= cjson_pow10_u32[kappa - 1];
+		if (digit || len) {
+			buf[len++] = (char)('0' + digit);
+		}
+		--kappa;
+		unsigned long long rest = ((unsigned long long)p1 << -one.e) + p2;
+		if (rest <= delta) {
+			*k += kappa;
+			cjson_grisu_round(buf, len, delta, rest, (unsigned long long)cjson_pow10_u32[kappa] << -one.e, wp_w);
+			return len;
+		}
+	}
+
+	unsigned long long unit = 1;
+	while (1) {
+		p2 *= 10;
+		delta *= 10;
+		unit *= 10;
+		char digit = (char)(p2 >> -one.e);
+		if (digit || len) {
+			buf[len++] = (char)('0' + digit);
+		}
+		p2 &= one.f - 1;
+		--kappa;
+		if (p2 < delta) {
+			*k += kappa;
+			cjson_grisu_round(buf, len, delta, p2, one.f, wp_w * unit);
+			return len;
+		}
+	}
+}
+
+// Formats d with the fewest digits that still parse back to exactly d (i.e. 0.1, 1.5e+300, 3.0). buf must hold
+// at least 32 bytes. Returns the length of the output, which is not null-terminated.
+int cjson_format_double(double d, char* buf)
+{
+	char* p = buf;
+	if (isnan(d) || isinf(d)) {
+		// NaN and infinities have no JSON representation.
+		memcpy(buf, "null", 4);
+		return 4;
+	}
+	if (signbit(d)) {
+		*p++ = '-';
+		d = -d;
+	}
+	if (d == 0) {
+		memcpy(p, "0.0", 3);
+		return (int)(p - buf) + 3;
+	}
+
+	int k;
+	int len = cjson_grisu2(d, p, &k);
+	int kk = len + k; // d = 0.digits * 10^kk
+
+	if (k >= 0 && kk <= 21) {
+		// 1234e7 -> 12340000000.0
+		memset(p + len, '0', k);
+		memcpy(p + kk, ".0", 2);
+		return (int)(p - buf) + kk + 2;
+	}
+	if (kk > 0 && kk <= 21) {
+		// 1234e-2 -> 12.34
+		memmove(p + kk + 1, p + kk, len - kk);
+		p[kk] = '.';
+		return (int)(p - buf) + len + 1;
+	}
+	if (kk > -6 && kk <= 0) {
+		// 1234e-6 -> 0.001234
+		int offset = 2 - kk;
+		memmove(p + offset, p, len);
+		p[0] = '0';
+		p[1] = '.';
+		memset(p + 2, '0', offset - 2);
+		return (int)(p - buf) + len + offset;
+	}
+
+	// 1e30, 1234e30 -> 1.234e33
+	if (len > 1) {
+		memmove(p + 2, p + 1, len - 1);
+		p[1] = '.';
+		++len;
+	}
+	p += len;
+	*p++ = 'e';
+	int exp = kk - 1;
+	if (exp < 0) {
+		*p++ = '-';
+		exp = -exp;
+	}
+	if (exp >= 100) {
+		*p++ = (char)('0' + exp / 100);
+		exp %= 100;
+		*p++ = (char)('0' + exp / 10);
+	}
+	else if (exp >= 10) {
+		*p++ = (char)('0' + exp / 10);
+	}
+	*p++ = (char)('0' + exp % 10);
+	return (int)(p - buf);
+}
+
+void cjson_write_string(cjson_writer* w, const char* s)
+{
+	size_t len = strlen(s);
+	if (w->flush && w->cap - w->len <= len + 2) {
+		cjson_write_char(w, '"');
+		cjson_write(w, s, len);
+		cjson_write_char(w, '"');
+		return;
+	}
+	if (!cjson_writer_reserve(w, len + 2)) {
+		return;
+	}
+	w->buf[w->len] = '"';
+	memcpy(w->buf + w->len + 1, s, len);
+	w->buf[w->len + len + 1] = '"';
+	w->len += len + 2;
+}
+
+void cjson_stringify_internal(cjson_writer* w, cjson_value* v)
+{
+	if (v->flags & cjson_string) 
+	{
+		cjson_write_string(w, v->string);
+	}
+	else if (v->flags & cjson_number)
+	{
+		if (v->flags & cjson_integer) {
+			if (v->flags & cjson_unsigned) {
+				cjson_write_uint(w, (unsigned long long)v->intval);
+			}
+			else if (v->intval < 0) {
+				cjson_write_char(w, '-');
+				cjson_write_uint(w, 0 - (unsigned long long)v->intval);
+			}
+			else {
+				cjson_write_uint(w, (unsigned long long)v->intval);
+			}
+		}
+		else {
+			char buf[32];
+			cjson_write(w, buf, cjson_format_double(v->doubleval, buf));
+		}
+	} 
+	else if (v->flags & cjson_object)
+	{
+		cjson_write_char(w, '{');
+
+		cjson_value* c = v->child;
+		while (c != NULL) {
+			cjson_write_string(w, c->string); // key
+			cjson_write_char(w, ':');
+			cjson_stringify_internal(w, c->child); // value
+
+			if (c->next) {
+				cjson_write_char(w, ',');
+			}
+
+			c = c->next;
+		}
+
+		cjson_write_char(w, '}');
+	}
+	else if (v->flags & cjson_array)
+	{
+		cjson_write_char(w, '[');
+
+		cjson_value* c = v->child;
+		while (c != NULL) {
+			cjson_stringify_internal(w, c);
+
+			if (c->next) {
+				cjson_write_char(w, ',');
+			}
+
+			c = c->next;
+		}
+
+		cjson_write_char(w, ']');
+	}
+	else if (v->flags & cjson_boolean)
+	{
+		if (v->intval) {
+			cjson_write(w, "true", 4);
+		}
+		else {
+			cjson_write(w, "false", 5);
+		}
+	} 
+	else if (v->flags & cjson_null)
+	{
+		cjson_write(w, "null", 4);
+	}
+}
+
+int cjson_stringify_to(cjson_value* v, cjson_buffer* buffer)
+{
+	if (!v || !buffer) {
+		return 0;
+	}
+
+	// Serializes into the buffer's memory, which is kept around (and grown) for the next call.
+	cjson_writer w = { buffer->data, 0, buffer->capacity, 0, NULL, NULL, -1, NULL };
+	cjson_stringify_internal(&w, v);
+
+	buffer->data = w.buf;
+	buffer->capacity = w.cap;
+	buffer->length = 0;
+	if (w.failed || !w.len) {
+		return 0;
+	}
+
+	w.buf[w.len] = 0;
+	buffer->length = w.len;
+	return 1;
+}
+
+void cjson_buffer_free(cjson_buffer* buffer)
+{
+	free(buffer->data);
+	buffer->data = NULL;
+	buffer->length = 0;
+	buffer->capacity = 0;
+}
+
+char* cjson_stringify(cjson_value *v)
+{ 
+	cjson_buffer buffer = { NULL, 0, 0 };
+	if (!cjson_stringify_to(v, &buffer)) {
+		cjson_buffer_free(&buffer);
+		return NULL;
+	}
+
+	return buffer.data;
+}
+
+// Serializes v through a fixed-size buffer, so memory use does not depend on the size of v.
+int cjson_stringify_stream_internal(cjson_value* v, cjson_writer* w)
+{
+	if (!v) {
+		return 0;
+	}
+
+	w->buf = malloc(CJSON_STREAM_BUFFER);
+	if (!w->buf) {
+		return 0;
+	}
+	w->len = 0;
+	w->cap = CJSON_STREAM_BUFFER;
+	w->failed = 0;
+
+	cjson_stringify_internal(w, v);
+	int ok = w->len ? cjson_writer_flush(w, NULL, 0) : !w->failed;
+	free(w->buf);
+	return ok;
+}
+
+int cjson_writer_flush_file(cjson_writer* w, const char* extra, size_t extra_len)
+{
+	FILE* file = w->target;
+	return fwrite(w->buf, 1, w->len, file) == w->len && (!extra_len || fwrite(extra, 1, extra_len, file) == extra_len);
+}
+
+int cjson_writer_flush_callback(cjson_writer* w, const char* extra, size_t extra_len)
+{
+	if (w->len && !w->callback(w->target, w->buf, w->len)) {
+		return 0;
+	}
+	return !extra_len || w->callback(w->target, extra, extra_len);
+}
+
+int cjson_stringify_file(cjson_value* v, FILE* file)
+{
+	if (!file) {
+		return 0;
+	}
+
+	cjson_writer w = { NULL, 0, 0, 0, &cjson_writer_flush_file, file, -1, NULL };
+	return cjson_stringify_stream_internal(v, &w);
+}
+
+int cjson_stringify_callback(cjson_value* v, cjson_write_callback callback, void* user)
+{
+	if (!callback) {
+		return 0;
+	}
+
+	cjson_writer w = { NULL, 0, 0, 0, &cjson_writer_flush_callback, user, -1, callback };
+	return cjson_stringify_stream_internal(v, &w);
+}
+
+#ifdef CJSON_POSIX
+// The buffer and extra are written with a single writev, retrying until everything went out.
+int cjson_writer_flush_fd(cjson_writer* w, const char* extra, size_t extra_len)
+{
+	struct iovec iov[2] = { { w->buf, w->len }, { (void*)extra, extra_len } };
+	struct iovec* cur = iov;
+	int count = 2;
+
+	while (count) {
+		if (!cur->iov_len) {
+			++cur;
+			--count;
+			continue;
+		}
+
+		ssize_t written = writev(w->fd, cur, count);
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return 0;
+		}
+
+		while (count && (size_t)written >= cur->iov_len) {
+			written -= cur->iov_len;
+			++cur;
+			--count;
+		}
+		if (count) {
+			cur->iov_base = (char*)cur->iov_base + written;
+			cur->iov_len -= written;
+		}
+	}
+
+	return 1;
+}
+
+int cjson_stringify_fd(cjson_value* v, int fd)
+{
+	if (fd < 0) {
+		return 0;
+	}
+
+	cjson_writer w = { NULL, 0, 0, 0, &cjson_writer_flush_fd, NULL, fd, NULL };
+	return cjson_stringify_stream_internal(v, &w);
+}
+#endif
+
+struct __cjson_compact {
+	cjson_settings* settings;
+	size_t node_count;
+	size_t string_bytes;
+	cjson_node nodes[]; // followed by string_bytes bytes of NUL-terminated strings
+};
+
+// Counts the nodes and string bytes needed to store v compactly.
+void cjson_compact_measure(cjson_value* v, size_t* nodes, size_t* bytes)
+{
+	++*nodes;
+
+	if (v->flags & cjson_string) {
+		*bytes += strlen(v->string) + 1;
+	}
+	else if (v->flags & cjson_object) {
+		cjson_value* c = v->child;
+		while (c != NULL) {
+			++*nodes;
+			*bytes += strlen(c->string) + 1;
+			cjson_compact_measure(c->child, nodes, bytes);
+			c = c->next;
+		}
+	}
+	else if (v->flags & cjson_array) {
+		cjson_value* c = v->child;
+		while (c != NULL) {
+			cjson_compact_measure(c, nodes, bytes);
+			c = c->next;
+		}
+	}
+}
+
+void cjson_compact_string(cjson_node* n, const char* str, int flags, char** strings)
+{
+	size_t len = strlen(str);
+	memcpy(*strings, str, len + 1);
+	n->flags = flags;
+	n->size = (unsigned int)len;
+	n->string = *strings;
+	*strings += len + 1;
+}
+
+// Writes v starting at n, returns the amount of nodes written.
+size_t cjson_compact_fill(cjson_value* v, cjson_node* n, char** strings)
+{
+	size_t count = 1;
+
+	if (v->flags & cjson_string) {
+		cjson_compact_string(n, v->string, cjson_string, strings);
+		return 1;
+	}
+
+	n->flags = v->flags & ~(cjson_pooled | cjson_borrowed);
+	n->size = 1;
+
+	if (v->flags & cjson_object) {
+		cjson_value* c = v->child;
+		while (c != NULL) {
+			cjson_compact_string(&n[count++], c->string, cjson_kv, strings);
+			count += cjson_compact_fill(c->child, &n[count], strings);
+			c = c->next;
+		}
+		n->size = (unsigned int)count;
+		n->intval = v->intval;
+	}
+	else if (v->flags & cjson_array) {
+		cjson_value* c = v->child;
+		while (c != NULL) {
+			count += cjson_compact_fill(c, &n[count], strings);
+			c = c->next;
+		}
+		n->size = (unsigned int)count;
+		n->intval = v->intval;
+	}
+	else if (v->flags & cjson_double) {
+		n->doubleval = v->doubleval;
+	}
+	else {
+		n->intval = v->intval;
+	}
+
+	return count;
+}
+
+cjson_compact* cjson_compact_from_value_ex(cjson_settings* settings, cjson_value* v)
+{
+	if (!settings || !v) {
+		return NULL;
+	}
+
+	size_t nodes = 0;
+	size_t bytes = 0;
+	cjson_compact_measure(v, &nodes, &bytes);
+
+	// Nodes and strings share a single allocation.
+	cjson_compact* compact = cjson_alloc(settings, sizeof(cjson_compact) + nodes * sizeof(cjson_node) + bytes);
+	if (!compact) {
+		return NULL;
+	}
+
+	compact->settings = settings;
+	compact->node_count = nodes;
+	compact->string_bytes = bytes;
+
+	char* strings = (char*)&compact->nodes[nodes];
+	cjson_compact_fill(v, compact->nodes, &strings);
+	return compact;
+}
+
+cjson_compact* cjson_compact_from_value(cjson_value* v)
+{
+	return cjson_compact_from_value_ex(cjson_global_settings(), v);
+}
+
+// The input is parsed into a temporary document first, which is released as soon as the compact copy exists.
+cjson_compact* cjson_compact_from_document(cjson_document* doc)
+{
+	if (!doc) {
+		return NULL;
+	}
+
+	cjson_compact* compact = cjson_compact_from_value_ex(doc->settings, doc->root);
+	cjson_free_document(doc);
+	return compact;
+}
+
+cjson_compact* cjson_parse_compact(const char* buffer)
+{
+	return cjson_compact_from_document(cjson_parse_document(buffer));
+}
+
+cjson_compact* cjson_parse_compact_file(const char* filename)
+{
+	return cjson_compact_from_document(cjson_parse_document_file(filename));
+}
+
+cjson_compact* cjson_parse_compact_ex(cjson_settings* settings, const char* buffer)
+{
+	return cjson_compact_from_document(cjson_parse_document_ex(settings, buffer));
+}
+
+cjson_compact* cjson_parse_compact_file_ex(cjson_settings* settings, const char* filename)
+{
+	return cjson_compact_from_document(cjson_parse_document_file_ex(settings, filename));
+}
+
+cjson_node* cjson_compact_root(cjson_compact* compact)
+{
+	return compact ? compact->nodes : NULL;
+}
+
+size_t cjson_compact_memory(cjson_compact* compact)
+{
+	return compact ? compact->node_count * sizeof(cjson_node) + compact->string_bytes : 0;
+}
+
+void cjson_free_compact(cjson_compact* compact)
+{
+	if (compact) {
+		cjson_free(compact->settings, compact);
+	}
+}
+
+cjson_value* cjson_node_to_value(cjson_node* n)
+{
+	return cjson_node_to_value_ex(cjson_global_settings(), n);
+}
+
+cjson_value* cjson_node_to_value_ex(cjson_settings* settings, cjson_node* n)
+{
+	if (n->flags & cjson_string) return cjson_create_string_ex(settings, n->string);
+	if (n->flags & cjson_double) return cjson_create_double_ex(settings, n->doubleval);
+	if (n->flags & cjson_unsigned) return cjson_create_uint64_ex(settings, (unsigned long long)n->intval);
+	if (n->flags & cjson_integer) return cjson_create_int64_ex(settings, n->intval);
+	if (n->flags & cjson_boolean) return cjson_create_boolean_ex(settings, (int)n->intval);
+	if (n->flags & cjson_null) return cjson_create_null_ex(settings);
+
+	if (n->flags & cjson_object) {
+		cjson_value* obj = cjson_create_object_ex(settings);
+		if (!obj) return NULL;
+
+		CJSON_NODE_OBJECT_FOR_EACH(n, k, v, {
+			cjson_value* child = cjson_node_to_value_ex(settings, v);
+			if (!child) {
+				cjson_free_value_ex(settings, obj);
+				return NULL;
+			}
+			cjson_insert_ex(settings, obj, k, child);
+		});
+		return obj;
+	}
+
+	if (n->flags & cjson_array) {
+		cjson_value* arr = cjson_create_array_ex(settings);
+		if (!arr) return NULL;
+
+		CJSON_NODE_ARRAY_FOR_EACH(n, v, {
+			cjson_value* child = cjson_node_to_value_ex(settings, v);
+			if (!child) {
+				cjson_free_value_ex(settings, arr);
+				return NULL;
+			}
+			cjson_append_ex(settings, arr, child);
+		});
+		return arr;
+	}
+
+	return NULL;
+}
+
+int cjson_node_is_string(cjson_node* n) { return (n->flags & (cjson_string | cjson_kv)) == cjson_string; }
+int cjson_node_is_number(cjson_node* n) { return n->flags & cjson_number; }
+int cjson_node_is_double(cjson_node* n) { return (n->flags & (cjson_number | cjson_double)) == (cjson_number | cjson_double); }
+int cjson_node_is_integer(cjson_node* n) { return (n->flags & (cjson_number | cjson_integer)) == (cjson_number | cjson_integer); }
+int cjson_node_is_object(cjson_node* n) { return n->flags & cjson_object; }
+int cjson_node_is_array(cjson_node* n) { return n->flags & cjson_array; }
+int cjson_node_is_boolean(cjson_node* n) { return n->flags & cjson_boolean; }
+int cjson_node_is_null(cjson_node* n) { return n->flags & cjson_null; }
+
+const char* cjson_node_get_string(cjson_node* n) { return n->string; }
+double cjson_node_get_double(cjson_node* n)
+{
+	if (n->flags & cjson_double) {
+		return n->doubleval;
+	}
+
+	return (n->flags & cjson_unsigned) ? (double)(unsigned long long)n->intval : (double)n->intval;
+}
+
+int cjson_node_get_integer(cjson_node* n) { return (int)n->intval; }
+long long cjson_node_get_int64(cjson_node* n) { return n->intval; }
+unsigned long long cjson_node_get_uint64(cjson_node* n) { return (unsigned long long)n->intval; }
+int cjson_node_true(cjson_node* n) { return n && n->intval == 1; }
+int cjson_node_false(cjson_node* n) { return n && n->intval == 0; }
+
+int cjson_node_length(cjson_node* n)
+{
+	if (n->flags & (cjson_object | cjson_array)) {
+		return (int)n->intval;
+	}
+
+	return 0;
+}
+
+cjson_node* cjson_node_next(cjson_node* n)
+{
+	if (n->flags & (cjson_object | cjson_array)) {
+		return n + n->size;
+	}
+
+	return n + 1;
+}
+
+cjson_node* cjson_node_array_at(cjson_node* n, int i)
+{
+	if (!(n->flags & cjson_array) || i < 0 || i >= n->intval) {
+		return NULL;
+	}
+
+	cjson_node* c = n + 1;
+	while (i-- > 0) {
+		c = cjson_node_next(c);
+	}
+	return c;
+}
+
+cjson_node* cjson_node_search_item(cjson_node* p, const char* k)
+{
+	if (!(p->flags & cjson_object)) {
+		return NULL;
+	}
+
+	size_t len = strlen(k);
+	CJSON_NODE_OBJECT_FOR_EACH(p, key, v, {
+		if (v[-1].size == len && memcmp(key, k, len) == 0) {
+			return v;
+		}
+	});
+	return NULL;
+}
+
+cjson_node* cjson_node_searchi_item(cjson_node* p, const char* k)
+{
+	if (!(p->flags & cjson_object)) {
+		return NULL;
+	}
+
+	CJSON_NODE_OBJECT_FOR_EACH(p, key, v, {
+		if (stricmp(key, k) == 0) {
+			return v;
+		}
+	});
+	return NULL;
+}
+
+/*================ Tape functions ================*/
+
+// A tape is a cjson_compact written out without pointers, all integers are little-endian:
+//   header: "CJTP", u32 version, u64 amount of nodes, u64 amount of string bytes
+//   nodes: 16 bytes each (u32 flags, u32 size, u64 payload), in the same order as the nodes of a cjson_compact
+//   strings: NUL-terminated strings and keys
+// The payload of a string or key node is the distance in bytes from the node to its string, which keeps the tape
+// position-independent. Every other payload holds the same value as the intval (or doubleval bits) of a cjson_node.
+#define CJSON_TAPE_MAGIC "CJTP"
+#define CJSON_TAPE_VERSION 1
+#define CJSON_TAPE_HEADER 24
+// Flags that are stored in a tape, the rest only describe how a cjson_value is allocated.
+#define CJSON_TAPE_FLAGS (cjson_kv | cjson_string | cjson_number | cjson_object | cjson_array | cjson_boolean | cjson_null | cjson_integer | cjson_double | cjson_unsigned)
+#define CJSON_TAPE_STACK 64
+
+struct __cjson_tape_node {
+	unsigned char flags[4];
+	unsigned char size[4];
+	unsigned char payload[8];
+};
+
+struct __cjson_tape {
+	cjson_settings* settings;
+	const unsigned char* data;
+	size_t len;
+	char* owned; // file contents read into memory, NULL otherwise
+	int mapped; // data is a mapping of a file
+};
+
+// Open container while checking a tape, see cjson_tape_check.
+typedef struct {
+	size_t end; // index one past the last node of the container
+	unsigned long long left; // members or elements not seen yet
+	int object;
+	int want_key;
+} cjson_tape_frame;
+
+unsigned int cjson_load_u32(const unsigned char* p)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	unsigned int v;
+	memcpy(&v, p, 4);
+	return v;
+#else
+	return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+#endif
+}
+
+unsigned long long cjson_load_u64(const unsigned char* p)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	unsigned long long v;
+	memcpy(&v, p, 8);
+	return v;
+#else
+	return (unsigned long long)cjson_load_u32(p) | ((unsigned long long)cjson_load_u32(p + 4) << 32);
+#endif
+}
+
+void cjson_store_u32(unsigned char* p, unsigned int v)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	memcpy(p, &v, 4);
+#else
+	p[0] = (unsigned char)v;
+	p[1] = (unsigned char)(v >> 8);
+	p[2] = (unsigned char)(v >> 16);
+	p[3] = (unsigned char)(v >> 24);
+#endif
+}
+
+void cjson_store_u64(unsigned char* p, unsigned long long v)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	memcpy(p, &v, 8);
+#else
+	cjson_store_u32(p, (unsigned int)v);
+	cjson_store_u32(p + 4, (unsigned int)(v >> 32));
+#endif
+}
+
+void cjson_tape_string(cjson_tape_node* n, const char* str, unsigned int flags, char** strings)
+{
+	size_t len = strlen(str);
+	memcpy(*strings, str, len + 1);
+	cjson_store_u32(n->flags, flags);
+	cjson_store_u32(n->size, (unsigned int)len);
+	cjson_store_u64(n->payload, (unsigned long long)(*strings - (char*)n));
+	*strings += len + 1;
+}
+
+// Writes v starting at n, returns the amount of nodes written (see cjson_compact_fill).
+size_t cjson_tape_fill(cjson_value* v, cjson_tape_node* n, char** strings)
+{
+	if (v->flags & cjson_string) {
+		cjson_tape_string(n, v->string, cjson_string, strings);
+		return 1;
+	}
+
+	size_t count = 1;
+	unsigned long long payload = (unsigned long long)v->intval;
+
+	if (v->flags & cjson_object) {
+		payload = 0;
+		cjson_value* c = v->child;
+		while (c != NULL) {
+			cjson_tape_string(&n[count++], c->string, cjson_kv, strings);
+			count += cjson_tape_fill(c->child, &n[count], strings);
+			++payload;
+			c = c->next;
+		}
+	}
+	else if (v->flags & cjson_array) {
+		payload = 0;
+		cjson_value* c = v->child;
+		while (c != NULL) {
+			count += cjson_tape_fill(c, &n[count], strings);
+			++payload;
+			c = c->next;
+		}
+	}
+	else if (v->flags & cjson_double) {
+		memcpy(&payload, &v->doubleval, 8);
+	}
+
+	cjson_store_u32(n->flags, (unsigned int)(v->flags & CJSON_TAPE_FLAGS));
+	cjson_store_u32(n->size, (unsigned int)count);
+	cjson_store_u64(n->payload, payload);
+	return count;
+}
+
+int cjson_tape_encode(cjson_value* v, cjson_buffer* buffer)
+{
+	if (!v || !buffer) {
+		return 0;
+	}
+
+	size_t nodes = 0;
+	size_t bytes = 0;
+	cjson_compact_measure(v, &nodes, &bytes);
+	if (nodes > UINT_MAX) {
+		return 0; // spans are stored in 32 bits
+	}
+
+	// Buffers belong to no settings, they are grown with realloc just like by cjson_stringify_to.
+	size_t len = CJSON_TAPE_HEADER + nodes * sizeof(cjson_tape_node) + bytes;
+	if (len > buffer->capacity) {
+		char* data = realloc(buffer->data, len);
+		if (!data) {
+			return 0;
+		}
+		buffer->data = data;
+		buffer->capacity = len;
+	}
+
+	unsigned char* header = (unsigned char*)buffer->data;
+	memcpy(header, CJSON_TAPE_MAGIC, 4);
+	cjson_store_u32(header + 4, CJSON_TAPE_VERSION);
+	cjson_store_u64(header + 8, nodes);
+	cjson_store_u64(header + 16, bytes);
+
+	cjson_tape_node* n = (cjson_tape_node*)(buffer->data + CJSON_TAPE_HEADER);
+	char* strings = (char*)&n[nodes];
+	cjson_tape_fill(v, n, &strings);
+	buffer->length = len;
+	return 1;
+}
+
+// The tape is written next to filename and then renamed over it, so that processes which mapped the previous
+// version of the file keep seeing it unchanged.
+int cjson_tape_write_file(cjson_value* v, const char* filename)
+{
+	cjson_buffer buffer = { NULL, 0, 0 };
+	if (!cjson_tape_encode(v, &buffer)) {
+		cjson_buffer_free(&buffer);
+		return 0;
+	}
+
+	size_t name_len = strlen(filename);
+	char* tmp = malloc(name_len + 5);
+	if (!tmp) {
+		cjson_buffer_free(&buffer);
+		return 0;
+	}
+	memcpy(tmp, filename, name_len);
+	memcpy(tmp + name_len, ".tmp", 5);
+
+	int ok = 0;
+	FILE* file = fopen(tmp, "wb");
+	if (file) {
+		ok = fwrite(buffer.data, 1, buffer.length, file) == buffer.length;
+		ok = fclose(file) == 0 && ok;
+		if (!ok || rename(tmp, filename) != 0) {
+			remove(tmp);
+			ok = 0;
+		}
+	}
+
+	free(tmp);
+	cjson_buffer_free(&buffer);
+	return ok;
+}
+
+// Checks that the nodes of a tape nest properly, that containers hold as many members or elements as they claim and
+// that every string lies inside of the string section, so the accessors never have to check anything. Only the nodes
+// are read, the strings are not touched. Returns 0 when the tape is malformed, -1 when allocating failed.
+int cjson_tape_check(cjson_settings* settings, const cjson_tape_node* nodes, size_t count, size_t strings_begin, size_t strings_end)
+{
+	cjson_tape_frame stack[CJSON_TAPE_STACK];
+	cjson_tape_frame* frames = stack;
+	size_t capacity = CJSON_TAPE_STACK;
+	size_t depth = 0;
+	int ok = 0;
+
+	for (size_t i = 0; i <= count; ++i) {
+		// Close the containers ending here.
+		while (depth && frames[depth - 1].end == i) {
+			cjson_tape_frame* f = &frames[depth - 1];
+			if (f->left || (f->object && !f->want_key)) {
+				goto done;
+			}
+			--depth;
+		}
+
+		if (i == count) {
+			ok = depth == 0;
+			break;
+		}
+
+		const cjson_tape_node* n = &nodes[i];
+		unsigned int flags = cjson_load_u32(n->flags);
+		unsigned int size = cjson_load_u32(n->size);
+		unsigned long long payload = cjson_load_u64(n->payload);
+		size_t parent_end = count;
+
+		if (depth) {
+			cjson_tape_frame* f = &frames[depth - 1];
+			parent_end = f->end;
+			if (f->object && f->want_key) {
+				if (flags != cjson_kv || !f->left) {
+					goto done;
+				}
+				--f->left;
+				f->want_key = 0;
+			}
+			else if (f->object) {
+				f->want_key = 1;
+			}
+			else if (!f->left--) {
+				goto done;
+			}
+		}
+		else if (i != 0) {
+			goto done; // more than one root value
+		}
+
+		switch (flags) {
+			case cjson_kv:
+				if (!depth || frames[depth - 1].want_key) {
+					goto done; // a key outside of an object, or where a value was expected
+				}
+				// fallthrough
+			case cjson_string: {
+				// The string and its terminator must lie inside of the string section.
+				size_t ofs = CJSON_TAPE_HEADER + i * sizeof(cjson_tape_node);
+				if (payload >= strings_end - ofs) {
+					goto done;
+				}
+				size_t str = ofs + (size_t)payload;
+				if (str < strings_begin || size >= strings_end - str) {
+					goto done;
+				}
+				break;
+			}
+			case cjson_object:
+			case cjson_array:
+				if (size == 0 || size > parent_end - i || payload >= size) {
+					goto done;
+				}
+				if (depth == capacity) {
+					cjson_tape_frame* grown = cjson_alloc(settings, capacity * 2 * sizeof(cjson_tape_frame));
+					if (!grown) {
+						ok = -1;
+						goto done;
+					}
+					memcpy(grown, frames, depth * sizeof(cjson_tape_frame));
+					if (frames != stack) {
+						cjson_free(settings, frames);
+					}
+					frames = grown;
+					capacity *= 2;
+				}
+				frames[depth].end = i + size;
+				frames[depth].left = payload;
+				frames[depth].object = flags == cjson_object;
+				frames[depth].want_key = 1;
+				++depth;
+				break;
+			case cjson_number | cjson_integer:
+			case cjson_number | cjson_integer | cjson_unsigned:
+			case cjson_number | cjson_double:
+			case cjson_null:
+				break;
+			case cjson_boolean:
+				if (payload > 1) {
+					goto done;
+				}
+				break;
+			default:
+				goto done;
+		}
+	}
+
+done:
+	if (frames != stack) {
+		cjson_free(settings, frames);
+	}
+	return ok;
+}
+
+cjson_tape* cjson_tape_load_ex(cjson_settings* settings, const void* data, size_t len)
+{
+	if (!settings || !data) {
+		return NULL;
+	}
+
+	const unsigned char* header = data;
+	if (len < CJSON_TAPE_HEADER || memcmp(header, CJSON_TAPE_MAGIC, 4) != 0 || cjson_load_u32(header + 4) != CJSON_TAPE_VERSION) {
+		settings->errc = cjson_error_code_invalid_tape;
+		return NULL;
+	}
+
+	unsigned long long nodes = cjson_load_u64(header + 8);
+	unsigned long long bytes = cjson_load_u64(header + 16);
+	size_t room = len - CJSON_TAPE_HEADER;
+	if (nodes == 0 || nodes > room / sizeof(cjson_tape_node) || bytes != room - nodes * sizeof(cjson_tape_node) || (bytes && header[len - 1] != 0)) {
+		settings->errc = cjson_error_code_invalid_tape;
+		return NULL;
+	}
+
+	int checked = cjson_tape_check(settings, (const cjson_tape_node*)(header + CJSON_TAPE_HEADER), (size_t)nodes, len - (size_t)bytes, len);
+	if (checked <= 0) {
+		if (checked == 0) {
+			settings->errc = cjson_error_code_invalid_tape;
+		}
+		return NULL;
+	}
+
+	cjson_tape* tape = cjson_alloc(settings, sizeof(cjson_tape));
+	if (!tape) {
+		return NULL;
+	}
+
+	tape->settings = settings;
+	tape->data = header;
+	tape->len = len;
+	tape->owned = NULL;
+	tape->mapped = 0;
+	return tape;
+}
+
+cjson_tape* cjson_tape_load_file_ex(cjson_settings* settings, const char* filename)
+{
+	if (!settings) {
+		return NULL;
+	}
+
+#ifdef CJSON_MMAP
+	size_t map_len;
+	const char* map = cjson_map_file(filename, &map_len);
+	if (map) {
+		cjson_tape* tape = cjson_tape_load_ex(settings, map, map_len);
+		if (!tape) {
+			munmap((void*)map, map_len);
+			return NULL;
+		}
+		// The nodes were checked front to back, accessing them jumps around.
+		madvise((void*)map, map_len, MADV_NORMAL);
+		tape->mapped = 1;
+		return tape;
+	}
+#endif
+
+	size_t len;
+	char* buf = cjson_read_file(settings, NULL, filename, &len);
+	if (!buf) {
+		return NULL;
+	}
+
+	cjson_tape* tape = cjson_tape_load_ex(settings, buf, len);
+	if (!tape) {
+		cjson_free(settings, buf);
+		return NULL;
+	}
+	tape->owned = buf;
+	return tape;
+}
+
+cjson_tape* cjson_tape_load(const void* data, size_t len)
+{
+	return cjson_tape_load_ex(cjson_global_settings(), data, len);
+}
+
+cjson_tape* cjson_tape_load_file(const char* filename)
+{
+	return cjson_tape_load_file_ex(cjson_global_settings(), filename);
+}
+
+void cjson_free_tape(cjson_tape* tape)
+{
+	if (!tape) {
+		return;
+	}
+
+#ifdef CJSON_MMAP
+	if (tape->mapped) {
+		munmap((void*)tape->data, tape->len);
+	}
+#endif
+	cjson_free(tape->settings, tape->owned);
+	cjson_free(tape->settings, tape);
+}
+
+const cjson_tape_node* cjson_tape_root(cjson_tape* tape)
+{
+	return tape ? (const cjson_tape_node*)(tape->data + CJSON_TAPE_HEADER) : NULL;
+}
+
+cjson_value* cjson_tape_to_value(const cjson_tape_node* n)
+{
+	return cjson_tape_to_value_ex(cjson_global_settings(), n);
+}
+
+cjson_value* cjson_tape_to_value_ex(cjson_settings* settings, const cjson_tape_node* n)
+{
+	unsigned int flags = cjson_load_u32(n->flags);
+	if (flags & cjson_string) return cjson_create_string_ex(settings, cjson_tape_get_string(n, NULL));
+	if (flags & cjson_double) return cjson_create_double_ex(settings, cjson_tape_get_double(n));
+	if (flags & cjson_unsigned) return cjson_create_uint64_ex(settings, cjson_tape_get_uint64(n));
+	if (flags & cjson_integer) return cjson_create_int64_ex(settings, cjson_tape_get_int64(n));
+	if (flags & cjson_boolean) return cjson_create_boolean_ex(settings, cjson_tape_true(n));
+	if (flags & cjson_null) return cjson_create_null_ex(settings);
+
+	if (flags & cjson_object) {
+		cjson_value* obj = cjson_create_object_ex(settings);
+		if (!obj) return NULL;
+
+		CJSON_TAPE_OBJECT_FOR_EACH(n, k, v, {
+			cjson_value* child = cjson_tape_to_value_ex(settings, v);
+			if (!child) {
+				cjson_free_value_ex(settings, obj);
+				return NULL;
+			}
+			cjson_insert_ex(settings, obj, k, child);
+		});
+		return obj;
+	}
+
+	if (flags & cjson_array) {
+		cjson_value* arr = cjson_create_array_ex(settings);
+		if (!arr) return NULL;
+
+		CJSON_TAPE_ARRAY_FOR_EACH(n, v, {
+			cjson_value* child = cjson_tape_to_value_ex(settings, v);
+			if (!child) {
+				cjson_free_value_ex(settings, arr);
+				return NULL;
+			}
+			cjson_append_ex(settings, arr, child);
+		});
+		return arr;
+	}
+
+	return NULL;
+}
+
+int cjson_tape_is_string(const cjson_tape_node* n) { return cjson_load_u32(n->flags) == cjson_string; }
+int cjson_tape_is_number(const cjson_tape_node* n) { return (cjson_load_u32(n->flags) & cjson_number) != 0; }
+int cjson_tape_is_double(const cjson_tape_node* n) { return (cjson_load_u32(n->flags) & cjson_double) != 0; }
+int cjson_tape_is_integer(const cjson_tape_node* n) { return (cjson_load_u32(n->flags) & cjson_integer) != 0; }
+int cjson_tape_is_object(const cjson_tape_node* n) { return cjson_load_u32(n->flags) == cjson_object; }
+int cjson_tape_is_array(const cjson_tape_node* n) { return cjson_load_u32(n->flags) == cjson_array; }
+int cjson_tape_is_boolean(const cjson_tape_node* n) { return cjson_load_u32(n->flags) == cjson_boolean; }
+int cjson_tape_is_null(const cjson_tape_node* n) { return cjson_load_u32(n->flags) == cjson_null; }
+
+const char* cjson_tape_get_string(const cjson_tape_node* n, size_t* len)
+{
+	if (len) {
+		*len = cjson_load_u32(n->size);
+	}
+	return (const char*)n + cjson_load_u64(n->payload);
+}
+
+double cjson_tape_get_double(const cjson_tape_node* n)
+{
+	unsigned int flags = cjson_load_u32(n->flags);
+	unsigned long long payload = cjson_load_u64(n->payload);
+	if (flags & cjson_double) {
+		double d;
+		memcpy(&d, &payload, 8);
+		return d;
+	}
+
+	return (flags & cjson_unsigned) ? (double)payload : (double)(long long)payload;
+}
+
+int cjson_tape_get_integer(const cjson_tape_node* n) { return (int)cjson_load_u64(n->payload); }
+long long cjson_tape_get_int64(const cjson_tape_node* n) { return (long long)cjson_load_u64(n->payload); }
+unsigned long long cjson_tape_get_uint64(const cjson_tape_node* n) { return cjson_load_u64(n->payload); }
+int cjson_tape_true(const cjson_tape_node* n) { return n && cjson_tape_is_boolean(n) && cjson_load_u64(n->payload) == 1; }
+int cjson_tape_false(const cjson_tape_node* n) { return n && cjson_tape_is_boolean(n) && cjson_load_u64(n->payload) == 0; }
+
+int cjson_tape_length(const cjson_tape_node* n)
+{
+	if (cjson_load_u32(n->flags) & (cjson_object | cjson_array)) {
+		return (int)cjson_load_u64(n->payload);
+	}
+
+	return 0;
+}
+
+const cjson_tape_node* cjson_tape_first(const cjson_tape_node* n)
+{
+	return n + 1;
+}
+
+const cjson_tape_node* cjson_tape_next(const cjson_tape_node* n)
+{
+	if (cjson_load_u32(n->flags) & (cjson_object | cjson_array)) {
+		return n + cjson_load_u32(n->size);
+	}
+
+	return n + 1;
+}
+
+const cjson_tape_node* cjson_tape_array_at(const cjson_tape_node* n, int i)
+{
+	if (!cjson_tape_is_array(n) || i < 0 || (unsigned long long)i >= cjson_load_u64(n->payload)) {
+		return NULL;
+	}
+
+	const cjson_tape_node* c = n + 1;
+	while (i-- > 0) {
+		c = cjson_tape_next(c);
+	}
+	return c;
+}
+
+const cjson_tape_node* cjson_tape_search_item(const cjson_tape_node* p, const char* k)
+{
+	if (!cjson_tape_is_object(p)) {
+		return NULL;
+	}
+
+	size_t len = strlen(k);
+	CJSON_TAPE_OBJECT_FOR_EACH(p, key, v, {
+		if (key_len == len && memcmp(key, k, len) == 0) {
+			return v;
+		}
+	});
+	return NULL;
+}
+
+const cjson_tape_node* cjson_tape_searchi_item(const cjson_tape_node* p, const char* k)
+{
+	if (!cjson_tape_is_object(p)) {
+		return NULL;
+	}
+
+	CJSON_TAPE_OBJECT_FOR_EACH(p, key, v, {
+		if (stricmp(key, k) == 0) {
+			return v;
+		}
+	});
+	return NULL;
+}
+
+/*================ MessagePack and CBOR functions ================*/
+
+// Binary input nested deeper than this is rejected, decoding recurses once per level.
+#define CJSON_BINARY_MAX_DEPTH 512
+
+// Decodes MessagePack or CBOR. When decoding in place, every string is terminated by overwriting the byte following
+// it, which is the first byte of the next item (or of nothing). That byte is kept aside in held_byte until it is read.
+typedef struct {
+	cjson_settings* settings;
+	const unsigned char* buf;
+	size_t len;
+	size_t pos;
+	unsigned char* insitu; // buf when decoding in place, NULL otherwise
+	size_t held; // offset of the byte overwritten by the last terminator, (size_t)-1 when none was
+	unsigned char held_byte;
+	int depth;
+} cjson_binary_reader;
+
+void cjson_binary_reader_init(cjson_binary_reader* r, cjson_settings* settings, const void* data, size_t len, void* insitu)
+{
+	r->settings = settings;
+	r->buf = data;
+	r->len = len;
+	r->pos = 0;
+	r->insitu = insitu;
+	r->held = (size_t)-1;
+	r->held_byte = 0;
+	r->depth = 0;
+}
+
+cjson_value* cjson_binary_fail(cjson_binary_reader* r)
+{
+	r->settings->errc = cjson_error_code_invalid_binary;
+	return NULL;
+}
+
+// Reads an unsigned big-endian integer of n bytes (at most 8). Returns 0 at the end of the input.
+int cjson_binary_read(cjson_binary_reader* r, size_t n, unsigned long long* out)
+{
+	if (n > r->len - r->pos) {
+		return 0;
+	}
+
+	unsigned long long v = 0;
+	for (size_t i = 0; i < n; ++i, ++r->pos) {
+		v = (v << 8) | (r->pos == r->held ? r->held_byte : r->buf[r->pos]);
+	}
+	*out = v;
+	return 1;
+}
+
+// Returns the len bytes at the current position as a NUL-terminated string, which points into the input when
+// decoding in place (*flags is then set to cjson_borrowed) and is copied otherwise. Returns NULL on failure.
+char* cjson_binary_string(cjson_binary_reader* r, size_t len, int* flags)
+{
+	if (len > r->len - r->pos) {
+		cjson_binary_fail(r);
+		return NULL;
+	}
+
+	const unsigned char* str = r->buf + r->pos;
+	r->pos += len;
+	*flags = 0;
+
+	// The string at the very end of the input has no byte left to hold its terminator.
+	if (r->insitu && r->pos < r->len) {
+		r->held = r->pos;
+		r->held_byte = r->buf[r->pos];
+		r->insitu[r->pos] = 0;
+		*flags = cjson_borrowed;
+		return (char*)str;
+	}
+
+	char* copy = cjson_alloc(r->settings, len + 1);
+	if (!copy) {
+		return NULL;
+	}
+	memcpy(copy, str, len);
+	copy[len] = 0;
+	return copy;
+}
+
+cjson_value* cjson_binary_create_string(cjson_binary_reader* r, size_t len)
+{
+	int flags;
+	char* str = cjson_binary_string(r, len, &flags);
+	if (!str) {
+		return NULL;
+	}
+
+	cjson_value* v = cjson_create_empty_ex(r->settings);
+	if (!v) {
+		if (!flags) cjson_free(r->settings, str);
+		return NULL;
+	}
+
+	v->flags = cjson_string | flags;
+	v->string = str;
+	return v;
+}
+
+// Returns the next byte without consuming it, or -1 at the end of the input.
+int cjson_binary_peek(cjson_binary_reader* r)
+{
+	if (r->pos >= r->len) {
+		return -1;
+	}
+	return r->pos == r->held ? r->held_byte : r->buf[r->pos];
+}
+
+// Turns a decoded map key into a string: strings are moved out of key, integers (which MessagePack and CBOR allow as
+// keys) become their decimal representation, anything else fails. key is freed. Returns NULL on failure.
+char* cjson_binary_key_from_value(cjson_binary_reader* r, cjson_value* key, int* flags)
+{
+	char digits[32];
+	char* k = NULL;
+	*flags = 0;
+
+	if (!key) {
+		return NULL;
+	}
+
+	if (key->flags & cjson_string) {
+		k = key->string;
+		*flags = key->flags & cjson_borrowed;
+		key->string = NULL;
+	}
+	else if (key->flags & cjson_integer) {
+		size_t len = (key->flags & cjson_unsigned)
+			? (size_t)snprintf(digits, sizeof(digits), "%llu", (unsigned long long)key->intval)
+			: (size_t)snprintf(digits, sizeof(digits), "%lld", key->intval);
+		k = cjson_alloc(r->settings, len + 1);
+		if (k) {
+			memcpy(k, digits, len + 1);
+		}
+	}
+	else {
+		cjson_binary_fail(r);
+	}
+
+	cjson_free_value_ex(r->settings, key);
+	return k;
+}
+
+// Inserts the member k -> v into obj, k and v are freed on failure.
+int cjson_binary_insert(cjson_binary_reader* r, cjson_value* obj, char* k, int flags, cjson_value* v)
+{
+	if (!cjson_insert_kv(r->settings, NULL, obj, k, v, flags)) {
+		if (!flags) cjson_free(r->settings, k);
+		cjson_free_value_ex(r->settings, v);
+		return 0;
+	}
+	return 1;
+}
+
+// Converts an IEEE 754 half-precision float.
+double cjson_half_to_double(unsigned int half)
+{
+	unsigned int exp = (half >> 10) & 0x1f;
+	unsigned int mant = half & 0x3ff;
+	double v;
+	if (exp == 0) v = ldexp(mant, -24);
+	else if (exp != 31) v = ldexp(mant + 1024, (int)exp - 25);
+	else v = mant ? NAN : INFINITY;
+	return (half & 0x8000) ? -v : v;
+}
+
+double cjson_float_bits_to_double(unsigned long long bits, size_t n)
+{
+	if (n == 2) {
+		return cjson_half_to_double((unsigned int)bits);
+	}
+	if (n == 4) {
+		unsigned int u = (unsigned int)bits;
+		float f;
+		memcpy(&f, &u, 4);
+		return f;
+	}
+
+	double d;
+	memcpy(&d, &bits, 8);
+	return d;
+}
+
+cjson_value* cjson_msgpack_read(cjson_binary_reader* r);
+
+// Reads a map key, string keys are read without creating a value for them.
+char* cjson_msgpack_read_key(cjson_binary_reader* r, int* flags)
+{
+	int b = cjson_binary_peek(r);
+	unsigned long long n;
+	if (b >= 0xa0 && b <= 0xbf) {
+		++r->pos;
+		return cjson_binary_string(r, b & 0x1f, flags);
+	}
+	if ((b >= 0xd9 && b <= 0xdb) || (b >= 0xc4 && b <= 0xc6)) {
+		++r->pos;
+		if (!cjson_binary_read(r, (size_t)1 << ((b >= 0xd9 ? b - 0xd9 : b - 0xc4)), &n)) {
+			cjson_binary_fail(r);
+			return NULL;
+		}
+		return cjson_binary_string(r, (size_t)n, flags);
+	}
+
+	return cjson_binary_key_from_value(r, cjson_msgpack_read(r), flags);
+}
+
+cjson_value* cjson_msgpack_read_container(cjson_binary_reader* r, unsigned long long count, int object)
+{
+	if (++r->depth > CJSON_BINARY_MAX_DEPTH) {
+		return cjson_binary_fail(r);
+	}
+
+	cjson_value* c = object ? cjson_create_object_ex(r->settings) : cjson_create_array_ex(r->settings);
+	if (!c) {
+		return NULL;
+	}
+
+	// The count is not trusted to preallocate anything, every item takes at least one byte of input.
+	for (unsigned long long i = 0; i < count; ++i) {
+		char* key = NULL;
+		int key_flags = 0;
+		if (object && !(key = cjson_msgpack_read_key(r, &key_flags))) {
+			cjson_free_value_ex(r->settings, c);
+			return NULL;
+		}
+
+		cjson_value* v = cjson_msgpack_read(r);
+		if (!v) {
+			if (!key_flags) cjson_free(r->settings, key);
+			cjson_free_value_ex(r->settings, c);
+			return NULL;
+		}
+
+		if (object) {
+			if (!cjson_binary_insert(r, c, key, key_flags, v)) {
+				cjson_free_value_ex(r->settings, c);
+				return NULL;
+			}
+		}
+		else {
+			cjson_append_ex(r->settings, c, v);
+		}
+	}
+
+	--r->depth;
+	return c;
+}
+
+cjson_value* cjson_msgpack_read(cjson_binary_reader* r)
+{
+	unsigned long long b;
+	unsigned long long n;
+	if (!cjson_binary_read(r, 1, &b)) {
+		return cjson_binary_fail(r);
+	}
+
+	if (b <= 0x7f) return cjson_create_int64_ex(r->settings, (long long)b);
+	if (b >= 0xe0) return cjson_create_int64_ex(r->settings, (long long)b - 256);
+	if (b <= 0x8f) return cjson_msgpack_read_container(r, b & 0x0f, 1);
+	if (b <= 0x9f) return cjson_msgpack_read_container(r, b & 0x0f, 0);
+	if (b <= 0xbf) return cjson_binary_create_string(r, b & 0x1f);
+
+	switch (b) {
+		case 0xc0: return cjson_create_null_ex(r->settings);
+		case 0xc2: return cjson_create_boolean_ex(r->settings, 0);
+		case 0xc3: return cjson_create_boolean_ex(r->settings, 1);
+		case 0xc4: case 0xc5: case 0xc6: // bin 8/16/32, decoded as strings
+		case 0xd9: case 0xda: case 0xdb: // str 8/16/32
+			if (!cjson_binary_read(r, (size_t)1 << ((b >= 0xd9 ? b - 0xd9 : b - 0xc4)), &n)) break;
+			return cjson_binary_create_string(r, (size_t)n);
+		case 0xca: case 0xcb: // float 32/64
+			if (!cjson_binary_read(r, b == 0xca ? 4 : 8, &n)) break;
+			return cjson_create_double_ex(r->settings, cjson_float_bits_to_double(n, b == 0xca ? 4 : 8));
+		case 0xcc: case 0xcd: case 0xce: case 0xcf: // uint 8/16/32/64
+			if (!cjson_binary_read(r, (size_t)1 << (b - 0xcc), &n)) break;
+			return cjson_create_uint64_ex(r->settings, n);
+		case 0xd0: case 0xd1: case 0xd2: case 0xd3: { // int 8/16/32/64, sign-extended
+			size_t bytes = (size_t)1 << (b - 0xd0);
+			if (!cjson_binary_read(r, bytes, &n)) break;
+			if (bytes < 8 && (n >> (bytes * 8 - 1))) {
+				n |= ~0ULL << (bytes * 8);
+			}
+			return cjson_create_int64_ex(r->settings, (long long)n);
+		}
+		case 0xdc: case 0xdd: // array 16/32
+			if (!cjson_binary_read(r, b == 0xdc ? 2 : 4, &n)) break;
+			return cjson_msgpack_read_container(r, n, 0);
+		case 0xde: case 0xdf: // map 16/32
+			if (!cjson_binary_read(r, b == 0xde ? 2 : 4, &n)) break;
+			return cjson_msgpack_read_container(r, n, 1);
+	}
+
+	// 0xc1 (never used), extension types, or a truncated item.
+	return cjson_binary_fail(r);
+}
+
+cjson_value* cjson_cbor_read(cjson_binary_reader* r);
+
+// Reads the argument of a CBOR head with additional information info, *indefinite is set for info 31.
+int cjson_cbor_argument(cjson_binary_reader* r, unsigned int info, unsigned long long* out, int* indefinite)
+{
+	*indefinite = 0;
+	if (info < 24) {
+		*out = info;
+		return 1;
+	}
+	if (info <= 27) {
+		return cjson_binary_read(r, (size_t)1 << (info - 24), out);
+	}
+	if (info == 31) {
+		*out = 0;
+		*indefinite = 1;
+		return 1;
+	}
+	return 0;
+}
+
+// Reads a map key, string keys of a definite length are read without creating a value for them.
+char* cjson_cbor_read_key(cjson_binary_reader* r, int* flags)
+{
+	int head = cjson_binary_peek(r);
+	if (head >= 0x40 && head < 0x80 && (head & 0x1f) != 31) {
+		unsigned long long n;
+		int indefinite;
+		++r->pos;
+		if (!cjson_cbor_argument(r, head & 0x1f, &n, &indefinite)) {
+			cjson_binary_fail(r);
+			return NULL;
+		}
+		return cjson_binary_string(r, (size_t)n, flags);
+	}
+
+	return cjson_binary_key_from_value(r, cjson_cbor_read(r), flags);
+}
+
+// Returns 1 (and consumes it) when the next byte is a break, which ends an indefinite-length item.
+int cjson_cbor_break(cjson_binary_reader* r)
+{
+	if (cjson_binary_peek(r) == 0xff) {
+		++r->pos;
+		return 1;
+	}
+	return 0;
+}
+
+// Concatenates the chunks of an indefinite-length string, which are always copied.
+cjson_value* cjson_cbor_read_chunks(cjson_binary_reader* r, unsigned int major)
+{
+	size_t len = 0;
+	size_t cap = 64;
+	char* str = cjson_alloc(r->settings, cap);
+	if (!str) {
+		return NULL;
+	}
+
+	while (!cjson_cbor_break(r)) {
+		unsigned long long head;
+		unsigned long long n;
+		int indefinite;
+		if (!cjson_binary_read(r, 1, &head) || (head >> 5) != major || !cjson_cbor_argument(r, head & 0x1f, &n, &indefinite)
+			|| indefinite || n > r->len - r->pos) {
+			cjson_free(r->settings, str);
+			return cjson_binary_fail(r);
+		}
+
+		if (len + n >= cap) {
+			while (len + n >= cap) cap *= 2;
+			char* grown = cjson_alloc(r->settings, cap);
+			if (!grown) {
+				cjson_free(r->settings, str);
+				return NULL;
+			}
+			memcpy(grown, str, len);
+			cjson_free(r->settings, str);
+			str = grown;
+		}
+
+		for (size_t i = 0; i < n; ++i, ++r->pos) {
+			str[len++] = (char)(r->pos == r->held ? r->held_byte : r->buf[r->pos]);
+		}
+	}
+
+	str[len] = 0;
+	cjson_value* v = cjson_create_empty_ex(r->settings);
+	if (!v) {
+		cjson_free(r->settings, str);
+		return NULL;
+	}
+	v->flags = cjson_string;
+	v->string = str;
+	return v;
+}
+
+cjson_value* cjson_cbor_read_container(cjson_binary_reader* r, unsigned long long count, int indefinite, int object)
+{
+	if (++r->depth > CJSON_BINARY_MAX_DEPTH) {
+		return cjson_binary_fail(r);
+	}
+
+	cjson_value* c = object ? cjson_create_object_ex(r->settings) : cjson_create_array_ex(r->settings);
+	if (!c) {
+		return NULL;
+	}
+
+	for (unsigned long long i = 0; indefinite ? !cjson_cbor_break(r) : i < count; ++i) {
+		char* key = NULL;
+		int key_flags = 0;
+		if (object && !(key = cjson_cbor_read_key(r, &key_flags))) {
+			cjson_free_value_ex(r->settings, c);
+			return NULL;
+		}
+
+		cjson_value* v = cjson_cbor_read(r);
+		if (!v) {
+			if (!key_flags) cjson_free(r->settings, key);
+			cjson_free_value_ex(r->settings, c);
+			return NULL;
+		}
+
+		if (object) {
+			if (!cjson_binary_insert(r, c, key, key_flags, v)) {
+				cjson_free_value_ex(r->settings, c);
+				return NULL;
+			}
+		}
+		else {
+			cjson_append_ex(r->settings, c, v);
+		}
+	}
+
+	--r->depth;
+	return c;
+}
+
+cjson_value* cjson_cbor_read(cjson_binary_reader* r)
+{
+	unsigned long long head;
+	unsigned long long n;
+	int indefinite;
+	if (!cjson_binary_read(r, 1, &head)) {
+		return cjson_binary_fail(r);
+	}
+
+	unsigned int major = (unsigned int)(head >> 5);
+	unsigned int info = (unsigned int)(head & 0x1f);
+	if (major == 7) {
+		switch (info) {
+			case 20: return cjson_create_boolean_ex(r->settings, 0);
+			case 21: return cjson_create_boolean_ex(r->settings, 1);
+			case 22: case 23: return cjson_create_null_ex(r->settings); // null and undefined
+			case 25: case 26: case 27: // half, single and double precision floats
+				if (!cjson_binary_read(r, (size_t)1 << (info - 24), &n)) break;
+				return cjson_create_double_ex(r->settings, cjson_float_bits_to_double(n, (size_t)1 << (info - 24)));
+		}
+		return cjson_binary_fail(r); // other simple values, or a break outside of an indefinite-length item
+	}
+
+	if (!cjson_cbor_argument(r, info, &n, &indefinite) || (indefinite && major < 2) || (indefinite && major == 6)) {
+		return cjson_binary_fail(r);
+	}
+
+	switch (major) {
+		case 0: return cjson_create_uint64_ex(r->settings, n);
+		case 1: // -1 - n, which only fits in a long long up to LLONG_MAX
+			if (n > LLONG_MAX) return cjson_create_double_ex(r->settings, -1.0 - (double)n);
+			return cjson_create_int64_ex(r->settings, -1 - (long long)n);
+		case 2: case 3: // byte strings are decoded as strings
+			if (indefinite) return cjson_cbor_read_chunks(r, major);
+			return cjson_binary_create_string(r, (size_t)n);
+		case 4: return cjson_cbor_read_container(r, n, indefinite, 0);
+		case 5: return cjson_cbor_read_container(r, n, indefinite, 1);
+	}
+
+	// Tags only annotate the item following them, which is decoded as it is.
+	if (++r->depth > CJSON_BINARY_MAX_DEPTH) {
+		return cjson_binary_fail(r);
+	}
+	cjson_value* v = cjson_cbor_read(r);
+	--r->depth;
+	return v;
+}
+
+// Decodes a whole input, trailing bytes after the root item fail.
+cjson_value* cjson_binary_decode(cjson_binary_reader* r, cjson_value* (*read)(cjson_binary_reader*))
+{
+	if (!r->settings || !r->buf) {
+		return NULL;
+	}
+
+	cjson_value* v = read(r);
+	if (v && r->pos != r->len) {
+		cjson_free_value_ex(r->settings, v);
+		return cjson_binary_fail(r);
+	}
+	return v;
+}
+
+cjson_value* cjson_msgpack_decode(const void* data, size_t len)
+{
+	return cjson_msgpack_decode_ex(cjson_global_settings(), data, len);
+}
+
+cjson_value* cjson_msgpack_decode_ex(cjson_settings* settings, const void* data, size_t len)
+{
+	cjson_binary_reader r;
+	cjson_binary_reader_init(&r, settings, data, len, NULL);
+	return cjson_binary_decode(&r, cjson_msgpack_read);
+}
+
+cjson_value* cjson_msgpack_decode_insitu(void* data, size_t len)
+{
+	return cjson_msgpack_decode_insitu_ex(cjson_global_settings(), data, len);
+}
+
+cjson_value* cjson_msgpack_decode_insitu_ex(cjson_settings* settings, void* data, size_t len)
+{
+	cjson_binary_reader r;
+	cjson_binary_reader_init(&r, settings, data, len, data);
+	return cjson_binary_decode(&r, cjson_msgpack_read);
+}
+
+cjson_value* cjson_cbor_decode(const void* data, size_t len)
+{
+	return cjson_cbor_decode_ex(cjson_global_settings(), data, len);
+}
+
+cjson_value* cjson_cbor_decode_ex(cjson_settings* settings, const void* data, size_t len)
+{
+	cjson_binary_reader r;
+	cjson_binary_reader_init(&r, settings, data, len, NULL);
+	return cjson_binary_decode(&r, cjson_cbor_read);
+}
+
+cjson_value* cjson_cbor_decode_insitu(void* data, size_t len)
+{
+	return cjson_cbor_decode_insitu_ex(cjson_global_settings(), data, len);
+}
+
+cjson_value* cjson_cbor_decode_insitu_ex(cjson_settings* settings, void* data, size_t len)
+{
+	cjson_binary_reader r;
+	cjson_binary_reader_init(&r, settings, data, len, data);
+	return cjson_binary_decode(&r, cjson_cbor_read);
+}
+
+// Writes prefix followed by the lowest n bytes of v in big-endian.
+void cjson_write_be(cjson_writer* w, unsigned char prefix, unsigned long long v, size_t n)
+{
+	unsigned char bytes[9];
+	bytes[0] = prefix;
+	for (size_t i = 0; i < n; ++i) {
+		bytes[n - i] = (unsigned char)(v >> (i * 8));
+	}
+	cjson_write(w, (const char*)bytes, n + 1);
+}
+
+// Returns 1 when d survives a round-trip through a float, so that it can be stored in 4 bytes.
+int cjson_fits_float(double d)
+{
+	return !isnan(d) && (isinf(d) || (fabs(d) <= FLT_MAX && (double)(float)d == d));
+}
+
+// Writes the shortest MessagePack head of a string, array or map: fix holds the fixed-size marker and its capacity.
+void cjson_msgpack_write_head(cjson_writer* w, unsigned char fix, size_t fix_max, unsigned char head8, unsigned char head16, unsigned char head32, size_t len)
+{
+	if (len <= fix_max) cjson_write_char(w, (char)(fix | len));
+	else if (len <= 0xff && head8) cjson_write_be(w, head8, len, 1);
+	else if (len <= 0xffff) cjson_write_be(w, head16, len, 2);
+	else if (len <= 0xffffffffULL) cjson_write_be(w, head32, len, 4);
+	else w->failed = 1;
+}
+
+void cjson_msgpack_write_string(cjson_writer* w, const char* str)
+{
+	size_t len = strlen(str);
+	cjson_msgpack_write_head(w, 0xa0, 31, 0xd9, 0xda, 0xdb, len);
+	cjson_write(w, str, len);
+}
+
+void cjson_msgpack_internal(cjson_writer* w, cjson_value* v)
+{
+	if (v->flags & cjson_string) {
+		cjson_msgpack_write_string(w, v->string);
+	}
+	else if (v->flags & cjson_double) {
+		if (cjson_fits_float(v->doubleval)) {
+			float f = (float)v->doubleval;
+			unsigned int bits;
+			memcpy(&bits, &f, 4);
+			cjson_write_be(w, 0xca, bits, 4);
+		}
+		else {
+			unsigned long long bits;
+			memcpy(&bits, &v->doubleval, 8);
+			cjson_write_be(w, 0xcb, bits, 8);
+		}
+	}
+	else if (v->flags & cjson_integer) {
+		long long i = v->intval;
+		unsigned long long u = (unsigned long long)i;
+		if ((v->flags & cjson_unsigned) || i >= 0) {
+			if (u <= 0x7f) cjson_write_char(w, (char)u);
+			else if (u <= 0xff) cjson_write_be(w, 0xcc, u, 1);
+			else if (u <= 0xffff) cjson_write_be(w, 0xcd, u, 2);
+			else if (u <= 0xffffffffULL) cjson_write_be(w, 0xce, u, 4);
+			else cjson_write_be(w, 0xcf, u, 8);
+		}
+		else if (i >= -32) cjson_write_char(w, (char)(0xe0 | (i & 0x1f)));
+		else if (i >= -128) cjson_write_be(w, 0xd0, u, 1);
+		else if (i >= -32768) cjson_write_be(w, 0xd1, u, 2);
+		else if (i >= INT_MIN) cjson_write_be(w, 0xd2, u, 4);
+		else cjson_write_be(w, 0xd3, u, 8);
+	}
+	else if (v->flags & cjson_object) {
+		cjson_msgpack_write_head(w, 0x80, 15, 0, 0xde, 0xdf, (size_t)v->intval);
+		for (cjson_value* c = v->child; c != NULL; c = c->next) {
+			cjson_msgpack_write_string(w, c->string);
+			cjson_msgpack_internal(w, c->child);
+		}
+	}
+	else if (v->flags & cjson_array) {
+		cjson_msgpack_write_head(w, 0x90, 15, 0, 0xdc, 0xdd, (size_t)v->intval);
+		for (cjson_value* c = v->child; c != NULL; c = c->next) {
+			cjson_msgpack_internal(w, c);
+		}
+	}
+	else if (v->flags & cjson_boolean) {
+		cjson_write_char(w, (char)(v->intval ? 0xc3 : 0xc2));
+	}
+	else {
+		cjson_write_char(w, (char)0xc0);
+	}
+}
+
+// Writes the shortest CBOR head of the given major type.
+void cjson_cbor_write_head(cjson_writer* w, unsigned int major, unsigned long long n)
+{
+	unsigned char m = (unsigned char)(major << 5);
+	if (n < 24) cjson_write_char(w, (char)(m | n));
+	else if (n <= 0xff) cjson_write_be(w, m | 24, n, 1);
+	else if (n <= 0xffff) cjson_write_be(w, m | 25, n, 2);
+	else if (n <= 0xffffffffULL) cjson_write_be(w, m | 26, n, 4);
+	else cjson_write_be(w, m | 27, n, 8);
+}
+
+void cjson_cbor_write_string(cjson_writer* w, const char* str)
+{
+	size_t len = strlen(str);
+	cjson_cbor_write_head(w, 3, len);
+	cjson_write(w, str, len);
+}
+
+void cjson_cbor_internal(cjson_writer* w, cjson_value* v)
+{
+	if (v->flags & cjson_string) {
+		cjson_cbor_write_string(w, v->string);
+	}
+	else if (v->flags & cjson_double) {
+		if (cjson_fits_float(v->doubleval)) {
+			float f = (float)v->doubleval;
+			unsigned int bits;
+			memcpy(&bits, &f, 4);
+			cjson_write_be(w, 0xfa, bits, 4);
+		}
+		else {
+			unsigned long long bits;
+			memcpy(&bits, &v->doubleval, 8);
+			cjson_write_be(w, 0xfb, bits, 8);
+		}
+	}
+	else if (v->flags & cjson_integer) {
+		if ((v->flags & cjson_unsigned) || v->intval >= 0) {
+			cjson_cbor_write_head(w, 0, (unsigned long long)v->intval);
+		}
+		else {
+			cjson_cbor_write_head(w, 1, (unsigned long long)(-(v->intval + 1)));
+		}
+	}
+	else if (v->flags & cjson_object) {
+		cjson_cbor_write_head(w, 5, (unsigned long long)v->intval);
+		for (cjson_value* c = v->child; c != NULL; c = c->next) {
+			cjson_cbor_write_string(w, c->string);
+			cjson_cbor_internal(w, c->child);
+		}
+	}
+	else if (v->flags & cjson_array) {
+		cjson_cbor_write_head(w, 4, (unsigned long long)v->intval);
+		for (cjson_value* c = v->child; c != NULL; c = c->next) {
+			cjson_cbor_internal(w, c);
+		}
+	}
+	else if (v->flags & cjson_boolean) {
+		cjson_write_char(w, (char)(v->intval ? 0xf5 : 0xf4));
+	}
+	else {
+		cjson_write_char(w, (char)0xf6);
+	}
+}
+
+// Encodes v into buffer with encode (see cjson_stringify_to, the writer grows the buffer with realloc).
+int cjson_binary_encode(cjson_value* v, cjson_buffer* buffer, void (*encode)(cjson_writer*, cjson_value*))
+{
+	if (!v || !buffer) {
+		return 0;
+	}
+
+	cjson_writer w = { buffer->data, 0, buffer->capacity, 0, NULL, NULL, -1, NULL };
+	encode(&w, v);
+
+	buffer->data = w.buf;
+	buffer->capacity = w.cap;
+	buffer->length = w.failed ? 0 : w.len;
+	return !w.failed;
+}
+
+int cjson_msgpack_encode(cjson_value* v, cjson_buffer* buffer)
+{
+	return cjson_binary_encode(v, buffer, cjson_msgpack_internal);
+}
+
+int cjson_cbor_encode(cjson_value* v, cjson_buffer* buffer)
+{
+	return cjson_binary_encode(v, buffer, cjson_cbor_internal);
+}
+
+/*================ Cache functions ================*/
+
+#ifdef CJSON_POSIX
+// Identifies the contents of a file without reading it, a file that was modified or replaced gets a different key.
+typedef struct {
+	unsigned long long dev;
+	unsigned long long ino;
+	unsigned long long size;
+	long long mtime;
+	long mtime_nsec;
+} cjson_file_key;
+
+typedef struct __cjson_cache_entry {
+	struct __cjson_cache_entry* prev; // used more recently
+	struct __cjson_cache_entry* next; // used less recently
+	char* path;
+	unsigned int hash;
+	cjson_file_key key;
+	cjson_document* doc; // the cache holds one reference
+	size_t bytes;
+} cjson_cache_entry;
+
+struct __cjson_cache {
+	cjson_settings* settings;
+	size_t budget;
+	cjson_cache_entry* head; // most recently used
+	cjson_cache_entry* tail; // evicted first
+	cjson_cache_stats stats;
+#ifdef CJSON_THREADS
+	pthread_mutex_t lock;
+#endif
+};
+
+int cjson_file_key_get(const char* filename, cjson_file_key* key)
+{
+	struct stat st;
+	if (stat(filename, &st) != 0 || !S_ISREG(st.st_mode)) {
+		return 0;
+	}
+
+	key->dev = (unsigned long long)st.st_dev;
+	key->ino = (unsigned long long)st.st_ino;
+	key->size = (unsigned long long)st.st_size;
+	key->mtime = (long long)st.st_mtime;
+#ifdef __APPLE__
+	key->mtime_nsec = st.st_mtimespec.tv_nsec;
+#else
+	key->mtime_nsec = st.st_mtim.tv_nsec;
+#endif
+	return 1;
+}
+
+int cjson_file_key_equal(const cjson_file_key* a, const cjson_file_key* b)
+{
+	return a->dev == b->dev && a->ino == b->ino && a->size == b->size && a->mtime == b->mtime && a->mtime_nsec == b->mtime_nsec;
+}
+
+void cjson_cache_lock(cjson_cache* cache)
+{
+#ifdef CJSON_THREADS
+	pthread_mutex_lock(&cache->lock);
+#else
+	CJSON_UNUSED(cache);
+#endif
+}
+
+void cjson_cache_unlock(cjson_cache* cache)
+{
+#ifdef CJSON_THREADS
+	pthread_mutex_unlock(&cache->lock);
+#else
+	CJSON_UNUSED(cache);
+#endif
+}
+
+void cjson_cache_unlink(cjson_cache* cache, cjson_cache_entry* e)
+{
+	if (e->prev) e->prev->next = e->next;
+	else cache->head = e->next;
+	if (e->next) e->next->prev = e->prev;
+	else cache->tail = e->prev;
+	e->prev = NULL;
+	e->next = NULL;
+}
+
+void cjson_cache_push_front(cjson_cache* cache, cjson_cache_entry* e)
+{
+	e->prev = NULL;
+	e->next = cache->head;
+	if (cache->head) cache->head->prev = e;
+	else cache->tail = e;
+	cache->head = e;
+}
+
+// Removes e from the cache and releases the reference it held, users of the document keep it alive.
+void cjson_cache_remove(cjson_cache* cache, cjson_cache_entry* e)
+{
+	cjson_cache_unlink(cache, e);
+	cache->stats.bytes -= e->bytes;
+	--cache->stats.entries;
+	cjson_free_document(e->doc);
+	cjson_free(cache->settings, e->path);
+	cjson_free(cache->settings, e);
+}
+
+cjson_cache* cjson_cache_create(size_t budget)
+{
+	return cjson_cache_create_ex(cjson_global_settings(), budget);
+}
+
+cjson_cache* cjson_cache_create_ex(cjson_settings* settings, size_t budget)
+{
+	if (!settings) {
+		return NULL;
+	}
+
+	cjson_cache* cache = cjson_alloc(settings, sizeof(cjson_cache));
+	if (!cache) {
+		return NULL;
+	}
+
+	memset(cache, 0, sizeof(*cache));
+	cache->settings = settings;
+	cache->budget = budget;
+#ifdef CJSON_THREADS
+	if (pthread_mutex_init(&cache->lock, NULL) != 0) {
+		cjson_free(settings, cache);
+		return NULL;
+	}
+#endif
+	return cache;
+}
+
+// Files are parsed while holding the lock, as the settings of the cache can only be used by one thread at a time.
+cjson_document* cjson_cache_parse_file(cjson_cache* cache, const char* filename)
+{
+	if (!cache || !filename) {
+		return NULL;
+	}
+
+	unsigned int hash;
+	unsigned int ihash;
+	cjson_hash_key(filename, &hash, &ihash);
+
+	cjson_cache_lock(cache);
+
+	// The file is looked at before it is parsed, so a change while parsing only leads to parsing it again next time.
+	cjson_file_key key;
+	if (!cjson_file_key_get(filename, &key)) {
+		++cache->stats.misses;
+		cjson_cache_unlock(cache);
+		return NULL;
+	}
+
+	cjson_cache_entry* e = cache->head;
+	while (e != NULL && (e->hash != hash || strcmp(e->path, filename) != 0)) {
+		e = e->next;
+	}
+
+	if (e && cjson_file_key_equal(&e->key, &key)) {
+		++cache->stats.hits;
+		cjson_cache_unlink(cache, e);
+		cjson_cache_push_front(cache, e);
+		__atomic_add_fetch(&e->doc->refs, 1, __ATOMIC_RELAXED);
+		cjson_document* doc = e->doc;
+		cjson_cache_unlock(cache);
+		return doc;
+	}
+
+	// The file changed (or was never parsed), the stale document is only freed once its users released it.
+	++cache->stats.misses;
+	if (e) {
+		cjson_cache_remove(cache, e);
+	}
+
+	cjson_document* doc = cjson_parse_document_file_ex(cache->settings, filename);
+	if (!doc) {
+		cjson_cache_unlock(cache);
+		return NULL;
+	}
+
+	// Documents that do not fit into the budget on their own are returned without being cached.
+	size_t bytes = cjson_document_memory(doc);
+	size_t len = strlen(filename);
+	e = bytes <= cache->budget ? cjson_alloc(cache->settings, sizeof(cjson_cache_entry)) : NULL;
+	char* path = e ? cjson_alloc(cache->settings, len + 1) : NULL;
+	if (!path) {
+		cjson_free(cache->settings, e);
+		cjson_cache_unlock(cache);
+		return doc;
+	}
+
+	memcpy(path, filename, len + 1);
+	e->path = path;
+	e->hash = hash;
+	e->key = key;
+	e->doc = doc;
+	e->bytes = bytes;
+	doc->refs = 2; // the cache and the caller
+	cjson_cache_push_front(cache, e);
+	cache->stats.bytes += bytes;
+	++cache->stats.entries;
+
+	while (cache->stats.bytes > cache->budget) {
+		cjson_cache_remove(cache, cache->tail);
+		++cache->stats.evictions;
+	}
+
+	cjson_cache_unlock(cache);
+	return doc;
+}
+
+void cjson_cache_get_stats(cjson_cache* cache, cjson_cache_stats* out)
+{
+	cjson_cache_lock(cache);
+	*out = cache->stats;
+	cjson_cache_unlock(cache);
+}
+
+void cjson_cache_clear(cjson_cache* cache)
+{
+	cjson_cache_lock(cache);
+	while (cache->head) {
+		cjson_cache_remove(cache, cache->head);
+	}
+	cjson_cache_unlock(cache);
+}
+
+void cjson_free_cache(cjson_cache* cache)
+{
+	if (!cache) {
+		return;
+	}
+
+	cjson_cache_clear(cache);
+#ifdef CJSON_THREADS
+	pthread_mutex_destroy(&cache->lock);
+#endif
+	cjson_free(cache->settings, cache);
+}
+#endif
+
+/*================ Event (SAX) functions ================*/
+
+#define CJSON_SAX_STACK 64
+#define CJSON_SAX_AFTER_VALUE 0x80
+
+typedef struct {
+	cjson_context ctx;
+	const cjson_sax_handler* handler;
+	void* user;
+	unsigned char* stack; // in_array or in_object of every open container, optionally | CJSON_SAX_AFTER_VALUE.
+	size_t depth;
+	size_t cap;
+	unsigned char local[CJSON_SAX_STACK]; // the stack only moves to the heap for deeply nested input.
+} cjson_sax_context;
+
+// Fast-forwards over the rest of a container whose opening bracket was just consumed.
+int cjson_skip_container(cjson_context* ctx)
+{
+	size_t depth = 1;
+	size_t len;
+	const char* end = ctx->buf + ctx->len;
+
+	while (1) {
+		const char* p = cjson_scan.structural(ctx->buf + ctx->pos->ofs, end);
+		ctx->pos->ofs = p - ctx->buf;
+		if (p == end) {
+			break;
+		}
+
+		switch (*p) {
+			case '"':
+				if (!cjson_consume_str_view(ctx, &p, &len)) {
+					return 0;
+				}
+				break;
+			case '/':
+				if (!cjson_consume_comments(ctx)) {
+					++ctx->pos->ofs;
+				}
+				break;
+			case '[':
+			case '{':
+				++depth;
+				++ctx->pos->ofs;
+				break;
+			default:
+				++ctx->pos->ofs;
+				if (--depth == 0) {
+					return 1;
+				}
+		}
+	}
+
+	// Just like cjson_parse, containers left open at the end of the input are only accepted when permissive.
+	if (!ctx->settings->permissive) {
+		ctx->settings->errc = cjson_error_code_syntax_unclosed_value;
+		return 0;
+	}
+	return 1;
+}
+
+int cjson_sax_result_ok(cjson_sax_context* sax, cjson_sax_result result)
+{
+	if (result == cjson_sax_abort) {
+		sax->ctx.settings->errc = cjson_error_code_aborted;
+		return 0;
+	}
+	return 1;
+}
+
+int cjson_sax_push(cjson_sax_context* sax, unsigned char type)
+{
+	if (sax->depth == sax->cap) {
+		unsigned char* stack = cjson_alloc(sax->ctx.settings, sax->cap * 2);
+		if (!stack) {
+			return 0;
+		}
+		memcpy(stack, sax->stack, sax->depth);
+		if (sax->stack != sax->local) {
+			cjson_free(sax->ctx.settings, sax->stack);
+		}
+		sax->stack = stack;
+		sax->cap *= 2;
+	}
+	sax->stack[sax->depth++] = type;
+	return 1;
+}
+
+int cjson_sax_end(cjson_sax_context* sax)
+{
+	const cjson_sax_handler* h = sax->handler;
+	cjson_sax_result result = cjson_sax_continue;
+
+	if ((sax->stack[--sax->depth] & ~CJSON_SAX_AFTER_VALUE) == in_object) {
+		if (h->on_end_object) result = h->on_end_object(sax->user);
+	}
+	else if (h->on_end_array) {
+		result = h->on_end_array(sax->user);
+	}
+	return cjson_sax_result_ok(sax, result);
+}
+
+// Parses the value at the current position, reporting it unless report is 0. Containers are entered, or skipped.
+int cjson_sax_value(cjson_sax_context* sax, int report)
+{
+	cjson_context* ctx = &sax->ctx;
+	const cjson_sax_handler* h = sax->handler;
+	cjson_sax_result result = cjson_sax_continue;
+	char c = cjson_curc(ctx);
+	char scratch[CJSON_SCRATCH_SIZE];
+
+	if (c == '{' || c == '[') {
+		cjson_consume(ctx);
+		if (report) {
+			cjson_sax_result (*cb)(void*) = c == '{' ? h->on_start_object : h->on_start_array;
+			if (cb) result = cb(sax->user);
+			if (!cjson_sax_result_ok(sax, result)) {
+				return 0;
+			}
+		}
+		if (!report || result == cjson_sax_skip) {
+			return cjson_skip_container(ctx);
+		}
+		return cjson_sax_push(sax, c == '{' ? in_object : in_array);
+	}
+	else if (c == '"') {
+		const char* str;
+		size_t len;
+		if (!cjson_consume_str_view(ctx, &str, &len)) {
+			return 0;
+		}
+		if (report && h->on_string) result = h->on_string(sax->user, str, len);
+	}
+	else if (isdigit(c) || c == '.' || c == '-') {
+		cjson_number_value number;
+		if (!cjson_consume_number(ctx, &number)) {
+			return 0;
+		}
+
+		unsigned long long u = (unsigned long long)number.intval;
+		if (report && (number.flags & cjson_double)) {
+			if (h->on_double) result = h->on_double(sax->user, number.doubleval);
+		}
+		else if (report && (number.flags & cjson_unsigned)) {
+			if (h->on_uint64) result = h->on_uint64(sax->user, u);
+			else if (h->on_double) result = h->on_double(sax->user, (double)u);
+		}
+		else if (report && h->on_integer) {
+			result = h->on_integer(sax->user, number.intval);
+		}
+	}
+	else if (isalnum(c)) {
+		char* buf = cjson_consume_ident(ctx, scratch);
+		if (!buf) {
+			return 0;
+		}
+
+		int known = 1;
+		if (stricmp(buf, "null") == 0) {
+			if (report && h->on_null) result = h->on_null(sax->user);
+		}
+		else if (stricmp(buf, "true") == 0 || stricmp(buf, "false") == 0) {
+			if (report && h->on_boolean) result = h->on_boolean(sax->user, tolower(buf[0]) == 't');
+		}
+		else {
+			known = 0;
+		}
+
+		if (buf != scratch) {
+			cjson_free(ctx->settings, buf);
+		}
+		if (!known) {
+			return 0;
+		}
+	}
+	else {
+		return 0;
+	}
+
+	return cjson_sax_result_ok(sax, result);
+}
+
+// Same grammar as cjson_parse_impl, but with a byte per open container instead of a cjson_state.
+int cjson_sax_run(cjson_sax_context* sax)
+{
+	cjson_context* ctx = &sax->ctx;
+	const cjson_sax_handler* h = sax->handler;
+	int has_root = 0;
+
+	while (1) {
+		do {
+			cjson_consume_spaces(ctx);
+		} while (cjson_consume_comments(ctx));
+
+		if (cjson_eof(ctx)) {
+			break;
+		}
+
+		char c = cjson_curc(ctx);
+
+		if (!sax->depth) {
+			if (has_root) {
+				ctx->settings->errc = cjson_error_code_syntax_multiple_root_nodes;
+				return 0;
+			}
+			has_root = 1;
+			if (!cjson_sax_value(sax, 1)) {
+				return 0;
+			}
+			continue;
+		}
+
+		unsigned char* top = &sax->stack[sax->depth - 1];
+		unsigned char type = *top & ~CJSON_SAX_AFTER_VALUE;
+
+		if (c == ',') {
+			if (!(*top & CJSON_SAX_AFTER_VALUE)) {
+				ctx->settings->errc = cjson_error_code_syntax_unexpected_comma;
+				return 0;
+			}
+			cjson_consume(ctx);
+			*top = type;
+			continue;
+		}
+
+		if ((type == in_array && c == ']') || (type == in_object && c == '}')) {
+			cjson_consume(ctx);
+			if (!cjson_sax_end(sax)) {
+				return 0;
+			}
+			continue;
+		}
+
+		int report = 1;
+		if (type == in_object) {
+			const char* key;
+			size_t len;
+			if (c != '"') {
+				ctx->settings->errc = cjson_error_code_syntax_expected_key;
+				return 0;
+			}
+			if (!cjson_consume_str_view(ctx, &key, &len)) {
+				return 0;
+			}
+
+			cjson_consume_spaces(ctx);
+			if (cjson_curc(ctx) != ':') {
+				ctx->settings->errc = cjson_error_code_syntax_expected_colon;
+				return 0;
+			}
+			cjson_consume(ctx);
+			cjson_consume_spaces(ctx);
+
+			cjson_sax_result result = h->on_key ? h->on_key(sax->user, key, len) : cjson_sax_continue;
+			if (!cjson_sax_result_ok(sax, result)) {
+				return 0;
+			}
+			report = result != cjson_sax_skip;
+		}
+
+		// Flagged before parsing the value, which may push a container of its own.
+		*top |= CJSON_SAX_AFTER_VALUE;
+		if (!cjson_sax_value(sax, report)) {
+			return 0;
+		}
+	}
+
+	if (sax->depth && !ctx->settings->permissive) {
+		ctx->settings->errc = cjson_error_code_syntax_unclosed_value;
+		return 0;
+	}
+
+	// Containers left open are closed, as if the input ended properly.
+	while (sax->depth) {
+		if (!cjson_sax_end(sax)) {
+			return 0;
+		}
+	}
+
+	return has_root;
+}
+
+int cjson_sax_parse_n_ex(cjson_settings* settings, const char* buffer, size_t len, const cjson_sax_handler* handler, void* user)
+{
+	if (!settings || !buffer || !handler) {
+		return 0;
+	}
+
+	settings->errc = cjson_error_code_ok;
+	cjson_scan_init();
+
+	cjson_pos pos = { 0 };
+	cjson_sax_context sax;
+	memset(&sax.ctx, 0, sizeof(sax.ctx));
+	sax.ctx.settings = settings;
+	sax.ctx.buf = buffer;
+	sax.ctx.len = len;
+	sax.ctx.pos = &pos;
+	sax.ctx.final = 1;
+	sax.handler = handler;
+	sax.user = user;
+	sax.stack = sax.local;
+	sax.depth = 0;
+	sax.cap = CJSON_SAX_STACK;
+
+	int ok = cjson_sax_run(&sax);
+	if (sax.stack != sax.local) {
+		cjson_free(settings, sax.stack);
+	}
+	return ok;
+}
+
+int cjson_sax_parse_ex(cjson_settings* settings, const char* buffer, const cjson_sax_handler* handler, void* user)
+{
+	return cjson_sax_parse_n_ex(settings, buffer, buffer ? strlen(buffer) : 0, handler, user);
+}
+
+int cjson_sax_parse(const char* buffer, const cjson_sax_handler* handler, void* user)
+{
+	return cjson_sax_parse_ex(cjson_global_settings(), buffer, handler, user);
+}
+
+int cjson_sax_parse_n(const char* buffer, size_t len, const cjson_sax_handler* handler, void* user)
+{
+	return cjson_sax_parse_n_ex(cjson_global_settings(), buffer, len, handler, user);
+}
+
+/*================ Parallel parsing ================*/
+
+#ifdef CJSON_THREADS
+// Chunks smaller than this are not worth a thread of their own.
+#define CJSON_PARALLEL_MIN_CHUNK (1024 * 1024)
+
+// A run of top-level array elements (without the surrounding brackets and commas), parsed on a thread of its own.
+typedef struct {
+	cjson_settings settings; // a private copy, so that the threads never write to shared state.
+	const char* buf;
+	size_t len;
+	int leading_comma; // every chunk but the first starts with a comma.
+	int last;
+	cjson_value* array; // the parsed elements, NULL when parsing failed.
+	pthread_t thread;
+	int started;
+} cjson_parallel_chunk;
+
+void cjson_consume_spaces_and_comments(cjson_context* ctx)
+{
+	do {
+		cjson_consume_spaces(ctx);
+	} while (cjson_consume_comments(ctx));
+}
+
+// Splits a top-level array into at most count chunks of about equal size, on commas between its elements. The input is
+// classified 64 bytes at a time: the quotes that are not escaped mark the bytes inside of strings, and the brackets and
+// commas outside of them give the depth. Returns the amount of chunks, or 0 when the input can not be split (i.e. it is
+// not a top-level array or contains comments). Such input is left to the serial parser, which also reports any errors.
+size_t cjson_parallel_split(cjson_settings* settings, const char* buffer, size_t len, cjson_parallel_chunk* chunks, size_t count)
+{
+	cjson_settings scratch = *settings; // errors of the pre-pass are never reported
+	cjson_pos pos = { 0 };
+	cjson_context ctx;
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.settings = &scratch;
+	ctx.buf = buffer;
+	ctx.len = len;
+	ctx.pos = &pos;
+	ctx.final = 1;
+
+	cjson_consume_spaces_and_comments(&ctx);
+	if (cjson_curc(&ctx) != '[') {
+		return 0;
+	}
+
+	size_t n = 0;
+	size_t start = pos.ofs + 1;
+	size_t target = len / count;
+	size_t depth = 1;
+	unsigned long long escaped = 0; // 1 when the next block starts with an escaped byte
+	unsigned long long in_string = 0; // all ones when the next block starts inside of a string
+	char tail[64];
+
+	for (size_t ofs = start; ofs < len; ofs += 64) {
+		const char* p = buffer + ofs;
+		if (len - ofs < 64) {
+			memset(tail, ' ', sizeof(tail));
+			memcpy(tail, p, len - ofs);
+			p = tail;
+		}
+
+		cjson_block block;
+		cjson_scan.classify(p, &block);
+		unsigned long long strings = cjson_prefix_xor(block.quote & ~cjson_block_escaped(block.backslash, &escaped)) ^ in_string;
+		in_string = 0 - (strings >> 63);
+		if (block.slash & ~strings) {
+			return 0;
+		}
+
+		unsigned long long open = block.open & ~strings;
+		unsigned long long close = block.close & ~strings;
+		unsigned long long comma = block.comma & ~strings;
+
+		// Most blocks lie deep enough inside of the elements that neither the end of the array nor a split can be in them.
+		size_t closes = __builtin_popcountll(close);
+		int may_split = comma && ofs + 64 > target && n + 1 < count;
+		if (depth > closes + (may_split ? 1 : 0)) {
+			depth += __builtin_popcountll(open) - closes;
+			continue;
+		}
+
+		unsigned long long bits = open | close | comma;
+		while (bits) {
+			int i = __builtin_ctzll(bits);
+			unsigned long long bit = bits & (0 - bits);
+			bits ^= bit;
+
+			if (open & bit) {
+				++depth;
+			}
+			else if (close & bit) {
+				if (--depth == 0) {
+					chunks[n].buf = buffer + start;
+					chunks[n].len = ofs + i - start;
+					++n;
+
+					pos.ofs = ofs + i + 1;
+					cjson_consume_spaces_and_comments(&ctx);
+					return cjson_eof(&ctx) ? n : 0;
+				}
+			}
+			else if (depth == 1 && ofs + i >= target && n + 1 < count) {
+				// Every chunk but the first starts with the comma in front of its first element.
+				chunks[n].buf = buffer + start;
+				chunks[n].len = ofs + i - start;
+				++n;
+				start = ofs + i;
+				target = start + (len - start) / (count - n);
+			}
+		}
+	}
+
+	// The array is never closed.
+	return 0;
+}
+
+// Parses a run of array elements into a new array, as if they were enclosed in brackets. When leading_comma is nonzero
+// the input starts with the comma that follows a previous element, when last is zero it must end with a complete element.
+cjson_value* cjson_parse_elements(cjson_settings* settings, const char* buffer, size_t len, int leading_comma, int last)
+{
+	cjson_value* array = cjson_create_array_ex(settings);
+	if (!array) {
+		return NULL;
+	}
+
+	cjson_pos pos = { 0 };
+	cjson_context ctx;
+	ctx.root_state = NULL;
+	ctx.tail_state = NULL;
+	ctx.free_states = NULL;
+	ctx.settings = settings;
+	ctx.doc = NULL;
+	ctx.insitu = NULL;
+	ctx.buf = buffer;
+	ctx.len = len;
+	ctx.pos = &pos;
+	ctx.final = 1;
+	ctx.need_more = 0;
+	ctx.token_start = 0;
+	ctx.single = 0;
+	ctx.projection = NULL;
+	ctx.utf8_checked = 0;
+
+	// The array is the root state, so the end of the input ends the array as well.
+	if (!cjson_push_state(&ctx, in_array, array, leading_comma ? parse_flag_after_value : parse_flag_expecting_valuetype)) {
+		cjson_free_value_ex(settings, array);
+		return NULL;
+	}
+	cjson_value* val = cjson_parse_impl(&ctx);
+	if (val && !last && !(ctx.root_state->parse_flags & parse_flag_after_value)) {
+		val = NULL;
+	}
+	cjson_free_remaining_states(&ctx, !val);
+	return val;
+}
+
+void* cjson_parallel_worker(void* arg)
+{
+	cjson_parallel_chunk* chunk = arg;
+	chunk->array = cjson_parse_elements(&chunk->settings, chunk->buf, chunk->len, chunk->leading_comma, chunk->last);
+	return NULL;
+}
+
+// Moves the elements of every chunk into the array of the first one, which is returned.
+cjson_value* cjson_parallel_join(cjson_settings* settings, cjson_parallel_chunk* chunks, size_t count)
+{
+	cjson_value* root = chunks[0].array;
+	size_t length = 0;
+	for (size_t i = 0; i < count; ++i) {
+		length += chunks[i].array->intval;
+	}
+
+	// One vector over all elements replaces those of the chunks, without it cjson_array_at walks the list.
+	cjson_vector* vector = NULL;
+	if (length >= CJSON_VECTOR_THRESHOLD) {
+		vector = cjson_vector_create(settings, NULL, cjson_vector_capacity(length));
+	}
+
+	size_t n = 0;
+	for (size_t i = 0; i < count; ++i) {
+		cjson_value* array = chunks[i].array;
+		if (vector) {
+			if (array->vector) {
+				memcpy(&vector->elements[n], array->vector->elements, array->intval * sizeof(cjson_value*));
+				n += array->intval;
+			}
+			else {
+				CJSON_ARRAY_FOR_EACH(array, e, {
+					vector->elements[n++] = e;
+				});
+			}
+		}
+
+		if (i == 0) {
+			continue;
+		}
+
+		if (array->child) {
+			if (root->child) {
+				cjson_value* tail = cjson_end(root);
+				tail->next = array->child;
+				array->child->prev = tail;
+			}
+			else {
+				root->child = array->child;
+			}
+			root->childtail = cjson_end(array);
+			root->intval += array->intval;
+		}
+
+		// Only the emptied array (and its vector) is left to free.
+		array->child = NULL;
+		array->childtail = NULL;
+		cjson_free_value_ex(settings, array);
+		chunks[i].array = NULL;
+	}
+
+	cjson_free(settings, root->vector);
+	root->vector = vector;
+	return root;
+}
+
+// Returns 0 when the input should be parsed serially instead, either because it can not be split or because
+// parsing one of the chunks failed.
+int cjson_parse_parallel_internal(cjson_settings* settings, const char* buffer, size_t len, size_t count, cjson_value** out)
+{
+	cjson_scan_init();
+
+	cjson_parallel_chunk* chunks = cjson_alloc(settings, count * sizeof(cjson_parallel_chunk));
+	if (!chunks) {
+		return 0;
+	}
+
+	count = cjson_parallel_split(settings, buffer, len, chunks, count);
+	if (count < 2) {
+		cjson_free(settings, chunks);
+		return 0;
+	}
+
+	for (size_t i = 0; i < count; ++i) {
+		chunks[i].settings = *settings;
+		chunks[i].settings.errc = cjson_error_code_ok;
+		chunks[i].leading_comma = i > 0;
+		chunks[i].last = i == count - 1;
+		chunks[i].array = NULL;
+		chunks[i].started = 0;
+	}
+
+	// The first chunk is parsed on the calling thread, chunks without a thread are parsed there as well.
+	for (size_t i = 1; i < count; ++i) {
+		chunks[i].started = pthread_create(&chunks[i].thread, NULL, &cjson_parallel_worker, &chunks[i]) == 0;
+	}
+	cjson_parallel_worker(&chunks[0]);
+	for (size_t i = 1; i < count; ++i) {
+		if (chunks[i].started) {
+			pthread_join(chunks[i].thread, NULL);
+		}
+		else {
+			cjson_parallel_worker(&chunks[i]);
+		}
+	}
+
+#ifdef CJSON_ENABLE_MEMORY_LOGGING
+	// Every chunk counted its allocations in its own copy of the settings, so the memory limit only applies per chunk.
+	size_t used_memory = settings->used_memory;
+	for (size_t i = 0; i < count; ++i) {
+		settings->used_memory += chunks[i].settings.used_memory - used_memory;
+	}
+	if (settings->used_memory > settings->highest_memory_usage) {
+		settings->highest_memory_usage = settings->used_memory;
+	}
+#endif
+
+	int ok = 1;
+	for (size_t i = 0; i < count; ++i) {
+		ok &= chunks[i].array != NULL;
+	}
+
+	if (ok) {
+		*out = cjson_parallel_join(settings, chunks, count);
+	}
+	else {
+		for (size_t i = 0; i < count; ++i) {
+			cjson_free_value_ex(settings, chunks[i].array);
+		}
+	}
+
+	cjson_free(settings, chunks);
+	return ok;
+}
+
+size_t cjson_cpu_count(void)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	return cpus > 0 ? (size_t)cpus : 1;
+}
+#endif
+
+cjson_value* cjson_parse_parallel_ex(cjson_settings* settings, const char* buffer, size_t len, int threads)
+{
+	if (!settings || !buffer) {
+		return NULL;
+	}
+
+#ifdef CJSON_THREADS
+	size_t count = threads > 0 ? (size_t)threads : cjson_cpu_count();
+	if (count > len / CJSON_PARALLEL_MIN_CHUNK) {
+		count = len / CJSON_PARALLEL_MIN_CHUNK;
+	}
+
+	cjson_value* value;
+	if (count > 1 && cjson_parse_parallel_internal(settings, buffer, len, count, &value)) {
+		settings->errc = cjson_error_code_ok;
+		return value;
+	}
+#else
+	CJSON_UNUSED(threads);
+#endif
+
+	return cjson_parse_internal(settings, NULL, buffer, len, 0);
+}
+
+cjson_value* cjson_parse_file_parallel_ex(cjson_settings* settings, const char* filename, int threads)
+{
+	TIMER_INIT();
+	TIMER_BEGIN("cjson_parse_file_parallel");
+
+#ifdef CJSON_MMAP
+	size_t map_len;
+	const char* map = cjson_map_file(filename, &map_len);
+	if (map) {
+		cjson_value* value = cjson_parse_parallel_ex(settings, map, map_len, threads);
+		TIMER_END();
+		munmap((void*)map, map_len);
+		return value;
+	}
+#endif
+
+	size_t len;
+	char* buf = cjson_read_file(settings, NULL, filename, &len);
+	if (!buf) {
+		return NULL;
+	}
+
+	cjson_value* value = cjson_parse_parallel_ex(settings, buf, len, threads);
+	TIMER_END();
+	cjson_free(settings, buf);
+	return value;
+}
+
+cjson_value* cjson_parse_parallel(const char* buffer, size_t len, int threads)
+{
+	return cjson_parse_parallel_ex(cjson_global_settings(), buffer, len, threads);
+}
+
+cjson_value* cjson_parse_file_parallel(const char* filename, int threads)
+{
+	return cjson_parse_file_parallel_ex(cjson_global_settings(), filename, threads);
+}
+
+/*================ Multiple documents ================*/
+
+struct __cjson_stream {
+	cjson_settings* settings;
+	const char* buf;
+	size_t len;
+	size_t ofs; // where the next document starts (or the whitespace in front of it)
+	char* owned; // file contents read into memory, NULL otherwise
+	int mapped; // buf is a mapping of a file
+	size_t errc; // error of the last document
+};
+
+// Parses the first value of buffer, stopping right after it. *end is set to the offset the next value starts at,
+// or to len when only whitespace and comments follow. Returns NULL on failure, or with settings->errc left at
+// cjson_error_code_ok when no value is left at all.
+cjson_value* cjson_parse_first(cjson_settings* settings, const char* buffer, size_t len, size_t* end)
+{
+	settings->errc = cjson_error_code_ok;
+	*end = len;
+	if (!len) {
+		return NULL;
+	}
+
+	cjson_pos pos = { 0 };
+	cjson_context ctx;
+	ctx.root_state = NULL;
+	ctx.tail_state = NULL;
+	ctx.free_states = NULL;
+	ctx.settings = settings;
+	ctx.doc = NULL;
+	ctx.insitu = NULL;
+	ctx.buf = buffer;
+	ctx.len = len;
+	ctx.pos = &pos;
+	ctx.final = 1;
+	ctx.need_more = 0;
+	ctx.token_start = 0;
+	ctx.single = 1;
+	ctx.projection = NULL;
+	ctx.utf8_checked = 0;
+	if (!cjson_push_state(&ctx, initial_state, NULL, 0)) {
+		return NULL;
+	}
+
+	cjson_value* val = cjson_parse_impl(&ctx);
+	*end = pos.ofs;
+	cjson_free_remaining_states(&ctx, !val);
+	return val;
+}
+
+cjson_stream* cjson_stream_create_ex(cjson_settings* settings, const char* buffer, size_t len)
+{
+	if (!settings || !buffer) {
+		return NULL;
+	}
+
+	cjson_scan_init();
+
+	cjson_stream* stream = cjson_alloc(settings, sizeof(cjson_stream));
+	if (!stream) {
+		return NULL;
+	}
+
+	stream->settings = settings;
+	stream->buf = buffer;
+	stream->len = len;
+	stream->ofs = 0;
+	stream->owned = NULL;
+	stream->mapped = 0;
+	stream->errc = cjson_error_code_ok;
+	return stream;
+}
+
+cjson_stream* cjson_stream_create_file_ex(cjson_settings* settings, const char* filename)
+{
+	if (!settings) {
+		return NULL;
+	}
+
+#ifdef CJSON_MMAP
+	size_t map_len;
+	const char* map = cjson_map_file(filename, &map_len);
+	if (map) {
+		cjson_stream* stream = cjson_stream_create_ex(settings, map, map_len);
+		if (!stream) {
+			munmap((void*)map, map_len);
+			return NULL;
+		}
+		stream->mapped = 1;
+		return stream;
+	}
+#endif
+
+	size_t len;
+	char* buf = cjson_read_file(settings, NULL, filename, &len);
+	if (!buf) {
+		return NULL;
+	}
+
+	cjson_stream* stream = cjson_stream_create_ex(settings, buf, len);
+	if (!stream) {
+		cjson_free(settings, buf);
+		return NULL;
+	}
+	stream->owned = buf;
+	return stream;
+}
+
+cjson_stream* cjson_stream_create(const char* buffer, size_t len)
+{
+	return cjson_stream_create_ex(cjson_global_settings(), buffer, len);
+}
+
+cjson_stream* cjson_stream_create_file(const char* filename)
+{
+	return cjson_stream_create_file_ex(cjson_global_settings(), filename);
+}
+
+int cjson_stream_next(cjson_stream* stream, cjson_value** out)
+{
+	*out = NULL;
+	if (!stream || stream->ofs >= stream->len) {
+		return 0;
+	}
+
+	size_t start = stream->ofs;
+	size_t end;
+	cjson_value* value = cjson_parse_first(stream->settings, stream->buf + start, stream->len - start, &end);
+	stream->errc = stream->settings->errc;
+	if (value) {
+		stream->ofs = start + end;
+	}
+	else if (stream->errc == cjson_error_code_ok) {
+		stream->ofs = stream->len;
+		return 0;
+	}
+	else {
+		// Skip the rest of the line the document starts on, so that a single bad line of NDJSON is all that is lost.
+		const char* p = cjson_scan.spaces(stream->buf + start, stream->buf + stream->len);
+		const char* nl = memchr(p, '\n', stream->buf + stream->len - p);
+		stream->ofs = nl ? (size_t)(nl + 1 - stream->buf) : stream->len;
+	}
+
+	*out = value;
+	return 1;
+}
+
+size_t cjson_stream_error(cjson_stream* stream)
+{
+	return stream ? stream->errc : cjson_error_code_ok;
+}
+
+void cjson_stream_free(cjson_stream* stream)
+{
+	if (!stream) {
+		return;
+	}
+
+#ifdef CJSON_MMAP
+	if (stream->mapped) {
+		munmap((void*)stream->buf, stream->len);
+	}
+#endif
+	cjson_free(stream->settings, stream->owned);
+	cjson_free(stream->settings, stream);
+}
+
+// Lines are handed to the workers of cjson_parse_batch this many at a time.
+#define CJSON_BATCH_CLAIM 64
+
+typedef struct {
+	const char* buf;
+	cjson_batch_entry* entries;
+	size_t count;
+	size_t next; // first entry that has not been claimed by a worker yet, advanced atomically.
+} cjson_batch_job;
+
+typedef struct {
+	cjson_batch_job* job;
+	cjson_settings settings; // a private copy, so that the workers never write to shared state.
+#ifdef CJSON_THREADS
+	pthread_t thread;
+	int started;
+#endif
+} cjson_batch_worker;
+
+void* cjson_batch_worker_run(void* arg)
+{
+	cjson_batch_worker* worker = arg;
+	cjson_batch_job* job = worker->job;
+
+	while (1) {
+		size_t first = __atomic_fetch_add(&job->next, CJSON_BATCH_CLAIM, __ATOMIC_RELAXED);
+		if (first >= job->count) {
+			break;
+		}
+
+		size_t last = job->count - first < CJSON_BATCH_CLAIM ? job->count : first + CJSON_BATCH_CLAIM;
+		for (size_t i = first; i < last; ++i) {
+			cjson_batch_entry* entry = &job->entries[i];
+			entry->value = cjson_parse_internal(&worker->settings, NULL, job->buf + entry->offset, entry->length, 0);
+			entry->errc = worker->settings.errc;
+		}
+	}
+
+	return NULL;
+}
+
+// Finds the lines of buffer that are not blank. Returns NULL (with *count set to 0) when there are none or allocating failed.
+cjson_batch_entry* cjson_batch_lines(cjson_settings* settings, const char* buffer, size_t len, size_t* count)
+{
+	const char* end = buffer + len;
+	size_t lines = 0;
+	for (const char* p = buffer; p < end; ++lines) {
+		const char* nl = memchr(p, '\n', end - p);
+		p = nl ? nl + 1 : end;
+	}
+
+	*count = 0;
+	if (!lines) {
+		return NULL;
+	}
+
+	cjson_batch_entry* entries = cjson_alloc(settings, lines * sizeof(cjson_batch_entry));
+	if (!entries) {
+		return NULL;
+	}
+
+	size_t n = 0;
+	for (const char* p = buffer; p < end;) {
+		const char* nl = memchr(p, '\n', end - p);
+		const char* line_end = nl ? nl : end;
+		if (cjson_scan.spaces(p, line_end) != line_end) {
+			entries[n].value = NULL;
+			entries[n].errc = cjson_error_code_ok;
+			entries[n].offset = p - buffer;
+			entries[n].length = line_end - p;
+			++n;
+		}
+		p = nl ? nl + 1 : end;
+	}
+
+	if (!n) {
+		cjson_free(settings, entries);
+		return NULL;
+	}
+
+	*count = n;
+	return entries;
+}
+
+cjson_batch_entry* cjson_parse_batch_ex(cjson_settings* settings, const char* buffer, size_t len, int threads, size_t* count)
+{
+	*count = 0;
+	if (!settings || !buffer) {
+		return NULL;
+	}
+
+	settings->errc = cjson_error_code_ok;
+	cjson_scan_init();
+
+	cjson_batch_job job;
+	job.buf = buffer;
+	job.next = 0;
+	job.entries = cjson_batch_lines(settings, buffer, len, &job.count);
+	if (!job.entries) {
+		return NULL;
+	}
+
+	// There is no point in starting workers that would not get a single run of lines.
+	size_t workers = 1;
+#ifdef CJSON_THREADS
+	workers = threads > 0 ? (size_t)threads : cjson_cpu_count();
+	if (workers > (job.count + CJSON_BATCH_CLAIM - 1) / CJSON_BATCH_CLAIM) {
+		workers = (job.count + CJSON_BATCH_CLAIM - 1) / CJSON_BATCH_CLAIM;
+	}
+#else
+	CJSON_UNUSED(threads);
+#endif
+
+	cjson_batch_worker* pool = cjson_alloc(settings, workers * sizeof(cjson_batch_worker));
+	if (!pool) {
+		cjson_free(settings, job.entries);
+		return NULL;
+	}
+
+	for (size_t i = 0; i < workers; ++i) {
+		pool[i].job = &job;
+		pool[i].settings = *settings;
+	}
+
+	// The calling thread works through the lines as well, and takes over completely when no thread could be started.
+#ifdef CJSON_THREADS
+	for (size_t i = 1; i < workers; ++i) {
+		pool[i].started = pthread_create(&pool[i].thread, NULL, &cjson_batch_worker_run, &pool[i]) == 0;
+	}
+#endif
+	cjson_batch_worker_run(&pool[0]);
+#ifdef CJSON_THREADS
+	for (size_t i = 1; i < workers; ++i) {
+		if (pool[i].started) {
+			pthread_join(pool[i].thread, NULL);
+		}
+	}
+#endif
+
+#ifdef CJSON_ENABLE_MEMORY_LOGGING
+	// Every worker counted its allocations in its own copy of the settings.
+	size_t used_memory = settings->used_memory;
+	for (size_t i = 0; i < workers; ++i) {
+		settings->used_memory += pool[i].settings.used_memory - used_memory;
+	}
+	if (settings->used_memory > settings->highest_memory_usage) {
+		settings->highest_memory_usage = settings->used_memory;
+	}
+#endif
+
+	cjson_free(settings, pool);
+	settings->errc = cjson_error_code_ok;
+	*count = job.count;
+	return job.entries;
+}
+
+cjson_batch_entry* cjson_parse_batch_file_ex(cjson_settings* settings, const char* filename, int threads, size_t* count)
+{
+	*count = 0;
+	if (!settings) {
+		return NULL;
+	}
+
+#ifdef CJSON_MMAP
+	size_t map_len;
+	const char* map = cjson_map_file(filename, &map_len);
+	if (map) {
+		cjson_batch_entry* batch = cjson_parse_batch_ex(settings, map, map_len, threads, count);
+		munmap((void*)map, map_len);
+		return batch;
+	}
+#endif
+
+	size_t len;
+	char* buf = cjson_read_file(settings, NULL, filename, &len);
+	if (!buf) {
+		return NULL;
+	}
+
+	cjson_batch_entry* batch = cjson_parse_batch_ex(settings, buf, len, threads, count);
+	cjson_free(settings, buf);
+	return batch;
+}
+
+cjson_batch_entry* cjson_parse_batch(const char* buffer, size_t len, int threads, size_t* count)
+{
+	return cjson_parse_batch_ex(cjson_global_settings(), buffer, len, threads, count);
+}
+
+cjson_batch_entry* cjson_parse_batch_file(const char* filename, int threads, size_t* count)
+{
+	return cjson_parse_batch_file_ex(cjson_global_settings(), filename, threads, count);
+}
+
+void cjson_free_batch_ex(cjson_settings* settings, cjson_batch_entry* batch, size_t count)
+{
+	if (!batch) {
 		return;
 	}
 
-	v->flags &= ~cjson_integer;
-	v->flags |= cjson_double;
-	v->doubleval = d;
-	v->intval = 0;
+	for (size_t i = 0; i < count; ++i) {
+		cjson_free_value_ex(settings, batch[i].value);
+	}
+	cjson_free(settings, batch);
 }
 
-void cjson_set_integer(cjson_value* v, int i)
+void cjson_free_batch(cjson_batch_entry* batch, size_t count)
 {
-	if (!cjson_is_number(v)) {
+	cjson_free_batch_ex(cjson_global_settings(), batch, count);
+}
+
+/*================ On-demand functions ================*/
+
+struct __cjson_ondemand {
+	cjson_settings* settings;
+	const char* buf;
+	size_t len;
+	unsigned int* offsets; // offset of every token, see cjson_index_structurals.
+	unsigned int* ends; // for every '[' and '{' token: the token following its matching bracket.
+	size_t count;
+	char* owned; // file contents read into memory, NULL otherwise
+	int mapped; // buf is a mapping of a file
+	int permissive; // containers left open at the end of buf were accepted
+};
+
+// Points ctx at the token of v, so that the consume functions can decode it.
+void cjson_lazy_context(cjson_lazy v, cjson_context* ctx, cjson_pos* pos)
+{
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->settings = v.doc->settings;
+	ctx->buf = v.doc->buf;
+	ctx->len = v.doc->len;
+	ctx->pos = pos;
+	ctx->final = 1;
+	ctx->utf8_checked = 1; // by cjson_index_structurals
+	ctx->utf8_invalid = (size_t)-1;
+	pos->ofs = v.doc->offsets[v.token];
+}
+
+// Validates a scalar token, which must be followed by whitespace or the next token (next is its offset).
+int cjson_ondemand_validate_scalar(cjson_context* ctx, size_t next)
+{
+	char c = cjson_curc(ctx);
+	char scratch[CJSON_SCRATCH_SIZE];
+
+	if (c == '"') {
+		const char* str;
+		size_t len;
+		if (!cjson_consume_str_view(ctx, &str, &len)) {
+			return 0;
+		}
+	}
+	else if (isdigit(c) || c == '.' || c == '-') {
+		cjson_number_value number;
+		if (!cjson_consume_number(ctx, &number)) {
+			return 0;
+		}
+	}
+	else if (isalnum(c)) {
+		char* buf = cjson_consume_ident(ctx, scratch);
+		if (!buf) {
+			return 0;
+		}
+
+		int known = stricmp(buf, "null") == 0 || stricmp(buf, "true") == 0 || stricmp(buf, "false") == 0;
+		if (buf != scratch) {
+			cjson_free(ctx->settings, buf);
+		}
+		if (!known) {
+			ctx->settings->errc = cjson_error_code_syntax_unexpected_character;
+			return 0;
+		}
+	}
+	else {
+		ctx->settings->errc = cjson_error_code_syntax_unexpected_character;
+		return 0;
+	}
+
+	size_t end = ctx->pos->ofs;
+	if (end != next && !cjson_is_space_table[(unsigned char)ctx->buf[end]]) {
+		ctx->settings->errc = cjson_error_code_syntax_unexpected_character;
+		return 0;
+	}
+
+	return 1;
+}
+
+// Walks the tokens once, checking them against the grammar of cjson_parse_impl without building anything, and links
+// every opening bracket to the token after its matching one. While a container is open its entry in ends holds the
+// token of the container around it instead, so the open containers form a stack that needs no memory of its own.
+int cjson_ondemand_validate(cjson_context* ctx, cjson_ondemand* doc)
+{
+	const unsigned int* offsets = doc->offsets;
+	size_t count = doc->count;
+	unsigned int open = UINT_MAX; // token of the innermost open container
+	int after_value = 0;
+	int has_root = 0;
+
+	for (size_t i = 0; i < count; ++i) {
+		ctx->pos->ofs = offsets[i];
+		char c = ctx->buf[offsets[i]];
+		size_t value = i;
+
+		if (open == UINT_MAX) {
+			if (has_root) {
+				ctx->settings->errc = cjson_error_code_syntax_multiple_root_nodes;
+				return 0;
+			}
+			has_root = 1;
+		}
+		else {
+			char type = ctx->buf[offsets[open]];
+			if (c == ',') {
+				if (!after_value) {
+					ctx->settings->errc = cjson_error_code_syntax_unexpected_comma;
+					return 0;
+				}
+				after_value = 0;
+				continue;
+			}
+
+			if ((type == '[' && c == ']') || (type == '{' && c == '}')) {
+				unsigned int parent = doc->ends[open];
+				doc->ends[open] = (unsigned int)(i + 1);
+				open = parent;
+				after_value = 1;
+				continue;
+			}
+
+			if (type == '{') {
+				if (c != '"') {
+					ctx->settings->errc = cjson_error_code_syntax_expected_key;
+					return 0;
+				}
+				if (!cjson_ondemand_validate_scalar(ctx, i + 1 < count ? offsets[i + 1] : ctx->len)) {
+					return 0;
+				}
+				if (i + 1 >= count || ctx->buf[offsets[i + 1]] != ':') {
+					ctx->pos->ofs = i + 1 < count ? offsets[i + 1] : ctx->len;
+					ctx->settings->errc = cjson_error_code_syntax_expected_colon;
+					return 0;
+				}
+				if (i + 2 >= count) {
+					ctx->pos->ofs = ctx->len;
+					ctx->settings->errc = cjson_error_code_syntax_unexpected_eof;
+					return 0;
+				}
+				i += 2;
+				value = i;
+				ctx->pos->ofs = offsets[i];
+				c = ctx->buf[offsets[i]];
+			}
+			after_value = 1;
+		}
+
+		if (c == '[' || c == '{') {
+			doc->ends[value] = open;
+			open = (unsigned int)value;
+			after_value = 0;
+		}
+		else if (!cjson_ondemand_validate_scalar(ctx, i + 1 < count ? offsets[i + 1] : ctx->len)) {
+			return 0;
+		}
+	}
+
+	// Just like cjson_parse, containers left open at the end of the input are only accepted when permissive.
+	if (open != UINT_MAX && !ctx->settings->permissive) {
+		ctx->pos->ofs = ctx->len;
+		ctx->settings->errc = cjson_error_code_syntax_unclosed_value;
+		return 0;
+	}
+	while (open != UINT_MAX) {
+		unsigned int parent = doc->ends[open];
+		doc->ends[open] = (unsigned int)count;
+		open = parent;
+	}
+
+	return has_root;
+}
+
+cjson_ondemand* cjson_parse_ondemand_ex(cjson_settings* settings, const char* buffer, size_t len)
+{
+	if (!settings || !buffer) {
+		return NULL;
+	}
+
+	settings->errc = cjson_error_code_ok;
+	if (!len || len > UINT_MAX) {
+		return NULL;
+	}
+
+	cjson_scan_init();
+
+	cjson_ondemand* doc = cjson_alloc(settings, sizeof(cjson_ondemand));
+	if (!doc) {
+		return NULL;
+	}
+
+	doc->settings = settings;
+	doc->buf = buffer;
+	doc->len = len;
+	doc->offsets = NULL;
+	doc->ends = NULL;
+	doc->count = 0;
+	doc->owned = NULL;
+	doc->mapped = 0;
+	doc->permissive = settings->permissive;
+
+	cjson_pos pos = { 0 };
+	cjson_context ctx;
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.settings = settings;
+	ctx.buf = buffer;
+	ctx.len = len;
+	ctx.pos = &pos;
+	ctx.final = 1;
+
+	cjson_structural_index index;
+	int ok = cjson_index_structurals(&ctx, &index);
+	doc->offsets = index.offsets;
+	doc->count = index.count;
+	if (ok && index.comments) {
+		// Comments are not indexed, so input containing them can not be accessed on demand.
+		settings->errc = cjson_error_code_syntax_unexpected_character;
+		ok = 0;
+	}
+	if (ok && index.utf8_invalid != (size_t)-1) {
+		pos.ofs = index.utf8_invalid;
+		settings->errc = cjson_error_code_syntax_invalid_utf8;
+		ok = 0;
+	}
+	ctx.utf8_checked = 1;
+	ctx.utf8_invalid = (size_t)-1;
+	if (ok) {
+		doc->ends = cjson_alloc(settings, (doc->count ? doc->count : 1) * sizeof(unsigned int));
+		ok = doc->ends && cjson_ondemand_validate(&ctx, doc);
+	}
+
+	if (!ok) {
+		cjson_free_ondemand(doc);
+		return NULL;
+	}
+
+	return doc;
+}
+
+cjson_ondemand* cjson_parse_ondemand_file_ex(cjson_settings* settings, const char* filename)
+{
+	if (!settings) {
+		return NULL;
+	}
+
+#ifdef CJSON_MMAP
+	size_t map_len;
+	const char* map = cjson_map_file(filename, &map_len);
+	if (map) {
+		// Accessing values jumps around the file, undo the sequential hint of cjson_map_file.
+		madvise((void*)map, map_len, MADV_NORMAL);
+		cjson_ondemand* doc = cjson_parse_ondemand_ex(settings, map, map_len);
+		if (!doc) {
+			munmap((void*)map, map_len);
+			return NULL;
+		}
+		doc->mapped = 1;
+		return doc;
+	}
+#endif
+
+	size_t len;
+	char* buf = cjson_read_file(settings, NULL, filename, &len);
+	if (!buf) {
+		return NULL;
+	}
+
+	cjson_ondemand* doc = cjson_parse_ondemand_ex(settings, buf, len);
+	if (!doc) {
+		cjson_free(settings, buf);
+		return NULL;
+	}
+	doc->owned = buf;
+	return doc;
+}
+
+cjson_ondemand* cjson_parse_ondemand(const char* buffer, size_t len)
+{
+	return cjson_parse_ondemand_ex(cjson_global_settings(), buffer, len);
+}
+
+cjson_ondemand* cjson_parse_ondemand_file(const char* filename)
+{
+	return cjson_parse_ondemand_file_ex(cjson_global_settings(), filename);
+}
+
+void cjson_free_ondemand(cjson_ondemand* doc)
+{
+	if (!doc) {
 		return;
 	}
 
-	v->flags &= ~cjson_double;
-	v->flags |= cjson_integer;
-	v->intval = i;
-	v->doubleval = 0;
+#ifdef CJSON_MMAP
+	if (doc->mapped) {
+		munmap((void*)doc->buf, doc->len);
+	}
+#endif
+	cjson_free(doc->settings, doc->owned);
+	cjson_free(doc->settings, doc->offsets);
+	cjson_free(doc->settings, doc->ends);
+	cjson_free(doc->settings, doc);
+}
+
+cjson_lazy cjson_ondemand_root(cjson_ondemand* doc)
+{
+	cjson_lazy v = { doc, 0 };
+	return v;
+}
+
+// Returns the first byte of v, or 0 when v is not valid.
+char cjson_lazy_byte(cjson_lazy v)
+{
+	return v.doc ? v.doc->buf[v.doc->offsets[v.token]] : 0;
+}
+
+cjson_lazy cjson_lazy_invalid(void)
+{
+	cjson_lazy v = { NULL, 0 };
+	return v;
+}
+
+// Decodes the number v, returns 0 when v is not a number.
+int cjson_lazy_number(cjson_lazy v, cjson_number_value* number)
+{
+	char c = cjson_lazy_byte(v);
+	if (!isdigit(c) && c != '.' && c != '-') {
+		return 0;
+	}
+
+	cjson_pos pos;
+	cjson_context ctx;
+	cjson_lazy_context(v, &ctx, &pos);
+	return cjson_consume_number(&ctx, number);
+}
+
+int cjson_lazy_valid(cjson_lazy v) { return v.doc != NULL; }
+int cjson_lazy_is_string(cjson_lazy v) { return cjson_lazy_byte(v) == '"'; }
+int cjson_lazy_is_object(cjson_lazy v) { return cjson_lazy_byte(v) == '{'; }
+int cjson_lazy_is_array(cjson_lazy v) { return cjson_lazy_byte(v) == '['; }
+int cjson_lazy_is_boolean(cjson_lazy v) { char c = tolower(cjson_lazy_byte(v)); return c == 't' || c == 'f'; }
+int cjson_lazy_is_null(cjson_lazy v) { return tolower(cjson_lazy_byte(v)) == 'n'; }
+int cjson_lazy_true(cjson_lazy v) { return tolower(cjson_lazy_byte(v)) == 't'; }
+int cjson_lazy_false(cjson_lazy v) { return tolower(cjson_lazy_byte(v)) == 'f'; }
+
+int cjson_lazy_is_number(cjson_lazy v)
+{
+	char c = cjson_lazy_byte(v);
+	return isdigit(c) || c == '.' || c == '-';
+}
+
+int cjson_lazy_is_double(cjson_lazy v)
+{
+	cjson_number_value number;
+	return cjson_lazy_number(v, &number) && (number.flags & cjson_double);
+}
+
+int cjson_lazy_is_integer(cjson_lazy v)
+{
+	cjson_number_value number;
+	return cjson_lazy_number(v, &number) && (number.flags & cjson_integer);
+}
+
+const char* cjson_lazy_get_string(cjson_lazy v, size_t* len)
+{
+	if (!cjson_lazy_is_string(v)) {
+		return NULL;
+	}
+
+	const char* str;
+	cjson_pos pos;
+	cjson_context ctx;
+	cjson_lazy_context(v, &ctx, &pos);
+	return cjson_consume_str_view(&ctx, &str, len) ? str : NULL;
+}
+
+double cjson_lazy_get_double(cjson_lazy v)
+{
+	cjson_number_value number;
+	if (!cjson_lazy_number(v, &number)) {
+		return 0;
+	}
+
+	if (number.flags & cjson_double) {
+		return number.doubleval;
+	}
+	return number.flags & cjson_unsigned ? (double)(unsigned long long)number.intval : (double)number.intval;
+}
+
+long long cjson_lazy_get_int64(cjson_lazy v)
+{
+	cjson_number_value number;
+	return cjson_lazy_number(v, &number) && (number.flags & cjson_integer) ? number.intval : 0;
 }
 
+unsigned long long cjson_lazy_get_uint64(cjson_lazy v) { return (unsigned long long)cjson_lazy_get_int64(v); }
+int cjson_lazy_get_integer(cjson_lazy v) { return (int)cjson_lazy_get_int64(v); }
 
-int cjson_replaceidx(cjson_value* p, int idx, cjson_value* replacement, cjson_value** old_value)
+// Returns the token following v and all of its children.
+size_t cjson_lazy_skip(cjson_lazy v)
 {
-		int j = 0;
-		cjson_value* c = p->child;
-		while (c != NULL) {
-			if (j == idx) {
-				// replace
-				if (c->prev) c->prev->next = replacement;
-				if (c->next) c->next->prev = replacement;
-				if (c == p->child) p->child = replacement;
-
-				replacement->next = c->next;
-				replacement->prev = c->prev;
-				c->next = NULL;
-				c->prev = NULL;
-
-				if (old_value) {
-					*old_value = replacement;
-				}
-				else {
-					cjson_free_value(c);
-				}
+	char c = cjson_lazy_byte(v);
+	return c == '[' || c == '{' ? v.doc->ends[v.token] : v.token + 1;
+}
 
-				return 1;
-			}	
+// Returns the element or member value starting at token t of a container, or an invalid value at its end.
+cjson_lazy cjson_lazy_member(cjson_ondemand* doc, size_t t, int object)
+{
+	if (t >= doc->count) {
+		return cjson_lazy_invalid();
+	}
 
-			++j;
-			c = c->next;
-		}
+	char c = doc->buf[doc->offsets[t]];
+	if (c == ']' || c == '}') {
+		return cjson_lazy_invalid();
+	}
 
-		return 0;
+	cjson_lazy v = { doc, object ? t + 2 : t };
+	return v;
 }
-int cjson_eraseidx(cjson_value* p, int idx)
+
+cjson_lazy cjson_lazy_first(cjson_lazy v)
 {
-	int j = 0;
-	cjson_value* c = p->child;
-	while (p != NULL) { 
-		if (j == idx) {
-			if (c->prev) c->prev->next = c->next;
-			if (c->next) c->next->prev = c->prev;
-			if (c == p->child) p->child = NULL;
-			if (p->child == NULL && c->next) p->child = c->next;
-			c->next = NULL;
-			c->prev = NULL;
-			
-			cjson_free_value(c);
-			--p->intval;
-			return 1;
-		}
-		
-		j++;
-		c = c->next;
-	}	
-	return 0;
+	char c = cjson_lazy_byte(v);
+	if (c != '[' && c != '{') {
+		return cjson_lazy_invalid();
+	}
+
+	return cjson_lazy_member(v.doc, v.token + 1, c == '{');
 }
 
-void cjson_append(cjson_value* p, cjson_value *c)
+cjson_lazy cjson_lazy_next(cjson_lazy v)
 {
-	++p->intval;
-	if (!p->child) {
-		p->child = c;
+	if (!v.doc || !v.token) {
+		return cjson_lazy_invalid();
 	}
-	else {
-		cjson_value* insertion_point = cjson_end(p);
-		insertion_point->next = c;
-		c->prev = insertion_point;		 
+
+	// Values of object members follow the colon after their key.
+	cjson_ondemand* doc = v.doc;
+	int object = doc->buf[doc->offsets[v.token - 1]] == ':';
+	size_t t = cjson_lazy_skip(v);
+	if (t < doc->count && doc->buf[doc->offsets[t]] == ',') {
+		++t;
 	}
+
+	return cjson_lazy_member(doc, t, object);
 }
 
-int cjson_object_size(cjson_value* p)
+const char* cjson_lazy_key(cjson_lazy v, size_t* len)
 {
-	if (cjson_is_object(p)) {
-		return p->intval;
+	if (!v.doc || v.token < 2 || v.doc->buf[v.doc->offsets[v.token - 1]] != ':') {
+		return NULL;
 	}
 
-	return 0;
+	cjson_lazy key = { v.doc, v.token - 2 };
+	return cjson_lazy_get_string(key, len);
 }
 
-int cjson_empty(cjson_value* p)
+int cjson_lazy_length(cjson_lazy v)
 {
-	if (p == NULL) return -1; // Maybe this should be true?
-
-	if (cjson_is_string(p)) {
-		return p->string == NULL || strlen(p->string) == 0;
+	int length = 0;
+	for (cjson_lazy c = cjson_lazy_first(v); cjson_lazy_valid(c); c = cjson_lazy_next(c)) {
+		++length;
 	}
+	return length;
+}
 
-	if (cjson_is_array(p) || cjson_is_object(p)) {
-		return p->intval == 0;
+int cjson_lazy_array_length(cjson_lazy v) { return cjson_lazy_is_array(v) ? cjson_lazy_length(v) : 0; }
+int cjson_lazy_object_size(cjson_lazy v) { return cjson_lazy_is_object(v) ? cjson_lazy_length(v) : 0; }
+
+cjson_lazy cjson_lazy_array_at(cjson_lazy v, int i)
+{
+	if (!cjson_lazy_is_array(v) || i < 0) {
+		return cjson_lazy_invalid();
 	}
 
-	return -1; // not applicable
+	cjson_lazy c = cjson_lazy_first(v);
+	while (i-- > 0 && cjson_lazy_valid(c)) {
+		c = cjson_lazy_next(c);
+	}
+	return c;
 }
 
-cjson_value* cjson_search_kv(cjson_value* p, const char* k)
+cjson_lazy cjson_lazy_search_item(cjson_lazy p, const char* k)
 {
-	cjson_value* c = p->child;
-	while (c != NULL) {
-		if (strcmp(c->string, k) == 0) {
-			return c; // Return the KV
-		}
+	if (!cjson_lazy_is_object(p)) {
+		return cjson_lazy_invalid();
+	}
 
-		c = c->next;
+	size_t len = strlen(k);
+	for (cjson_lazy v = cjson_lazy_first(p); cjson_lazy_valid(v); v = cjson_lazy_next(v)) {
+		size_t key_len;
+		const char* key = cjson_lazy_key(v, &key_len);
+		if (key && key_len == len && memcmp(key, k, len) == 0) {
+			return v;
+		}
 	}
-	return NULL;
+	return cjson_lazy_invalid();
 }
 
-cjson_value* cjson_searchi_kv(cjson_value* p, const char* k)
+cjson_lazy cjson_lazy_searchi_item(cjson_lazy p, const char* k)
 {
-	cjson_value* c = p->child;
-	while (c != NULL) {
-		if (stricmp(c->string, k) == 0) {
-			return c; // Return the KV
+	if (!cjson_lazy_is_object(p)) {
+		return cjson_lazy_invalid();
+	}
+
+	size_t len = strlen(k);
+	for (cjson_lazy v = cjson_lazy_first(p); cjson_lazy_valid(v); v = cjson_lazy_next(v)) {
+		size_t key_len;
+		const char* key = cjson_lazy_key(v, &key_len);
+		if (!key || key_len != len) {
+			continue;
 		}
 
-		c = c->next;
+		size_t i = 0;
+		while (i < len && tolower((unsigned char)key[i]) == tolower((unsigned char)k[i])) {
+			++i;
+		}
+		if (i == len) {
+			return v;
+		}
 	}
-	return NULL;
+	return cjson_lazy_invalid();
 }
 
-int cjson_erase_kv_from_tree(cjson_value* p, cjson_value* kv)
+cjson_value* cjson_lazy_to_value_ex(cjson_settings* settings, cjson_lazy v)
 {
-	if (!kv) return 0;
-
-	// remove item from tree
-	if (kv->prev) kv->prev->next = kv->next;
-	if (kv->next) kv->next->prev = kv->prev;
-	if (p->child == kv) p->child = NULL;
-	if (p->child == NULL && kv->next) p->child = kv->next;
+	if (!v.doc) {
+		return NULL;
+	}
 
-	kv->next = NULL;
-	kv->prev = NULL;
-	cjson_free_value(kv);
-	--p->intval;
-	return 1;
+	// The value may run into the end of the input, which has to be closed the same way it was when validating it.
+	// The flag is set on settings itself (not on a copy) so that memory logging keeps counting into it.
+	int permissive = settings->permissive;
+	settings->permissive |= v.doc->permissive;
+	size_t ofs = v.doc->offsets[v.token];
+	size_t end;
+	cjson_value* value = cjson_parse_first(settings, v.doc->buf + ofs, v.doc->len - ofs, &end);
+	settings->permissive = permissive;
+	return value;
 }
 
-int cjson_erase(cjson_value* p, const char* k)
+cjson_value* cjson_lazy_to_value(cjson_lazy v)
 {
-	return cjson_erase_kv_from_tree(p, cjson_search_kv(p, k));
+	return cjson_lazy_to_value_ex(cjson_global_settings(), v);
 }
 
-int cjson_erasei(cjson_value* p, const char* k)
-{
-	return cjson_erase_kv_from_tree(p, cjson_searchi_kv(p, k));
-}
+/*================ Path functions ================*/
 
-int cjson_replace(cjson_value* p, const char* k, cjson_value* replacement, cjson_value** old_value)
+// Matches are collected here while evaluating a path.
+typedef struct {
+	cjson_value** out;
+	size_t max;
+	size_t found;
+	int first; // stop after the first match (cjson_path_get)
+} cjson_path_matches;
+
+// Parses a (possibly negative) decimal integer spanning [p, end). Returns 0 when it is not one.
+int cjson_path_integer(const char* p, const char* end, long long* out)
 {
-	cjson_value* kv = cjson_search_kv(p, k);
-	if (!kv) return 0;
+	int neg = 0;
+	if (p < end && *p == '-') {
+		neg = 1;
+		++p;
+	}
+	if (p == end) {
+		return 0;
+	}
 
-	if (old_value != NULL) {
-		*old_value = kv->child;
+	unsigned long long v = 0;
+	for (; p < end; ++p) {
+		if ((unsigned)(*p - '0') >= 10 || v > LLONG_MAX / 10) {
+			return 0;
+		}
+		v = v * 10 + (unsigned)(*p - '0');
 	}
-	else {
-		cjson_free_value(kv->child);
+	if (v > LLONG_MAX) {
+		return 0;
 	}
 
-	// Set the replacement
-	kv->child = replacement;
+	*out = neg ? -(long long)v : (long long)v;
 	return 1;
 }
 
-void cjson_insert(cjson_value* p, const char* k, cjson_value* v)
+// Parses the bracketed part of a step ("4", "-1", "*", "1:3", ":2"), without the brackets.
+int cjson_path_bracket(const char* p, const char* end, cjson_path_step* step)
 {
-	++p->intval;
-
-	cjson_value *c = cjson_value_create(global_settings);
-
-	if (!c) {
-		return; // Error maybe?
+	if (end - p == 1 && *p == '*') {
+		step->type = cjson_path_wildcard;
+		return 1;
 	}
-	
-	c->flags = cjson_kv;
-	
-	size_t len = strlen(k);
-	c->string = cjson_alloc(global_settings, len + 1);
 
-	if (!c->string) {
-		cjson_free_value(c);
-		return;
+	const char* colon = memchr(p, ':', end - p);
+	if (!colon) {
+		step->type = cjson_path_index;
+		return cjson_path_integer(p, end, &step->index);
 	}
 
-	strcpy(c->string, k);
-	c->child = v;
+	step->type = cjson_path_slice;
+	step->has_start = colon != p;
+	step->has_end = colon + 1 != end;
+	return (!step->has_start || cjson_path_integer(p, colon, &step->start))
+		&& (!step->has_end || cjson_path_integer(colon + 1, end, &step->end));
+}
 
-	if (!p->child) {
-		p->child = c;
+// Copies the key of a step to dst, resolving escapes: "~0" and "~1" for JSON Pointers, a backslash before any
+// character otherwise. Returns the length of the key or -1 when an escape is invalid.
+long long cjson_path_unescape(const char* p, const char* end, int pointer, char* dst)
+{
+	char* start = dst;
+	for (; p < end; ++p) {
+		if (pointer && *p == '~') {
+			if (++p == end || (*p != '0' && *p != '1')) {
+				return -1;
+			}
+			*dst++ = *p == '0' ? '~' : '/';
+		}
+		else if (!pointer && *p == '\\') {
+			if (++p == end) {
+				return -1;
+			}
+			*dst++ = *p;
+		}
+		else {
+			*dst++ = *p;
+		}
 	}
-	else {
-		cjson_value* insertion_point = cjson_end(p);
-		insertion_point->next = c;
-		c->prev = insertion_point;
+	*dst = 0;
+	return dst - start;
+}
+
+// Returns the end of the step starting at p, steps are separated by '/' in JSON Pointers and by '>' otherwise.
+const char* cjson_path_step_end(const char* p, int pointer)
+{
+	for (; *p; ++p) {
+		if (pointer ? *p == '/' : *p == '>') {
+			break;
+		}
+		if (!pointer && *p == '\\' && p[1]) {
+			++p;
+		}
 	}
+	return p;
 }
 
-cjson_value* cjson_search_item(cjson_value* p, const char* k)
+cjson_path* cjson_path_compile_ex(cjson_settings* settings, const char* path)
 {
-	cjson_value* kv = cjson_search_kv(p, k);
-	if (!kv) return NULL;
-	return kv->child;
+	if (!settings || !path) {
+		return NULL;
+	}
+
+	settings->errc = cjson_error_code_ok;
+
+	// "" and everything starting with '/' is a JSON Pointer, in which every step follows a '/'.
+	int pointer = *path == 0 || *path == '/';
+	const char* p = pointer && *path ? path + 1 : path;
+	size_t count = 0;
+	if (!pointer || *path) {
+		for (const char* q = p;; ++count) {
+			q = cjson_path_step_end(q, pointer);
+			if (!*q++) {
+				++count;
+				break;
+			}
+		}
+	}
+
+	// Steps and their keys share a single allocation, keys are never longer than the path itself.
+	size_t size = sizeof(cjson_path) + count * sizeof(cjson_path_step) + strlen(path) + count + 1;
+	cjson_path* compiled = cjson_alloc(settings, size);
+	if (!compiled) {
+		return NULL;
+	}
+
+	compiled->settings = settings;
+	compiled->count = count;
+	char* keys = (char*)&compiled->steps[count];
+
+	for (size_t i = 0; i < count; ++i) {
+		const char* end = cjson_path_step_end(p, pointer);
+		cjson_path_step* step = &compiled->steps[i];
+		memset(step, 0, sizeof(*step));
+		step->index = -1;
+
+		int ok = 1;
+		if (!pointer && *p == '[') {
+			ok = end - p >= 2 && end[-1] == ']' && cjson_path_bracket(p + 1, end - 1, step);
+		}
+		else if (!pointer && end - p == 1 && *p == '*') {
+			step->type = cjson_path_wildcard;
+		}
+		else {
+			long long len = cjson_path_unescape(p, end, pointer, keys);
+			ok = len >= 0;
+			if (ok) {
+				step->type = cjson_path_key;
+				step->key = keys;
+				cjson_hash_key(keys, &step->hash, &step->ihash);
+				keys += len + 1;
+
+				// JSON Pointer steps select array elements as well, when they are written without leading zeros.
+				if (pointer && len > 0 && (len == 1 || *step->key != '0') && cjson_path_integer(step->key, step->key + len, &step->index) && step->index < 0) {
+					step->index = -1;
+				}
+			}
+		}
+
+		if (!ok) {
+			settings->errc = cjson_error_code_invalid_path;
+			cjson_free(settings, compiled);
+			return NULL;
+		}
+		p = *end ? end + 1 : end;
+	}
+
+	return compiled;
 }
 
-cjson_value* cjson_searchi_item(cjson_value* p, const char* k)
+cjson_path* cjson_path_compile(const char* path)
 {
-	cjson_value* kv = cjson_searchi_kv(p, k);
-	if (!kv) return NULL;
-	return kv->child;
+	return cjson_path_compile_ex(cjson_global_settings(), path);
 }
 
-const char* cjson_type_string(cjson_value* v)
+void cjson_path_free(cjson_path* path)
 {
-	if ((v->flags & cjson_kv) == cjson_kv) return "cjson_kv";
-	if ((v->flags & cjson_string) == cjson_string) return "cjson_string";
-	if ((v->flags & cjson_number) == cjson_number) {
-		if ((v->flags & cjson_integer) == cjson_integer) return "cjson_number (int)";
-		if ((v->flags & cjson_double) == cjson_double) return "cjson_number (double)";
-		return "cjson_number (unk)";
+	if (path) {
+		cjson_free(path->settings, path);
 	}
-	if ((v->flags & cjson_object) == cjson_object) return "cjson_object";
-	if ((v->flags & cjson_boolean) == cjson_boolean) return "cjson_boolean";
-	if ((v->flags & cjson_null) == cjson_null) return "cjson_null";
-
-	return "invalid";
 }
 
-int cjson_stringify_internal(char* out_buf, size_t buffer_count, cjson_value* v)
+// Returns 1 once no more matches are wanted.
+int cjson_path_match(const cjson_path* path, size_t i, cjson_value* v, cjson_path_matches* matches)
 {
-	if (v->flags & cjson_string) 
-	{
-		return snprintf(out_buf, buffer_count, "\"%s\"", v->string);
+	if (!v) {
+		return 0;
 	}
-	if (v->flags & cjson_number)
-	{
-		if (v->flags & cjson_integer) {
-			return snprintf(out_buf, buffer_count, "%d", v->intval);
-		}
-		return snprintf(out_buf, buffer_count, "%g", v->doubleval);
-	} 
-	if (v->flags & cjson_object)
-	{
-		size_t len = 0;
-		if (out_buf) {
-			*out_buf = '{';
+
+	if (i == path->count) {
+		if (matches->found < matches->max) {
+			matches->out[matches->found] = v;
 		}
-		++len;
+		++matches->found;
+		return matches->first;
+	}
 
-		cjson_value* c = v->child;
-		while (c != NULL) {
-			if (out_buf) {
-				len += snprintf(&out_buf[len], buffer_count, "\"%s\":", c->string); // key
-				len += cjson_stringify_internal(&out_buf[len], buffer_count, c->child); // value
+	const cjson_path_step* step = &path->steps[i];
+	int array = (v->flags & cjson_array) != 0;
+	int object = (v->flags & cjson_object) != 0;
+
+	switch (step->type) {
+		case cjson_path_key:
+		{
+			if (array) {
+				return step->index >= 0 && step->index < v->intval && cjson_path_match(path, i + 1, cjson_array_at(v, (int)step->index), matches);
 			}
-			else {
-				len += snprintf(NULL, 0, "\"%s\":", c->string);
-				len += cjson_stringify_internal(NULL, 0, c->child);
+			if (!object) {
+				return 0;
 			}
 
-			if (c->next) {
-				if (out_buf) out_buf[len] = ',';
-				len += 1;
+			// The key was hashed when compiling, so indexed objects are searched without hashing it again.
+			cjson_value* kv = NULL;
+			if (v->index) {
+				kv = cjson_index_find_hashed(v->index, step->key, step->hash, step->ihash, 0);
 			}
-
-			c = c->next;
+			else {
+				for (kv = v->child; kv != NULL && strcmp(kv->string, step->key) != 0; kv = kv->next) {
+				}
+			}
+			return kv && cjson_path_match(path, i + 1, kv->child, matches);
 		}
-		if (out_buf) out_buf[len] = '}';
-		return ++len;
-	}
-	if (v->flags & cjson_array)
-	{
-		size_t len = 0;
-		if (out_buf) {
-			*out_buf = '[';
+		case cjson_path_index:
+		{
+			long long index = step->index < 0 ? v->intval + step->index : step->index;
+			return array && index >= 0 && index < v->intval && cjson_path_match(path, i + 1, cjson_array_at(v, (int)index), matches);
 		}
-		++len;
-
-		cjson_value* c = v->child;
-		while (c != NULL) {
-			if (out_buf) {
-				len += cjson_stringify_internal(&out_buf[len], buffer_count, c);
+		case cjson_path_wildcard:
+		{
+			if (!array && !object) {
+				return 0;
 			}
-			else {
-				len += cjson_stringify_internal(NULL, 0, c);
+			for (cjson_value* c = v->child; c != NULL; c = c->next) {
+				if (cjson_path_match(path, i + 1, object ? c->child : c, matches)) {
+					return 1;
+				}
 			}
-
-			if (c->next) {
-				if (out_buf) out_buf[len] = ',';
-				len += 1;
+			return 0;
+		}
+		case cjson_path_slice:
+		{
+			if (!array) {
+				return 0;
 			}
 
-			c = c->next;
-		}
+			long long start = !step->has_start ? 0 : step->start < 0 ? v->intval + step->start : step->start;
+			long long end = !step->has_end ? v->intval : step->end < 0 ? v->intval + step->end : step->end;
+			start = start < 0 ? 0 : start;
+			end = end > v->intval ? v->intval : end;
 
-		if (out_buf) out_buf[len] = ']';
-		return ++len;
+			cjson_value* c = start < end ? cjson_array_at(v, (int)start) : NULL;
+			for (long long j = start; j < end && c != NULL; ++j, c = c->next) {
+				if (cjson_path_match(path, i + 1, c, matches)) {
+					return 1;
+				}
+			}
+			return 0;
+		}
 	}
-	if (v->flags & cjson_boolean)
-	{
-		const char* true_constant = "true";
-		const char* false_constant = "false";
-		size_t out_len = v->intval ? strlen(true_constant) : strlen(false_constant);
 
-		if (out_buf) {
-			memcpy(out_buf, v->intval ? true_constant : false_constant, out_len);
-		}
+	return 0;
+}
 
-		return out_len;
-	} 
-	if (v->flags & cjson_null)
-	{
-		const char* null_constant = "null";
-		size_t len = strlen(null_constant);
+cjson_value* cjson_path_get(cjson_path* path, cjson_value* root)
+{
+	if (!path) {
+		return NULL;
+	}
 
-		if (out_buf) {
-			memcpy(out_buf, null_constant, len);
-		}
+	cjson_value* match = NULL;
+	cjson_path_matches matches = { &match, 1, 0, 1 };
+	cjson_path_match(path, 0, root, &matches);
+	return match;
+}
 
-		return len;
+size_t cjson_path_select(cjson_path* path, cjson_value* root, cjson_value** out, size_t max)
+{
+	if (!path) {
+		return 0;
 	}
 
-	return 0;
+	cjson_path_matches matches = { out, out ? max : 0, 0, 0 };
+	cjson_path_match(path, 0, root, &matches);
+	return matches.found;
 }
 
-char* cjson_stringify(cjson_value *v)
-{ 
-	int len = cjson_stringify_internal(NULL, 0, v);
+cjson_value* cjson_search_path(cjson_value* root, const char* path)
+{
+	cjson_path* compiled = cjson_path_compile(path);
+	cjson_value* match = cjson_path_get(compiled, root);
+	cjson_path_free(compiled);
+	return match;
+}
 
-	if (!len) {
+cjson_value* cjson_parse_projected_ex(cjson_settings* settings, const char* buffer, size_t len, cjson_path** paths, size_t count)
+{
+	if (!settings || !buffer || (count && !paths)) {
 		return NULL;
 	}
 
-	char* buf = malloc(len + 1);
-	if (!buf) {
+	// Paths are matched while the input streams by, so there is no end to count back from.
+	settings->errc = cjson_error_code_ok;
+	if (count > 64) {
+		settings->errc = cjson_error_code_invalid_path;
 		return NULL;
 	}
+	for (size_t i = 0; i < count; ++i) {
+		if (!paths[i]) {
+			settings->errc = cjson_error_code_invalid_path;
+			return NULL;
+		}
+		for (size_t j = 0; j < paths[i]->count; ++j) {
+			const cjson_path_step* step = &paths[i]->steps[j];
+			if ((step->type == cjson_path_index && step->index < 0) || (step->type == cjson_path_slice && (step->start < 0 || step->end < 0))) {
+				settings->errc = cjson_error_code_invalid_path;
+				return NULL;
+			}
+		}
+	}
 
-	cjson_stringify_internal(buf, len + 1, v);
-	buf[len] = 0;
-	return buf;
+	cjson_projection projection = { paths, count };
+	return cjson_parse_projection(settings, NULL, buffer, len, 0, &projection);
+}
+
+cjson_value* cjson_parse_projected(const char* buffer, size_t len, cjson_path** paths, size_t count)
+{
+	return cjson_parse_projected_ex(cjson_global_settings(), buffer, len, paths, count);
 }
@@ -1,11 +1,16 @@
 #ifndef CJSON_H
 #define CJSON_H
 #include <stdlib.h>
+#include <stdio.h>
 
 typedef enum {
     cjson_error_code_ok = 0,
     cjson_error_code_oom = 1000, // used_memory > highest_memory_usage
     cjson_error_code_alloc, // internal alloc returned NULL
+    cjson_error_code_aborted, // a cjson_sax_handler callback returned cjson_sax_abort
+    cjson_error_code_invalid_path, // cjson_path_compile could not parse the path
+    cjson_error_code_invalid_tape, // cjson_tape_load was given something that is not a (valid) tape
+    cjson_error_code_invalid_binary, // MessagePack or CBOR input is malformed, or holds something JSON can not
 
     // syntax
     cjson_error_code_syntax_unexpected_eof = 2000,
@@ -15,15 +20,13 @@ typedef enum {
     cjson_error_code_syntax_expected_key,
     cjson_error_code_syntax_expected_colon,
 	cjson_error_code_syntax_unclosed_value,
+	cjson_error_code_syntax_invalid_utf8,
+	cjson_error_code_syntax_unexpected_character,
 } cjson_error_code_type;
 
 typedef struct cjson_settings {
     void* (*mem_alloc)(size_t);
     void (*mem_free)(void*);
-#ifdef CJSON_ENABLE_MULTITHREAD_SUPPORT
-    void* mtx;
-    int multithreaded;
-#endif
 #ifdef CJSON_ENABLE_MEMORY_LOGGING
     size_t memory_limit;
     size_t used_memory;
@@ -34,6 +37,10 @@ typedef struct cjson_settings {
 	// allows for permissive parsing, i.e. closing '[1, 2, {"key": "value"' will parse just fine,
 	// and act as if both the array and object were properly closed.
 	int permissive; // default = 0 (meaning errors will be raised).
+
+	// parses in two stages: the structural characters of the whole input are first indexed with SIMD (validating UTF-8
+	// along the way), then the tree is built from the index. Input with comments is still parsed in a single pass.
+	int structural_index; // default = 0 (meaning the input is tokenized while the tree is built).
 } cjson_settings;
 
 typedef enum {
@@ -46,13 +53,15 @@ typedef enum {
     cjson_boolean = 1 << 6, // boolean
     cjson_null = 1 << 7, // null
 	cjson_integer = 1 << 8, // integer (& number)
-	cjson_double = 1 << 9 // double (& number)
+	cjson_double = 1 << 9, // double (& number)
+	cjson_pooled = 1 << 10, // internal only, the value lives inside of a cjson_document arena.
+	cjson_borrowed = 1 << 11, // internal only, the string is not owned by the value (it points into an in-situ parsed buffer).
+	cjson_unsigned = 1 << 12, // integer (& number) above LLONG_MAX, intval holds the bits of an unsigned long long.
+	cjson_interned = 1 << 13 // internal only, the key of the key-value is shared by the whole document (see cjson_document_key).
 } cjson_type_flags;
 
 // Internal struct used in parsing
 typedef struct {
-    size_t row; // row, 0-based
-    size_t col; // column, 0-based
     size_t ofs; // index into buffer
 } cjson_pos;
 
@@ -64,13 +73,93 @@ typedef struct __cjson_value {
     struct __cjson_value* childtail; // cached value, used in parsing stage to make appending children faster..
     int flags; // type flags
     char* string; // string value
-    double doubleval; // double value
-    int intval; // integer value.
+    union {
+        double doubleval; // double value
+        struct __cjson_index* index; // objects only, hash index over the key-values (NULL until the object grows large enough).
+        struct __cjson_vector* vector; // arrays only, contiguous pointers to the elements (NULL until the array grows large enough).
+        unsigned int keyhash[2]; // key-values only, cached hash and case-folded hash of the key (only valid while the parent is indexed).
+    };
+    long long intval; // integer value (64 bits, see cjson_unsigned).
 } cjson_value;
 
+// Reusable output buffer of cjson_stringify_to, zero-initialize it before the first use.
+typedef struct {
+    char* data; // null-terminated output (NULL until something was serialized into it).
+    size_t length; // length of the output, excluding the terminator.
+    size_t capacity; // allocated bytes.
+} cjson_buffer;
+
+// Receives serialized output in pieces, see cjson_stringify_callback. Returns 0 to stop serializing.
+typedef int (*cjson_write_callback)(void* user, const char* data, size_t len);
+
+// Iterates over the documents of newline-delimited (NDJSON) or concatenated JSON. You should never directly access the fields inside here.
+typedef struct __cjson_stream cjson_stream;
+
+// One document of a batch, see cjson_parse_batch.
+typedef struct {
+    cjson_value* value; // the parsed document (owned by the batch), NULL when it failed to parse.
+    size_t errc; // why value is NULL, cjson_error_code_ok otherwise.
+    size_t offset; // offset of the line in the input.
+    size_t length; // length of the line, excluding its newline.
+} cjson_batch_entry;
+
+// A compiled path query, see cjson_path_compile. You should never directly access the fields inside here.
+typedef struct __cjson_path cjson_path;
+
+// Incremental parser that accepts its input in arbitrary chunks. You should never directly access the fields inside here.
+typedef struct __cjson_parser cjson_parser;
+
+// Compact, read-only value (16 bytes). Nodes are stored contiguously in document order: the members of an object
+// (a key node directly followed by its value) and the elements of an array are stored inline right after the container.
+typedef struct __cjson_node {
+    unsigned int flags; // type flags, key nodes have cjson_kv set.
+    unsigned int size; // strings and keys: length, objects and arrays: amount of nodes spanned including the container itself.
+    union {
+        double doubleval; // double value
+        long long intval; // integer or boolean value, objects and arrays: amount of members or elements.
+        const char* string; // string value or key
+    };
+} cjson_node;
+
+// Owns the nodes and strings of a compact value. You should never directly access the fields inside here.
+typedef struct __cjson_compact cjson_compact;
+
+// Binary encoding of a value that can be used without parsing it, see cjson_tape_encode. You should never directly access the fields inside here.
+typedef struct __cjson_tape cjson_tape;
+
+// A read-only value inside of a tape. You should never directly access the fields inside here.
+typedef struct __cjson_tape_node cjson_tape_node;
+
+// Validated and indexed input whose values are only decoded when they are accessed. You should never directly access the fields inside here.
+typedef struct __cjson_ondemand cjson_ondemand;
+
+// A value of an on-demand document, small enough to pass around by value. Lookups that find nothing return a value
+// for which cjson_lazy_valid returns 0, every other function accepts such a value as well.
+typedef struct {
+    cjson_ondemand* doc;
+    size_t token; // index of the first token of the value
+} cjson_lazy;
+
+// A parsed document whose values are bump-allocated from large chunks owned by the document.
+// Freeing the document releases every value parsed into it at once. You should never directly access the fields inside here.
+typedef struct __cjson_document cjson_document;
+
+// Keeps parsed files around until they change, see cjson_cache_parse_file. You should never directly access the fields inside here.
+typedef struct __cjson_cache cjson_cache;
+
+// Counters of a cache, see cjson_cache_get_stats.
+typedef struct {
+    size_t hits; // lookups answered with a cached document
+    size_t misses; // lookups that parsed the file (or failed to)
+    size_t evictions; // documents dropped to stay within the budget
+    size_t entries; // documents held right now
+    size_t bytes; // memory held by those documents (see cjson_document_memory)
+} cjson_cache_stats;
+
 // Initializes cjson lib with some basic settings. It is not necessary to call this function.
 void cjson_init(cjson_settings*);
 void cjson_set_permissive(int permissive);
+void cjson_set_structural_index(int structural_index);
 
 #ifdef CJSON_ENABLE_MEMORY_LOGGING
 // Prints some basic memory statistics (maximum memory in use at a single point, and current use).
@@ -84,13 +173,154 @@ void cjson_shutdown(void);
 cjson_value* cjson_parse_file(const char* filename);
 // Parses a JSON string into a cjson_value. Returns NULL on failure.
 cjson_value* cjson_parse(const char* buffer);
+// Parses the first len bytes of buffer, which does not have to be null-terminated (i.e. a slice of a larger buffer).
+// Nothing past len is ever read. Returns NULL on failure.
+cjson_value* cjson_parse_n(const char* buffer, size_t len);
+// Same as cjson_parse and cjson_parse_n, but with the given settings (allocator, permissive), see cjson_settings_init.
+cjson_value* cjson_parse_ex(cjson_settings* settings, const char* buffer);
+cjson_value* cjson_parse_n_ex(cjson_settings* settings, const char* buffer, size_t len);
+// Parses the first len bytes of buffer like cjson_parse_n, but on several threads when the root is a large array: the
+// input is split between top-level elements, which are parsed concurrently and joined into one array (the result is the
+// same as that of cjson_parse_n). threads is the maximum amount of threads to use, 0 means one per online CPU. Input that
+// is small or not an array is parsed on the calling thread. Returns NULL on failure.
+// Every thread parses with its own copy of the settings: mem_alloc and mem_free are called from several threads at once
+// (so they must be thread-safe), and with CJSON_ENABLE_MEMORY_LOGGING memory_limit applies to each chunk on its own,
+// their usage is only added to settings->used_memory once all of them are done.
+cjson_value* cjson_parse_parallel(const char* buffer, size_t len, int threads);
+// Same as cjson_parse_parallel, but parses a file.
+cjson_value* cjson_parse_file_parallel(const char* filename, int threads);
+cjson_value* cjson_parse_parallel_ex(cjson_settings* settings, const char* buffer, size_t len, int threads);
+cjson_value* cjson_parse_file_parallel_ex(cjson_settings* settings, const char* filename, int threads);
+// Parses a mutable JSON string in place. Strings and keys of the result point into buffer (closing quotes are overwritten),
+// so buffer must outlive the returned value. Returns NULL on failure.
+cjson_value* cjson_parse_insitu(char* buffer);
+// Creates an incremental parser. Returns NULL on failure.
+cjson_parser* cjson_parser_create(void);
+// Parses the next len bytes of input. Only input that could not be parsed yet (i.e. half a string) is buffered.
+// Returns 0 once the input is known to be invalid, the parser must still be finished or freed.
+int cjson_parser_feed(cjson_parser*, const char* chunk, size_t len);
+// Signals the end of the input and frees the parser. Returns the parsed value, or NULL on failure.
+cjson_value* cjson_parser_finish(cjson_parser*);
+// Frees the parser and everything parsed so far, without finishing it.
+void cjson_parser_free(cjson_parser*);
 // Frees a cjson_value. Must always be called on the return value from cjson_parse variants.
 void cjson_free_value(cjson_value*);
+
+// Parses a JSON file into a document. Returns NULL on failure.
+cjson_document* cjson_parse_document_file(const char* filename);
+// Parses a JSON string into a document. Returns NULL on failure.
+cjson_document* cjson_parse_document(const char* buffer);
+// Same as cjson_parse_n, but parses into a document.
+cjson_document* cjson_parse_document_n(const char* buffer, size_t len);
+cjson_document* cjson_parse_document_ex(cjson_settings* settings, const char* buffer);
+cjson_document* cjson_parse_document_n_ex(cjson_settings* settings, const char* buffer, size_t len);
+// Same as cjson_parse_insitu, but parses into a document. buffer must outlive the document.
+cjson_document* cjson_parse_document_insitu(char* buffer);
+// Returns the root value of the document. It stays valid until cjson_free_document is called and must not be passed to cjson_free_value.
+cjson_value* cjson_document_root(cjson_document*);
+// Frees a document and every value in it. Values inserted into the document after parsing are freed as well.
+// Documents returned from cjson_cache_parse_file are only freed once the cache and all of their users released them.
+void cjson_free_document(cjson_document*);
+// Returns the amount of bytes held by the document (the chunks its values, strings and input are allocated from).
+size_t cjson_document_memory(cjson_document*);
+// Every distinct key of a document is stored once and shared by all of its objects. Returns the key of the document equal
+// to k, or NULL when the document never had that key. Searching the objects of the document with the returned key instead
+// of k (see cjson_search_item) matches their key-values by comparing pointers.
+const char* cjson_document_key(cjson_document* doc, const char* k);
+
+#if defined(__unix__) || defined(__APPLE__)
+/*================ Cache functions ================*/
+
+// Creates a cache of parsed files that holds at most budget bytes of documents, the least recently used are evicted
+// first. The cache can be shared by several threads.
+cjson_cache* cjson_cache_create(size_t budget);
+cjson_cache* cjson_cache_create_ex(cjson_settings* settings, size_t budget);
+// Returns the document of filename, which is only parsed (like cjson_parse_document_file) when it is not cached yet
+// or when its path, device, inode, modification time or size changed since. The document is shared with every other
+// caller and must not be modified, release it with cjson_free_document. Returns NULL on failure.
+cjson_document* cjson_cache_parse_file(cjson_cache* cache, const char* filename);
+// Copies the counters of the cache into *out.
+void cjson_cache_get_stats(cjson_cache* cache, cjson_cache_stats* out);
+// Drops every cached document, documents still in use stay valid until they are released.
+void cjson_cache_clear(cjson_cache* cache);
+// Clears and frees the cache.
+void cjson_free_cache(cjson_cache* cache);
+#endif
+
+/*================ Multiple documents ================*/
+
+// Creates a stream over the documents of buffer (the first len bytes), which may be separated by newlines or follow each
+// other directly (i.e. '{"a":1}{"b":2}' or '1 2 3'). buffer must outlive the stream. Returns NULL on failure.
+cjson_stream* cjson_stream_create(const char* buffer, size_t len);
+// Same as cjson_stream_create, but streams the documents of a file.
+cjson_stream* cjson_stream_create_file(const char* filename);
+cjson_stream* cjson_stream_create_ex(cjson_settings* settings, const char* buffer, size_t len);
+cjson_stream* cjson_stream_create_file_ex(cjson_settings* settings, const char* filename);
+// Parses the next document into *out, which must be freed with cjson_free_value. Returns 0 once no documents are left.
+// A document that fails to parse is returned as NULL (see cjson_stream_error), the stream then resumes on the next line.
+int cjson_stream_next(cjson_stream*, cjson_value** out);
+// Returns the error code of the document last returned from cjson_stream_next.
+size_t cjson_stream_error(cjson_stream*);
+// Frees the stream, documents returned from it stay valid.
+void cjson_stream_free(cjson_stream*);
+// Parses every line of NDJSON (blank lines are skipped) on up to threads threads, 0 means one per online CPU. Returns the
+// documents in input order and sets *count to their amount, a line that fails to parse only fails its own entry.
+// Returns NULL when there are no lines or allocating failed. The batch must be freed with cjson_free_batch.
+cjson_batch_entry* cjson_parse_batch(const char* buffer, size_t len, int threads, size_t* count);
+// Same as cjson_parse_batch, but parses the lines of a file.
+cjson_batch_entry* cjson_parse_batch_file(const char* filename, int threads, size_t* count);
+cjson_batch_entry* cjson_parse_batch_ex(cjson_settings* settings, const char* buffer, size_t len, int threads, size_t* count);
+cjson_batch_entry* cjson_parse_batch_file_ex(cjson_settings* settings, const char* filename, int threads, size_t* count);
+// Frees a batch and every document in it.
+void cjson_free_batch(cjson_batch_entry* batch, size_t count);
+void cjson_free_batch_ex(cjson_settings* settings, cjson_batch_entry* batch, size_t count);
+
 // Returns the current error code (if no error then cjson_error_code_ok is returned)
 int cjson_error_code(void);
 // Returns a friendlier message of the current error code.
 const char* cjson_error_string(void);
 
+// Reentrant variants: every function above that does not take a cjson_settings* uses a single global one, which makes
+// them unsafe to call from several threads at once. The functions below instead take the settings explicitly, these
+// hold the allocator, limits, permissive flag and last error (settings->errc) of whoever owns them. Threads that each
+// use their own settings share no mutable state. Values must be modified and freed with the settings they were created
+// or parsed with, documents and compact values remember theirs. The stringify functions and the encoders (tapes,
+// MessagePack and CBOR) do not use any settings and can already be called concurrently: their output goes into memory
+// from the C library (malloc/realloc), which is what cjson_buffer_free and free release.
+//
+// Fills settings with the defaults (malloc/free, not permissive).
+void cjson_settings_init(cjson_settings* settings);
+// Returns the settings used by the functions without a cjson_settings* argument.
+cjson_settings* cjson_global_settings(void);
+// Returns a friendlier message of settings->errc.
+const char* cjson_error_string_ex(cjson_settings* settings);
+cjson_value* cjson_parse_file_ex(cjson_settings* settings, const char* filename);
+cjson_value* cjson_parse_insitu_ex(cjson_settings* settings, char* buffer);
+cjson_parser* cjson_parser_create_ex(cjson_settings* settings);
+cjson_document* cjson_parse_document_file_ex(cjson_settings* settings, const char* filename);
+cjson_document* cjson_parse_document_insitu_ex(cjson_settings* settings, char* buffer);
+void cjson_free_value_ex(cjson_settings* settings, cjson_value* v);
+cjson_value* cjson_create_object_ex(cjson_settings* settings);
+cjson_value* cjson_create_array_ex(cjson_settings* settings);
+cjson_value* cjson_create_null_ex(cjson_settings* settings);
+cjson_value* cjson_create_boolean_ex(cjson_settings* settings, int value);
+cjson_value* cjson_create_int64_ex(cjson_settings* settings, long long value);
+cjson_value* cjson_create_uint64_ex(cjson_settings* settings, unsigned long long value);
+cjson_value* cjson_create_double_ex(cjson_settings* settings, double value);
+cjson_value* cjson_create_string_ex(cjson_settings* settings, const char* string);
+void cjson_set_string_ex(cjson_settings* settings, cjson_value* v, const char* str);
+void cjson_append_ex(cjson_settings* settings, cjson_value* p, cjson_value* c);
+void cjson_insert_ex(cjson_settings* settings, cjson_value* p, const char* k, cjson_value* v);
+int cjson_replace_ex(cjson_settings* settings, cjson_value* p, const char* k, cjson_value* replacement, cjson_value** old_value);
+int cjson_replaceidx_ex(cjson_settings* settings, cjson_value* p, int idx, cjson_value* replacement, cjson_value** old_value);
+int cjson_erase_ex(cjson_settings* settings, cjson_value* p, const char* k);
+int cjson_erasei_ex(cjson_settings* settings, cjson_value* p, const char* k);
+int cjson_eraseidx_ex(cjson_settings* settings, cjson_value* p, int idx);
+cjson_compact* cjson_parse_compact_ex(cjson_settings* settings, const char* buffer);
+cjson_compact* cjson_parse_compact_file_ex(cjson_settings* settings, const char* filename);
+cjson_compact* cjson_compact_from_value_ex(cjson_settings* settings, cjson_value* v);
+cjson_value* cjson_node_to_value_ex(cjson_settings* settings, cjson_node* n);
+
 // Returns a newly created empty object.
 cjson_value* cjson_create_object();
 // Returns a newly created empty array.
@@ -101,6 +331,10 @@ cjson_value* cjson_create_null();
 cjson_value* cjson_create_boolean(int value); 
 // Returns a new number value initialized to an integer value.
 cjson_value* cjson_create_int(int value);
+// Returns a new number value initialized to a 64-bit integer value.
+cjson_value* cjson_create_int64(long long value);
+// Returns a new number value initialized to an unsigned 64-bit integer value.
+cjson_value* cjson_create_uint64(unsigned long long value);
 // Returns a new number value initialized to a double value.
 cjson_value* cjson_create_double(double value);
 // Returns a new string value initialized to string (note: the string is ALWAYS copied).
@@ -114,6 +348,10 @@ int cjson_is_number(cjson_value*);
 int cjson_is_double(cjson_value*);
 // Returns 1 if the value is an integer.
 int cjson_is_integer(cjson_value*);
+// Returns 1 if the value is an integer that fits in a long long.
+int cjson_is_int64(cjson_value*);
+// Returns 1 if the value is an integer that fits in an unsigned long long (i.e. it is not negative).
+int cjson_is_uint64(cjson_value*);
 // Returns 1 if the value is an object.
 int cjson_is_object(cjson_value*);
 // Returns 1 if the value is a boolean.
@@ -124,11 +362,14 @@ int cjson_is_null(cjson_value*);
 // Returns the stringval of the value (must first check if it is string).
 const char* cjson_get_string(cjson_value*);
 
-// Returns the doubleval of the value (must first check if it is double).
+// Returns the doubleval of the value (must first check if it is a number), integers are converted.
 double cjson_get_double(cjson_value*);
 
-// Returns the intval of a value (must first check if it is integer).
+// Returns the intval of a value (must first check if it is integer), truncated to an int.
 int cjson_get_integer(cjson_value*);
+// Returns the full 64-bit intval of a value (must first check with cjson_is_int64 or cjson_is_uint64).
+long long cjson_get_int64(cjson_value*);
+unsigned long long cjson_get_uint64(cjson_value*);
 
 // Sets the stringval and appropiate types/flags.
 void cjson_set_string(cjson_value*, const char*);
@@ -136,6 +377,8 @@ void cjson_set_string(cjson_value*, const char*);
 void cjson_set_double(cjson_value*, double);
 // Sets the intval and appropiate flags for the value.
 void cjson_set_integer(cjson_value*, int);
+void cjson_set_int64(cjson_value*, long long);
+void cjson_set_uint64(cjson_value*, unsigned long long);
 
 // Returns 1 if the value is true.
 int cjson_true(cjson_value*);
@@ -154,7 +397,7 @@ void cjson_append(cjson_value* p, cjson_value* c);
 int cjson_is_array(cjson_value*);
 // returns the amount of elemnts inside the array.
 int cjson_array_length(cjson_value*);
-// returns the elment at index.
+// returns the elment at index, or NULL if index is out of range. Constant time once the array holds 8 or more elements.
 cjson_value* cjson_array_at(cjson_value*, int);
 
 /*================ Object functions ================*/
@@ -181,6 +424,251 @@ int cjson_empty(cjson_value*);
 const char* cjson_type_string(cjson_value*);
 // stringifies (serialize) the JSON value into JSON-formatted string. You must manually free the buffer if it is nonnull.
 char* cjson_stringify(cjson_value*);
+// Same as cjson_stringify, but serializes into buffer (replacing its contents). The memory of the buffer is kept
+// and reused by the next call, so serializing many values only allocates until the largest one fits. Returns 0 on failure.
+int cjson_stringify_to(cjson_value*, cjson_buffer* buffer);
+// Frees the memory held by buffer and resets it.
+void cjson_buffer_free(cjson_buffer* buffer);
+// Serializes the JSON value straight into file through a fixed-size buffer, so memory use does not depend on the
+// size of the value. Returns 0 on failure.
+int cjson_stringify_file(cjson_value*, FILE* file);
+// Same as cjson_stringify_file, but hands the output to callback in pieces.
+int cjson_stringify_callback(cjson_value*, cjson_write_callback callback, void* user);
+#if defined(__unix__) || defined(__APPLE__)
+// Same as cjson_stringify_file, but writes to a file descriptor (large strings are passed to writev without being copied).
+int cjson_stringify_fd(cjson_value*, int fd);
+#endif
+
+/*================ Path functions ================*/
+
+// Compiles a path once so that it can be evaluated against many values. Paths starting with '/' (and the empty path)
+// are JSON Pointers (RFC 6901, i.e. "/records/4/name"). Otherwise steps are separated by '>': a key, "[4]" (negative
+// indices count from the end), "*" or "[*]" for every member or element, or a slice "[1:3]" (either bound may be left
+// out). A backslash escapes the next character of a key. Returns NULL (with cjson_error_code_invalid_path) on failure.
+cjson_path* cjson_path_compile(const char* path);
+cjson_path* cjson_path_compile_ex(cjson_settings* settings, const char* path);
+// Frees a compiled path.
+void cjson_path_free(cjson_path* path);
+// Returns the first value matched by path, or NULL.
+cjson_value* cjson_path_get(cjson_path* path, cjson_value* root);
+// Stores up to max matches of path in out (in document order) and returns the amount of matches, which may be larger than max.
+size_t cjson_path_select(cjson_path* path, cjson_value* root, cjson_value** out, size_t max);
+// Compiles path, returns its first match and frees it again. Prefer cjson_path_compile for paths used more than once.
+cjson_value* cjson_search_path(cjson_value* root, const char* path);
+// Parses the first len bytes of buffer like cjson_parse_n, but only builds the values selected by paths (at most 64,
+// negative indices are not supported). Containers on the way to a selected value are kept with only the selected members
+// and elements (so elements move up when others are skipped), containers in which nothing was selected are dropped
+// (except for the root). Everything else is skipped without allocating anything,
+// only checking that brackets are balanced. Returns NULL on failure.
+cjson_value* cjson_parse_projected(const char* buffer, size_t len, cjson_path** paths, size_t count);
+cjson_value* cjson_parse_projected_ex(cjson_settings* settings, const char* buffer, size_t len, cjson_path** paths, size_t count);
+
+/*================ Compact functions ================*/
+
+// Parses a JSON string into a compact value. Returns NULL on failure.
+cjson_compact* cjson_parse_compact(const char* buffer);
+// Parses a JSON file into a compact value. Returns NULL on failure.
+cjson_compact* cjson_parse_compact_file(const char* filename);
+// Builds a compact copy of v (v is left untouched). Returns NULL on failure.
+cjson_compact* cjson_compact_from_value(cjson_value* v);
+// Returns the root node, it stays valid until cjson_free_compact is called.
+cjson_node* cjson_compact_root(cjson_compact*);
+// Returns the amount of bytes held by the compact value (nodes and strings).
+size_t cjson_compact_memory(cjson_compact*);
+// Frees a compact value and all of its nodes.
+void cjson_free_compact(cjson_compact*);
+// Builds a regular (mutable) cjson_value from n, which must be freed with cjson_free_value.
+cjson_value* cjson_node_to_value(cjson_node* n);
+
+int cjson_node_is_string(cjson_node*);
+int cjson_node_is_number(cjson_node*);
+int cjson_node_is_double(cjson_node*);
+int cjson_node_is_integer(cjson_node*);
+int cjson_node_is_object(cjson_node*);
+int cjson_node_is_array(cjson_node*);
+int cjson_node_is_boolean(cjson_node*);
+int cjson_node_is_null(cjson_node*);
+const char* cjson_node_get_string(cjson_node*);
+double cjson_node_get_double(cjson_node*);
+int cjson_node_get_integer(cjson_node*);
+long long cjson_node_get_int64(cjson_node*);
+unsigned long long cjson_node_get_uint64(cjson_node*);
+int cjson_node_true(cjson_node*);
+int cjson_node_false(cjson_node*);
+// Returns the amount of elements of an array, or keys of an object.
+int cjson_node_length(cjson_node*);
+// Returns the node following n (skipping all of its children), used to iterate siblings.
+cjson_node* cjson_node_next(cjson_node* n);
+// returns the element at index, or NULL if index is out of range.
+cjson_node* cjson_node_array_at(cjson_node*, int);
+// case-sensitive search for key k.
+cjson_node* cjson_node_search_item(cjson_node* p, const char* k);
+// case-insensitive search for key k.
+cjson_node* cjson_node_searchi_item(cjson_node* p, const char* k);
+
+/*================ Tape functions ================*/
+
+// Encodes v into buffer (replacing its contents) as a tape: the nodes of a cjson_compact followed by their strings,
+// without any pointers and with all integers stored little-endian, so a tape can be written to a file and used on any
+// machine straight from memory. Like cjson_stringify_to, the buffer is grown with realloc rather than the allocator of
+// any settings. Returns 0 on failure.
+int cjson_tape_encode(cjson_value* v, cjson_buffer* buffer);
+// Encodes v and writes the tape to filename. The file is replaced atomically, readers that still map the previous
+// tape are not affected. Returns 0 on failure.
+int cjson_tape_write_file(cjson_value* v, const char* filename);
+// Loads the tape in the first len bytes of data without copying or decoding it, data must outlive the tape. Only the
+// nodes are checked (the strings are not read), so that a damaged tape can not make the accessors read out of bounds.
+// Returns NULL (with cjson_error_code_invalid_tape) when data does not hold a tape.
+cjson_tape* cjson_tape_load(const void* data, size_t len);
+// Same as cjson_tape_load, but maps the file (or reads it when it can not be mapped) for as long as the tape lives.
+cjson_tape* cjson_tape_load_file(const char* filename);
+cjson_tape* cjson_tape_load_ex(cjson_settings* settings, const void* data, size_t len);
+cjson_tape* cjson_tape_load_file_ex(cjson_settings* settings, const char* filename);
+// Returns the root node, it stays valid until cjson_free_tape is called.
+const cjson_tape_node* cjson_tape_root(cjson_tape* tape);
+// Frees the tape (and unmaps its file).
+void cjson_free_tape(cjson_tape* tape);
+// Builds a regular cjson_value from n (and all of its children), which must be freed with cjson_free_value.
+cjson_value* cjson_tape_to_value(const cjson_tape_node* n);
+cjson_value* cjson_tape_to_value_ex(cjson_settings* settings, const cjson_tape_node* n);
+
+int cjson_tape_is_string(const cjson_tape_node* n);
+int cjson_tape_is_number(const cjson_tape_node* n);
+int cjson_tape_is_double(const cjson_tape_node* n);
+int cjson_tape_is_integer(const cjson_tape_node* n);
+int cjson_tape_is_object(const cjson_tape_node* n);
+int cjson_tape_is_array(const cjson_tape_node* n);
+int cjson_tape_is_boolean(const cjson_tape_node* n);
+int cjson_tape_is_null(const cjson_tape_node* n);
+// Returns the string (or key) inside of the tape, which is NUL-terminated, and stores its length in *len unless len is NULL.
+const char* cjson_tape_get_string(const cjson_tape_node* n, size_t* len);
+// Integers are converted when asking for a double.
+double cjson_tape_get_double(const cjson_tape_node* n);
+int cjson_tape_get_integer(const cjson_tape_node* n);
+long long cjson_tape_get_int64(const cjson_tape_node* n);
+unsigned long long cjson_tape_get_uint64(const cjson_tape_node* n);
+int cjson_tape_true(const cjson_tape_node* n);
+int cjson_tape_false(const cjson_tape_node* n);
+// Returns the amount of elements of an array, or keys of an object.
+int cjson_tape_length(const cjson_tape_node* n);
+// Returns the first child of n (the first key of an object), only valid when n is not empty.
+const cjson_tape_node* cjson_tape_first(const cjson_tape_node* n);
+// Returns the node following n (skipping all of its children), used to iterate siblings.
+const cjson_tape_node* cjson_tape_next(const cjson_tape_node* n);
+// returns the element at index, or NULL if index is out of range.
+const cjson_tape_node* cjson_tape_array_at(const cjson_tape_node* n, int i);
+// case-sensitive search for key k.
+const cjson_tape_node* cjson_tape_search_item(const cjson_tape_node* p, const char* k);
+// case-insensitive search for key k.
+const cjson_tape_node* cjson_tape_searchi_item(const cjson_tape_node* p, const char* k);
+
+/*================ MessagePack and CBOR functions ================*/
+
+// Encodes v as MessagePack or CBOR into buffer (replacing its contents, see cjson_stringify_to). Integers and lengths
+// take the smallest encoding that fits, doubles are stored in 4 bytes when that loses nothing. The buffer is grown with
+// realloc (there are no _ex variants), decoding goes through the allocator of the settings. Returns 0 on failure.
+int cjson_msgpack_encode(cjson_value* v, cjson_buffer* buffer);
+int cjson_cbor_encode(cjson_value* v, cjson_buffer* buffer);
+// Decodes the first len bytes of data, which must hold exactly one item. Binary strings are decoded as strings, and
+// integer map keys as their decimal representation. Extension types, other map keys and CBOR simple values other than
+// false/true/null/undefined fail with cjson_error_code_invalid_binary. Returns NULL on failure.
+cjson_value* cjson_msgpack_decode(const void* data, size_t len);
+cjson_value* cjson_cbor_decode(const void* data, size_t len);
+cjson_value* cjson_msgpack_decode_ex(cjson_settings* settings, const void* data, size_t len);
+cjson_value* cjson_cbor_decode_ex(cjson_settings* settings, const void* data, size_t len);
+// Same as the above, but strings and keys are not copied, they point into data (the byte following each of them is
+// overwritten with a terminator), so data must outlive the returned value. CBOR strings split into chunks are copied.
+cjson_value* cjson_msgpack_decode_insitu(void* data, size_t len);
+cjson_value* cjson_cbor_decode_insitu(void* data, size_t len);
+cjson_value* cjson_msgpack_decode_insitu_ex(cjson_settings* settings, void* data, size_t len);
+cjson_value* cjson_cbor_decode_insitu_ex(cjson_settings* settings, void* data, size_t len);
+
+/*================ On-demand functions ================*/
+
+// Validates the first len bytes of buffer and indexes its structure, without building any values. Values are only
+// decoded when they are accessed, and skipping over a container costs a single jump. buffer must outlive the document.
+// Input containing comments, or larger than 4 GB, is not supported. Returns NULL on failure.
+cjson_ondemand* cjson_parse_ondemand(const char* buffer, size_t len);
+// Same as cjson_parse_ondemand, but for a file which is mapped (or read) for as long as the document lives.
+cjson_ondemand* cjson_parse_ondemand_file(const char* filename);
+cjson_ondemand* cjson_parse_ondemand_ex(cjson_settings* settings, const char* buffer, size_t len);
+cjson_ondemand* cjson_parse_ondemand_file_ex(cjson_settings* settings, const char* filename);
+// Returns the root value, it stays valid until cjson_free_ondemand is called.
+cjson_lazy cjson_ondemand_root(cjson_ondemand*);
+// Frees the document (and its index).
+void cjson_free_ondemand(cjson_ondemand*);
+// Builds a regular cjson_value from v (and all of its children), which must be freed with cjson_free_value.
+// Containers a permissive document left open are closed at the end of the input here as well.
+cjson_value* cjson_lazy_to_value(cjson_lazy v);
+cjson_value* cjson_lazy_to_value_ex(cjson_settings* settings, cjson_lazy v);
+
+// Returns 1 if v refers to a value.
+int cjson_lazy_valid(cjson_lazy v);
+int cjson_lazy_is_string(cjson_lazy v);
+int cjson_lazy_is_number(cjson_lazy v);
+int cjson_lazy_is_double(cjson_lazy v);
+int cjson_lazy_is_integer(cjson_lazy v);
+int cjson_lazy_is_object(cjson_lazy v);
+int cjson_lazy_is_array(cjson_lazy v);
+int cjson_lazy_is_boolean(cjson_lazy v);
+int cjson_lazy_is_null(cjson_lazy v);
+// Returns the (still escaped, not NUL-terminated) string inside of the buffer and stores its length in *len.
+const char* cjson_lazy_get_string(cjson_lazy v, size_t* len);
+// Numbers are decoded on every call, integers are converted when asking for a double.
+double cjson_lazy_get_double(cjson_lazy v);
+int cjson_lazy_get_integer(cjson_lazy v);
+long long cjson_lazy_get_int64(cjson_lazy v);
+unsigned long long cjson_lazy_get_uint64(cjson_lazy v);
+int cjson_lazy_true(cjson_lazy v);
+int cjson_lazy_false(cjson_lazy v);
+// Returns the amount of elements of an array, or keys of an object (both walk the container).
+int cjson_lazy_array_length(cjson_lazy v);
+int cjson_lazy_object_size(cjson_lazy v);
+// returns the element at index, or an invalid value if index is out of range.
+cjson_lazy cjson_lazy_array_at(cjson_lazy v, int index);
+// case-sensitive search for key k.
+cjson_lazy cjson_lazy_search_item(cjson_lazy p, const char* k);
+// case-insensitive search for key k.
+cjson_lazy cjson_lazy_searchi_item(cjson_lazy p, const char* k);
+// Returns the first element of an array or the value of the first member of an object, used to iterate children.
+cjson_lazy cjson_lazy_first(cjson_lazy v);
+// Returns the element or member value following v in its container.
+cjson_lazy cjson_lazy_next(cjson_lazy v);
+// Returns the key of an object member value (like cjson_lazy_get_string), NULL when v is not one.
+const char* cjson_lazy_key(cjson_lazy v, size_t* len);
+
+/*================ Event (SAX) functions ================*/
+
+// Returned from the callbacks of a cjson_sax_handler.
+typedef enum {
+    cjson_sax_continue = 0,
+    cjson_sax_skip, // from on_start_object/on_start_array: skip the container (no end event), from on_key: skip the value.
+    cjson_sax_abort, // stop parsing, cjson_sax_parse then fails with cjson_error_code_aborted.
+} cjson_sax_result;
+
+// Callbacks invoked while parsing, any of them may be NULL. Strings and keys are views into the parsed buffer
+// (still escaped, not NUL-terminated) which are only valid as long as the buffer is.
+typedef struct {
+    cjson_sax_result (*on_start_object)(void* user);
+    cjson_sax_result (*on_end_object)(void* user);
+    cjson_sax_result (*on_start_array)(void* user);
+    cjson_sax_result (*on_end_array)(void* user);
+    cjson_sax_result (*on_key)(void* user, const char* key, size_t len);
+    cjson_sax_result (*on_string)(void* user, const char* str, size_t len);
+    cjson_sax_result (*on_integer)(void* user, long long value);
+    cjson_sax_result (*on_double)(void* user, double value);
+    cjson_sax_result (*on_boolean)(void* user, int value);
+    cjson_sax_result (*on_null)(void* user);
+    cjson_sax_result (*on_uint64)(void* user, unsigned long long value); // integers above LLONG_MAX, reported to on_double when NULL.
+} cjson_sax_handler;
+
+// Parses a JSON string, reporting every value to handler instead of building a tree. Skipped containers are only
+// checked for balanced brackets. Returns 1 on success, 0 on failure.
+int cjson_sax_parse(const char* buffer, const cjson_sax_handler* handler, void* user);
+// Same as cjson_sax_parse, but parses the first len bytes of buffer which does not have to be null-terminated.
+int cjson_sax_parse_n(const char* buffer, size_t len, const cjson_sax_handler* handler, void* user);
+int cjson_sax_parse_ex(cjson_settings* settings, const char* buffer, const cjson_sax_handler* handler, void* user);
+int cjson_sax_parse_n_ex(cjson_settings* settings, const char* buffer, size_t len, const cjson_sax_handler* handler, void* user);
 
 #define CJSON_UNUSED(x) (void)(x)
 
@@ -201,4 +689,46 @@ char* cjson_stringify(cjson_value*);
         iter_##array = iter_##array->next; \
     }
 
+#define CJSON_NODE_OBJECT_FOR_EACH(object, k, v, body) cjson_node* iter_##object = object + 1; \
+    for (int left_##object = object->intval; left_##object > 0; --left_##object, iter_##object = cjson_node_next(iter_##object + 1)) { \
+        const char* k = iter_##object->string; \
+        cjson_node* v = iter_##object + 1; \
+		CJSON_UNUSED(k); \
+		CJSON_UNUSED(v); \
+        body \
+    }
+
+#define CJSON_NODE_ARRAY_FOR_EACH(array, v, body) cjson_node* iter_##array = array + 1; \
+    for (int left_##array = array->intval; left_##array > 0; --left_##array, iter_##array = cjson_node_next(iter_##array)) { \
+        cjson_node* v = iter_##array; \
+        body \
+    }
+
+#define CJSON_LAZY_OBJECT_FOR_EACH(object, k, v, body) for (cjson_lazy v = cjson_lazy_first(object); cjson_lazy_valid(v); v = cjson_lazy_next(v)) { \
+        size_t k##_len; \
+        const char* k = cjson_lazy_key(v, &k##_len); \
+		CJSON_UNUSED(k); \
+		CJSON_UNUSED(k##_len); \
+        body \
+    }
+
+#define CJSON_LAZY_ARRAY_FOR_EACH(array, v, body) for (cjson_lazy v = cjson_lazy_first(array); cjson_lazy_valid(v); v = cjson_lazy_next(v)) { \
+        body \
+    }
+
+#define CJSON_TAPE_OBJECT_FOR_EACH(object, k, v, body) for (const cjson_tape_node* iter_##object = cjson_tape_first(object), *end_##object = cjson_tape_next(object); \
+        iter_##object != end_##object; iter_##object = cjson_tape_next(cjson_tape_next(iter_##object))) { \
+        size_t k##_len; \
+        const char* k = cjson_tape_get_string(iter_##object, &k##_len); \
+        const cjson_tape_node* v = cjson_tape_next(iter_##object); \
+		CJSON_UNUSED(k); \
+		CJSON_UNUSED(k##_len); \
+		CJSON_UNUSED(v); \
+        body \
+    }
+
+#define CJSON_TAPE_ARRAY_FOR_EACH(array, v, body) for (const cjson_tape_node* v = cjson_tape_first(array), *end_##array = cjson_tape_next(array); v != end_##array; v = cjson_tape_next(v)) { \
+        body \
+    }
+
 #endif
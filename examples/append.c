@@ -0,0 +1,66 @@
+#include "cjson/cjson.h"
+#include <stdio.h>
+
+// Allocation of this many bytes fails once, so that an array loses its element vector while it grows.
+size_t fail_size = 0;
+
+void* failing_alloc(size_t size)
+{
+	if (size == fail_size) {
+		fail_size = 0;
+		return NULL;
+	}
+	return malloc(size);
+}
+
+// Appends count ints and checks that each of them can be found by its index.
+int append_and_check(cjson_settings* settings, int count)
+{
+	cjson_value* arr = cjson_create_array_ex(settings);
+	if (!arr) {
+		fprintf(stderr, "Failed to create array: %s\n", cjson_error_string());
+		return 0;
+	}
+
+	for (int i = 0; i < count; ++i) {
+		cjson_append_ex(settings, arr, cjson_create_int64_ex(settings, i * 10));
+		for (int j = 0; j <= i; ++j) {
+			cjson_value* e = cjson_array_at(arr, j);
+			if (!e || cjson_get_int64(e) != j * 10) {
+				fprintf(stderr, "Element %d is wrong after %d appends\n", j, i + 1);
+				return 0;
+			}
+		}
+	}
+
+	if (cjson_array_length(arr) != count || cjson_array_at(arr, count) != NULL) {
+		fprintf(stderr, "Array of %d elements has length %d\n", count, cjson_array_length(arr));
+		return 0;
+	}
+
+	cjson_free_value_ex(settings, arr);
+	return 1;
+}
+
+int main()
+{
+	cjson_settings settings;
+	cjson_settings_init(&settings);
+
+	// Past 8 elements arrays are indexed through a vector, which grows at 16, 32 and 64 elements.
+	if (!append_and_check(&settings, 100)) {
+		return 1;
+	}
+	printf("Appended 100 elements\n");
+
+	// When the vector cannot grow from 16 to 32 elements it is dropped, and rebuilt large enough on the next append.
+	settings.mem_alloc = failing_alloc;
+	fail_size = sizeof(size_t) + 32 * sizeof(cjson_value*);
+	if (!append_and_check(&settings, 40) || fail_size != 0) {
+		return 1;
+	}
+	printf("Appended 40 elements while the vector could not grow once\n");
+
+	cjson_shutdown();
+	return 0;
+}
@@ -0,0 +1,132 @@
+#include "cjson/cjson.h"
+#include <stdio.h>
+#include <string.h>
+
+// Checks that decoded (which is freed) is written as expected, where NULL means decoding must have failed.
+int check(const char* what, cjson_value* decoded, const char* expected)
+{
+	char* buf = decoded ? cjson_stringify(decoded) : NULL;
+	int ok = expected ? buf && strcmp(buf, expected) == 0 : !decoded && cjson_error_code() == cjson_error_code_invalid_binary;
+	if (!ok) {
+		fprintf(stderr, "%s gave %s, expected %s\n", what, buf ? buf : cjson_error_string(), expected ? expected : "an error");
+	}
+	free(buf);
+	cjson_free_value(decoded);
+	return ok;
+}
+
+// Returns 1 when str points into the len bytes at data.
+int points_into(const char* str, const void* data, size_t len)
+{
+	return str >= (const char*)data && str < (const char*)data + len;
+}
+
+// Builds depth nested single-element arrays around null.
+size_t nest(unsigned char* out, int depth, unsigned char array1, unsigned char null)
+{
+	memset(out, array1, depth);
+	out[depth] = null;
+	return depth + 1;
+}
+
+int main()
+{
+	cjson_value* obj = cjson_parse("{\"name\":\"Oskar\",\"scores\":[1,-2,3.5,1e3,18446744073709551615],\"nested\":{\"ok\":true,\"none\":null}}");
+	if (!obj) {
+		fprintf(stderr, "Failed to parse: %s\n", cjson_error_string());
+		return 1;
+	}
+	char* expected = cjson_stringify(obj);
+
+	cjson_buffer msgpack = { 0 };
+	cjson_buffer cbor = { 0 };
+	if (!cjson_msgpack_encode(obj, &msgpack) || !cjson_cbor_encode(obj, &cbor)) {
+		fprintf(stderr, "Failed to encode: %s\n", cjson_error_string());
+		return 1;
+	}
+	if (!check("MessagePack round trip", cjson_msgpack_decode(msgpack.data, msgpack.length), expected)
+		|| !check("CBOR round trip", cjson_cbor_decode(cbor.data, cbor.length), expected)) {
+		return 1;
+	}
+	printf("Round trip through %zu bytes of MessagePack and %zu bytes of CBOR: %s\n", msgpack.length, cbor.length, expected);
+
+	// Decoding in place borrows strings and keys from the input instead of copying them.
+	char* frame = malloc(msgpack.length);
+	memcpy(frame, msgpack.data, msgpack.length);
+	cjson_value* borrowed = cjson_msgpack_decode_insitu(frame, msgpack.length);
+	cjson_value* name = cjson_search_item(borrowed, "name");
+	if (!name || strcmp(cjson_get_string(name), "Oskar") != 0 || !points_into(cjson_get_string(name), frame, msgpack.length)
+		|| !points_into(borrowed->child->string, frame, msgpack.length)) {
+		fprintf(stderr, "Strings decoded in place were copied\n");
+		return 1;
+	}
+	if (!check("MessagePack in place", borrowed, expected)) {
+		return 1;
+	}
+	free(frame);
+
+	// CBOR strings sent in chunks can not be borrowed, they are joined into a copy.
+	unsigned char chunked[] = { 0xa1, 0x61, 'k', 0x7f, 0x62, 'a', 'b', 0x61, 'c', 0xff };
+	borrowed = cjson_cbor_decode_insitu(chunked, sizeof(chunked));
+	name = cjson_search_item(borrowed, "k");
+	if (!name || points_into(cjson_get_string(name), chunked, sizeof(chunked)) || !points_into(borrowed->child->string, chunked, sizeof(chunked))) {
+		fprintf(stderr, "Chunked string was borrowed, or its key was not\n");
+		return 1;
+	}
+	if (!check("CBOR chunked string in place", borrowed, "{\"k\":\"abc\"}")) {
+		return 1;
+	}
+	printf("Strings decoded in place are borrowed\n");
+
+	// Integer map keys become their decimal representation, other keys are rejected.
+	const unsigned char msgpack_keys[] = { 0x82, 0x01, 0xa1, 'a', 0xfe, 0xc3 };
+	const unsigned char cbor_keys[] = { 0xa2, 0x01, 0x61, 'a', 0x21, 0xf5 };
+	const unsigned char cbor_array_key[] = { 0xa1, 0x80, 0x01 };
+	if (!check("MessagePack integer keys", cjson_msgpack_decode(msgpack_keys, sizeof(msgpack_keys)), "{\"1\":\"a\",\"-2\":true}")
+		|| !check("CBOR integer keys", cjson_cbor_decode(cbor_keys, sizeof(cbor_keys)), "{\"1\":\"a\",\"-2\":true}")
+		|| !check("CBOR array key", cjson_cbor_decode(cbor_array_key, sizeof(cbor_array_key)), NULL)) {
+		return 1;
+	}
+	printf("Integer map keys are decoded as strings\n");
+
+	// Half-precision floats (including subnormals and infinity, which is written as null) and MessagePack's singles.
+	const unsigned char halves[] = { 0x83, 0xf9, 0x3e, 0x00, 0xf9, 0x00, 0x01, 0xf9, 0xfc, 0x00 };
+	const unsigned char single[] = { 0xca, 0x3f, 0xc0, 0x00, 0x00 };
+	const unsigned char extension[] = { 0xd4, 0x01, 0x00 };
+	if (!check("CBOR half floats", cjson_cbor_decode(halves, sizeof(halves)), "[1.5,5.960464477539063e-8,null]")
+		|| !check("MessagePack single float", cjson_msgpack_decode(single, sizeof(single)), "1.5")
+		|| !check("MessagePack extension", cjson_msgpack_decode(extension, sizeof(extension)), NULL)) {
+		return 1;
+	}
+	printf("Half and single precision floats are decoded\n");
+
+	// Indefinite-length CBOR arrays and maps end at a break, which must be there.
+	const unsigned char indefinite[] = { 0x9f, 0x01, 0x9f, 0xff, 0xbf, 0x61, 'k', 0x02, 0xff, 0xff };
+	const unsigned char unterminated[] = { 0x9f, 0x01, 0x02 };
+	const unsigned char stray_break[] = { 0x82, 0x01, 0xff };
+	if (!check("CBOR indefinite containers", cjson_cbor_decode(indefinite, sizeof(indefinite)), "[1,[],{\"k\":2}]")
+		|| !check("CBOR unterminated array", cjson_cbor_decode(unterminated, sizeof(unterminated)), NULL)
+		|| !check("CBOR stray break", cjson_cbor_decode(stray_break, sizeof(stray_break)), NULL)) {
+		return 1;
+	}
+	printf("Indefinite-length CBOR is decoded\n");
+
+	// Nesting is limited to 512 levels, so that hostile input can not exhaust the stack.
+	unsigned char deep[520];
+	size_t len = nest(deep, 512, 0x91, 0xc0);
+	cjson_value* v = cjson_msgpack_decode(deep, len);
+	if (!v || cjson_msgpack_decode(deep, nest(deep, 513, 0x91, 0xc0)) || cjson_error_code() != cjson_error_code_invalid_binary
+		|| cjson_cbor_decode(deep, nest(deep, 513, 0x81, 0xf6)) || cjson_error_code() != cjson_error_code_invalid_binary) {
+		fprintf(stderr, "Nesting limit was not applied at 512 levels\n");
+		return 1;
+	}
+	cjson_free_value(v);
+	printf("Nesting deeper than 512 levels is rejected: %s\n", cjson_error_string());
+
+	free(expected);
+	cjson_buffer_free(&msgpack);
+	cjson_buffer_free(&cbor);
+	cjson_free_value(obj);
+	cjson_shutdown();
+	return 0;
+}
@@ -0,0 +1,106 @@
+#include "cjson/cjson.h"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+char dir[] = "/tmp/cjson_cache_XXXXXX";
+
+// Writes text to name inside of dir and sets its modification time, returns the full path in path.
+int write_file(char* path, const char* name, const char* text, time_t mtime)
+{
+	snprintf(path, 64, "%s/%s", dir, name);
+	FILE* f = fopen(path, "w");
+	if (!f) {
+		return 0;
+	}
+	fputs(text, f);
+	fclose(f);
+	struct timespec times[2] = { { mtime, 0 }, { mtime, 0 } };
+	return utimensat(AT_FDCWD, path, times, 0) == 0;
+}
+
+// Compares the counters of cache, returns 1 when they are as expected.
+int expect(cjson_cache* cache, const char* what, size_t hits, size_t misses, size_t evictions, size_t entries)
+{
+	cjson_cache_stats stats;
+	cjson_cache_get_stats(cache, &stats);
+	if (stats.hits != hits || stats.misses != misses || stats.evictions != evictions || stats.entries != entries) {
+		fprintf(stderr, "%s: %zu hits, %zu misses, %zu evictions and %zu entries, expected %zu, %zu, %zu and %zu\n", what,
+			stats.hits, stats.misses, stats.evictions, stats.entries, hits, misses, evictions, entries);
+		return 0;
+	}
+	return 1;
+}
+
+const char* name_of(cjson_document* doc)
+{
+	return cjson_get_string(cjson_search_item(cjson_document_root(doc), "name"));
+}
+
+int main()
+{
+	char a[64], b[64], c[64];
+	if (!mkdtemp(dir) || !write_file(a, "a.json", "{\"name\":\"a\"}", 1000) || !write_file(b, "b.json", "{\"name\":\"b\"}", 1000)
+		|| !write_file(c, "c.json", "{\"name\":\"c\"}", 1000)) {
+		fprintf(stderr, "Failed to write the files\n");
+		return 1;
+	}
+
+	// The second lookup is answered with the same document.
+	cjson_cache* cache = cjson_cache_create(1 << 20);
+	cjson_document* first = cjson_cache_parse_file(cache, a);
+	cjson_document* second = cjson_cache_parse_file(cache, a);
+	if (!first || first != second || !expect(cache, "Looking up a twice", 1, 1, 0, 1)) {
+		return 1;
+	}
+	printf("The second lookup is a hit\n");
+
+	// Rewriting the file (with the same size) and only changing its modification time parses it again,
+	// while the old document stays valid for as long as it is used.
+	if (!write_file(a, "a.json", "{\"name\":\"A\"}", 2000)) {
+		return 1;
+	}
+	cjson_document* changed = cjson_cache_parse_file(cache, a);
+	if (!changed || changed == first || strcmp(name_of(changed), "A") != 0 || strcmp(name_of(first), "a") != 0
+		|| !expect(cache, "Looking up a after it changed", 1, 2, 0, 1)) {
+		fprintf(stderr, "The changed file was not parsed again\n");
+		return 1;
+	}
+	printf("A changed file is parsed again: %s\n", name_of(changed));
+	size_t one = cjson_document_memory(changed);
+	cjson_free_document(first);
+	cjson_free_document(second);
+	cjson_free_document(changed);
+	cjson_free_cache(cache);
+
+	// With room for two documents, the least recently used one is evicted.
+	cache = cjson_cache_create(one * 2 + one / 2);
+	cjson_free_document(cjson_cache_parse_file(cache, a));
+	cjson_free_document(cjson_cache_parse_file(cache, b));
+	cjson_free_document(cjson_cache_parse_file(cache, a));
+	cjson_free_document(cjson_cache_parse_file(cache, c)); // evicts b, a was used after it
+	if (!expect(cache, "Filling the cache", 1, 3, 1, 2)) {
+		return 1;
+	}
+	cjson_free_document(cjson_cache_parse_file(cache, a));
+	cjson_free_document(cjson_cache_parse_file(cache, b)); // evicts c
+	if (!expect(cache, "Looking up a and b again", 2, 4, 2, 2)) {
+		return 1;
+	}
+	printf("The least recently used document is evicted\n");
+
+	// Files that can not be parsed are misses that are not cached.
+	if (cjson_cache_parse_file(cache, "/nonexistent/file.json") || !expect(cache, "Looking up a missing file", 2, 5, 2, 2)) {
+		return 1;
+	}
+	cjson_free_cache(cache);
+
+	unlink(a);
+	unlink(b);
+	unlink(c);
+	rmdir(dir);
+	cjson_shutdown();
+	return 0;
+}
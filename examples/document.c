@@ -0,0 +1,26 @@
+#include "cjson/cjson.h"
+#include <stdio.h>
+
+int main()
+{
+	cjson_document* doc = cjson_parse_document("{ \"pi\": 3.14, \"list\": [1, 2, 3] }");
+	if (!doc) {
+		fprintf(stderr, "Failed to parse: %s\n", cjson_error_string());
+		return 1;
+	}
+
+	cjson_value* root = cjson_document_root(doc);
+
+	// Values can still be inserted, they are freed together with the document.
+	cjson_append(cjson_search_item(root, "list"), cjson_create_int(4));
+	cjson_insert(root, "name", cjson_create_string("Oskar"));
+
+	char* buf = cjson_stringify(root);
+	printf("Document: %s\n", buf);
+	free(buf);
+
+	// Never call cjson_free_value on the root of a document.
+	cjson_free_document(doc);
+	cjson_shutdown();
+	return 0;
+}
@@ -0,0 +1,64 @@
+#include "cjson/cjson.h"
+#include <stdio.h>
+#include <string.h>
+
+// Parses input with the default and the structural index engine, which must give the same value or the same error.
+// Returns the error code (cjson_error_code_ok when parsed), or -1 when the engines disagree.
+int parse_with_both(const char* input)
+{
+	cjson_settings settings[2];
+	cjson_value* parsed[2];
+	char* written[2];
+	for (int i = 0; i < 2; ++i) {
+		cjson_settings_init(&settings[i]);
+		settings[i].structural_index = i;
+		parsed[i] = cjson_parse_ex(&settings[i], input);
+		written[i] = parsed[i] ? cjson_stringify(parsed[i]) : NULL;
+	}
+
+	int same = parsed[0] && parsed[1] ? strcmp(written[0], written[1]) == 0 : !parsed[0] && !parsed[1] && settings[0].errc == settings[1].errc;
+	int result = same ? (int)settings[0].errc : -1;
+	if (!same) {
+		fprintf(stderr, "Engines disagree on %s: %s (%zu) vs %s (%zu)\n", input,
+			written[0] ? written[0] : "NULL", settings[0].errc, written[1] ? written[1] : "NULL", settings[1].errc);
+	}
+
+	for (int i = 0; i < 2; ++i) {
+		free(written[i]);
+		cjson_free_value_ex(&settings[i], parsed[i]);
+	}
+	return result;
+}
+
+int main()
+{
+	const struct {
+		const char* input;
+		int errc;
+	} cases[] = {
+		{ "{\"name\":\"Z\xc3\xbcrich\",\"city\":\"\xe6\x9d\xb1\xe4\xba\xac\",\"emoji\":\"\xf0\x9f\x98\x80\"}", cjson_error_code_ok },
+		{ "[\"\xff\"]", cjson_error_code_syntax_invalid_utf8 }, // not UTF-8 at all
+		{ "{\"\xc0\xaf\":1}", cjson_error_code_syntax_invalid_utf8 }, // overlong '/', in a key
+		{ "[\"\xed\xa0\x80\"]", cjson_error_code_syntax_invalid_utf8 }, // surrogate
+		{ "[\"\xf4\x90\x80\x80\"]", cjson_error_code_syntax_invalid_utf8 }, // above U+10FFFF
+		{ "[\"cut \xe2\x82\"]", cjson_error_code_syntax_invalid_utf8 }, // sequence cut short by the closing quote
+		{ "[1, \xff]", cjson_error_code_syntax_unexpected_character }, // outside of strings it is just a bad token
+		{ "[1,, \"\xff\"]", cjson_error_code_syntax_unexpected_comma }, // the first error is reported
+		{ "// \xff comments are not checked\n[1]", cjson_error_code_ok },
+		{ "[1, 2", cjson_error_code_syntax_unclosed_value },
+		{ "{\"a\" 1}", cjson_error_code_syntax_expected_colon },
+		{ "[1.2.3]", cjson_error_code_syntax_invalid_number },
+	};
+
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+		int errc = parse_with_both(cases[i].input);
+		if (errc != cases[i].errc) {
+			fprintf(stderr, "Case %zu gave %d, expected %d\n", i, errc, cases[i].errc);
+			return 1;
+		}
+	}
+	printf("Both engines agree on %zu inputs\n", sizeof(cases) / sizeof(cases[0]));
+
+	cjson_shutdown();
+	return 0;
+}
@@ -0,0 +1,82 @@
+#include "cjson/cjson.h"
+#include <stdio.h>
+#include <string.h>
+
+// Returns 1 when every member called name of the objects in array holds the very pointer key.
+int shares_key(cjson_value* array, const char* name, const char* key)
+{
+	int found = 0;
+	CJSON_ARRAY_FOR_EACH(array, element, {
+		CJSON_OBJECT_FOR_EACH(element, k, v, {
+			if (strcmp(k, name) == 0) {
+				if (k != key) {
+					return 0;
+				}
+				++found;
+			}
+		});
+	});
+	return found > 0;
+}
+
+// Parses input into a document with the given engine and checks that its keys are stored once.
+int check(const char* input, int structural_index)
+{
+	cjson_settings settings;
+	cjson_settings_init(&settings);
+	settings.structural_index = structural_index;
+	cjson_document* doc = cjson_parse_document_ex(&settings, input);
+	if (!doc) {
+		fprintf(stderr, "Failed to parse: %s\n", cjson_error_string());
+		return 0;
+	}
+
+	cjson_value* root = cjson_document_root(doc);
+	const char* id = cjson_document_key(doc, "id");
+	const char* name = cjson_document_key(doc, "name");
+	if (!id || !name || strcmp(id, "id") != 0 || id == name || cjson_document_key(doc, "missing") != NULL
+		|| !shares_key(root, "id", id) || !shares_key(root, "name", name)) {
+		fprintf(stderr, "Keys of the document are not shared (engine %d)\n", structural_index);
+		return 0;
+	}
+
+	// Searching with the returned key matches the key-values by their pointer, in small and in indexed objects.
+	cjson_value* last = cjson_array_at(root, cjson_array_length(root) - 1);
+	cjson_value* first = cjson_array_at(root, 0);
+	if (cjson_get_integer(cjson_search_item(first, id)) != 1 || cjson_get_integer(cjson_search_item(last, id)) != 3
+		|| cjson_get_integer(cjson_search_item(last, cjson_document_key(doc, "k16"))) != 16) {
+		fprintf(stderr, "Searching with a document key failed (engine %d)\n", structural_index);
+		return 0;
+	}
+
+	// Inserting into an object of the document reuses the key it already holds.
+	cjson_insert(first, "name", cjson_create_string("again"));
+	if (!shares_key(root, "name", name)) {
+		fprintf(stderr, "Inserting copied the key (engine %d)\n", structural_index);
+		return 0;
+	}
+
+	cjson_free_document(doc);
+	return 1;
+}
+
+int main()
+{
+	const char* input = "[{\"id\":1,\"name\":\"a\"},{\"name\":\"b\",\"id\":2},"
+		"{\"id\":3,\"name\":\"c\",\"k1\":1,\"k2\":2,\"k3\":3,\"k4\":4,\"k5\":5,\"k6\":6,\"k7\":7,\"k8\":8,\"k9\":9,\"k10\":10,\"k11\":11,\"k12\":12,\"k13\":13,\"k14\":14,\"k15\":15,\"k16\":16}]";
+	if (!check(input, 0) || !check(input, 1)) {
+		return 1;
+	}
+	printf("Every key of a document is stored once, with both engines\n");
+
+	// Documents without objects (and no document at all) have no keys.
+	cjson_document* doc = cjson_parse_document("[1,2,3]");
+	if (!doc || cjson_document_key(doc, "id") != NULL || cjson_document_key(NULL, "id") != NULL) {
+		fprintf(stderr, "A document without objects returned a key\n");
+		return 1;
+	}
+	cjson_free_document(doc);
+
+	cjson_shutdown();
+	return 0;
+}
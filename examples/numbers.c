@@ -24,6 +24,14 @@ int main()
 	});
 	printf("\n");
 
+	// Any number can be read as a double, integers (also those above LLONG_MAX) are converted.
+	cjson_value* big = cjson_parse("18446744073709551615");
+	if (!big || cjson_get_double(cjson_array_at(arr, 5)) != -10.0 || cjson_get_double(big) != 18446744073709551615.0) {
+		fprintf(stderr, "Integers were not converted to doubles\n");
+		return 1;
+	}
+	cjson_free_value(big);
+
 	cjson_free_value(arr);
 	cjson_shutdown();
 	return 0;
@@ -0,0 +1,105 @@
+#include "cjson/cjson.h"
+#include <stdio.h>
+#include <string.h>
+
+// Returns 1 when the len bytes at str are exactly expected.
+int equals(const char* str, size_t len, const char* expected)
+{
+	return str && len == strlen(expected) && memcmp(str, expected, len) == 0;
+}
+
+// Checks that v is materialized as expected.
+int check(const char* what, cjson_lazy v, const char* expected)
+{
+	cjson_value* value = cjson_lazy_to_value(v);
+	char* buf = value ? cjson_stringify(value) : NULL;
+	int ok = buf && strcmp(buf, expected) == 0;
+	if (!ok) {
+		fprintf(stderr, "%s gave %s, expected %s\n", what, buf ? buf : "NULL", expected);
+	}
+	free(buf);
+	cjson_free_value(value);
+	return ok;
+}
+
+int main()
+{
+	const char* input = "{\"name\":\"Oskar\",\"skipped\":{\"deep\":[[1,2],{\"a\":\"} ]\"}]},\"ids\":[10,20,30],\"ratio\":0.5}";
+	cjson_ondemand* doc = cjson_parse_ondemand(input, strlen(input));
+	if (!doc) {
+		fprintf(stderr, "Failed to parse: %s\n", cjson_error_string());
+		return 1;
+	}
+	cjson_lazy root = cjson_ondemand_root(doc);
+
+	// Walking the members with next jumps over every container, and key gives the name of each one.
+	const char* keys[] = { "name", "skipped", "ids", "ratio" };
+	int count = 0;
+	for (cjson_lazy v = cjson_lazy_first(root); cjson_lazy_valid(v); v = cjson_lazy_next(v), ++count) {
+		size_t len;
+		const char* key = cjson_lazy_key(v, &len);
+		if (count >= 4 || !equals(key, len, keys[count])) {
+			fprintf(stderr, "Member %d has the key %.*s\n", count, key ? (int)len : 4, key ? key : "NULL");
+			return 1;
+		}
+	}
+	if (count != 4 || cjson_lazy_object_size(root) != 4) {
+		fprintf(stderr, "Walked %d members, expected 4\n", count);
+		return 1;
+	}
+	printf("Walked the %d members of the root\n", count);
+
+	// Array elements have no key, and next past the last one is invalid (as is everything derived from it).
+	cjson_lazy ids = cjson_lazy_search_item(root, "ids");
+	cjson_lazy last = cjson_lazy_next(cjson_lazy_next(cjson_lazy_first(ids)));
+	size_t len = 0;
+	if (cjson_lazy_get_integer(last) != 30 || cjson_lazy_key(last, &len) != NULL
+		|| cjson_lazy_valid(cjson_lazy_next(last)) || cjson_lazy_valid(cjson_lazy_next(cjson_lazy_next(last)))) {
+		fprintf(stderr, "Iterating the array went wrong\n");
+		return 1;
+	}
+
+	// Lookups that find nothing can still be passed to every accessor.
+	cjson_lazy missing = cjson_lazy_search_item(cjson_lazy_search_item(root, "nothing"), "here");
+	if (cjson_lazy_valid(missing) || cjson_lazy_get_integer(missing) != 0 || cjson_lazy_get_string(missing, &len) != NULL
+		|| cjson_lazy_valid(cjson_lazy_array_at(ids, 3)) || cjson_lazy_key(missing, &len) != NULL) {
+		fprintf(stderr, "A missing value was not handled\n");
+		return 1;
+	}
+
+	const char* name = cjson_lazy_get_string(cjson_lazy_search_item(root, "name"), &len);
+	if (!equals(name, len, "Oskar") || name < input || name >= input + strlen(input)
+		|| cjson_lazy_get_double(cjson_lazy_search_item(root, "ratio")) != 0.5 || cjson_lazy_get_double(cjson_lazy_array_at(ids, 1)) != 20.0
+		|| !check("The skipped member", cjson_lazy_search_item(root, "skipped"), "{\"deep\":[[1,2],{\"a\":\"} ]\"}]}")) {
+		return 1;
+	}
+	printf("Found %.*s without copying it\n", (int)len, name);
+	cjson_free_ondemand(doc);
+
+	// Containers left open at the end are an error, unless parsing is permissive, which closes them all there.
+	const char* unclosed = "{\"a\":[1,2,{\"b\":true";
+	if (cjson_parse_ondemand(unclosed, strlen(unclosed)) || cjson_error_code() != cjson_error_code_syntax_unclosed_value) {
+		fprintf(stderr, "Unclosed input was accepted\n");
+		return 1;
+	}
+	cjson_settings settings;
+	cjson_settings_init(&settings);
+	settings.permissive = 1;
+	doc = cjson_parse_ondemand_ex(&settings, unclosed, strlen(unclosed));
+	if (!doc) {
+		fprintf(stderr, "Failed to parse permissively: %s\n", cjson_error_string());
+		return 1;
+	}
+	root = cjson_ondemand_root(doc);
+	cjson_lazy a = cjson_lazy_search_item(root, "a");
+	if (cjson_lazy_array_length(a) != 3 || !cjson_lazy_true(cjson_lazy_search_item(cjson_lazy_array_at(a, 2), "b"))
+		|| cjson_lazy_valid(cjson_lazy_next(a)) || !check("Unclosed input", root, "{\"a\":[1,2,{\"b\":true}]}")) {
+		fprintf(stderr, "Permissive parsing did not close the containers at the end\n");
+		return 1;
+	}
+	printf("Permissive parsing closes what is left open\n");
+	cjson_free_ondemand(doc);
+
+	cjson_shutdown();
+	return 0;
+}
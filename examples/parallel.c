@@ -0,0 +1,82 @@
+#include "cjson/cjson.h"
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+// The allocator is called from every parsing thread at once, so it has to be thread-safe.
+pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_t main_thread;
+size_t other_thread_allocations = 0;
+
+void* counting_alloc(size_t size)
+{
+	if (!pthread_equal(pthread_self(), main_thread)) {
+		pthread_mutex_lock(&lock);
+		++other_thread_allocations;
+		pthread_mutex_unlock(&lock);
+	}
+	return malloc(size);
+}
+
+int main()
+{
+	// Several megabytes of records whose strings are full of the characters the input is split at.
+	const int records = 100000;
+	size_t cap = (size_t)records * 128;
+	char* input = malloc(cap);
+	size_t len = 0;
+	input[len++] = '[';
+	for (int i = 0; i < records; ++i) {
+		len += snprintf(input + len, cap - len, "%s{\"id\":%d,\"text\":\"a, b], [c {\\\"d\\\": %d}\",\"tags\":[\"x,y\",[%d,\"]\"]]}",
+			i ? ",\n" : "", i, i, i % 7);
+	}
+	input[len++] = ']';
+
+	cjson_value* serial = cjson_parse_n(input, len);
+	if (!serial) {
+		fprintf(stderr, "Failed to parse: %s\n", cjson_error_string());
+		return 1;
+	}
+
+	cjson_settings settings;
+	cjson_settings_init(&settings);
+	settings.mem_alloc = counting_alloc;
+	main_thread = pthread_self();
+	cjson_value* parallel = cjson_parse_parallel_ex(&settings, input, len, 4);
+	if (!parallel) {
+		fprintf(stderr, "Failed to parse on several threads: %s\n", cjson_error_string());
+		return 1;
+	}
+
+	// The joined result is the same array, and its elements can still be reached by index.
+	char* expected = cjson_stringify(serial);
+	char* buf = cjson_stringify(parallel);
+	if (!expected || !buf || strcmp(buf, expected) != 0 || cjson_array_length(parallel) != records
+		|| cjson_get_int64(cjson_search_item(cjson_array_at(parallel, records - 1), "id")) != records - 1) {
+		fprintf(stderr, "Parsing on several threads gave a different result\n");
+		return 1;
+	}
+	printf("Parsed %d records (%zu bytes) on several threads, the same as on one\n", records, len);
+	if (other_thread_allocations == 0) {
+		fprintf(stderr, "Nothing was allocated on another thread\n");
+		return 1;
+	}
+	printf("%zu allocations were made on other threads\n", other_thread_allocations);
+
+	// An error in any chunk fails the whole parse.
+	memcpy(strstr(input + len / 2, "\"id\""), "\"id\"::", 6);
+	cjson_value* broken = cjson_parse_parallel(input, len, 4);
+	if (broken) {
+		fprintf(stderr, "Input with an error in the middle was accepted\n");
+		return 1;
+	}
+	printf("An error in one chunk fails the parse: %s\n", cjson_error_string());
+
+	free(buf);
+	free(expected);
+	cjson_free_value_ex(&settings, parallel);
+	cjson_free_value(serial);
+	free(input);
+	cjson_shutdown();
+	return 0;
+}
@@ -0,0 +1,62 @@
+#include "cjson/cjson.h"
+#include <stdio.h>
+#include <string.h>
+
+// Feeds input to an incremental parser chunk bytes at a time, as if it arrived from a socket.
+cjson_value* parse_in_chunks(const char* input, size_t len, size_t chunk)
+{
+	cjson_parser* parser = cjson_parser_create();
+	if (!parser) {
+		return NULL;
+	}
+
+	for (size_t ofs = 0; ofs < len; ofs += chunk) {
+		size_t n = len - ofs < chunk ? len - ofs : chunk;
+		if (!cjson_parser_feed(parser, input + ofs, n)) {
+			break; // Invalid input, cjson_parser_finish returns NULL.
+		}
+	}
+
+	return cjson_parser_finish(parser);
+}
+
+int main()
+{
+	const char* input = "{\"name\":\"Oskar\",\"scores\":[1,-2,3.5,1e3],\"nested\":{\"ok\":true,\"none\":null},\"text\":\"split across chunks\"}";
+	size_t len = strlen(input);
+
+	cjson_value* whole = cjson_parse(input);
+	if (!whole) {
+		fprintf(stderr, "Failed to parse: %s\n", cjson_error_string());
+		return 1;
+	}
+	char* expected = cjson_stringify(whole);
+
+	// Every chunk size gives the same result as parsing all of the input at once, even when tokens are split.
+	for (size_t chunk = 1; chunk <= len; ++chunk) {
+		cjson_value* parsed = parse_in_chunks(input, len, chunk);
+		char* buf = parsed ? cjson_stringify(parsed) : NULL;
+		if (!buf || strcmp(buf, expected) != 0) {
+			fprintf(stderr, "Chunks of %zu bytes gave %s\n", chunk, buf ? buf : cjson_error_string());
+			return 1;
+		}
+		free(buf);
+		cjson_free_value(parsed);
+	}
+	printf("Parsed in chunks: %s\n", expected);
+
+	// Input that ends early is rejected once the parser is finished.
+	for (size_t cut = 1; cut < len; ++cut) {
+		cjson_value* parsed = parse_in_chunks(input, cut, 7);
+		if (parsed) {
+			fprintf(stderr, "Truncated input of %zu bytes was accepted\n", cut);
+			return 1;
+		}
+	}
+	printf("Truncated input is rejected: %s\n", cjson_error_string());
+
+	free(expected);
+	cjson_free_value(whole);
+	cjson_shutdown();
+	return 0;
+}
@@ -0,0 +1,41 @@
+#include "cjson/cjson.h"
+#include <stdio.h>
+
+int main()
+{
+    cjson_value* obj = cjson_parse("{ \"shows\": [ { \"number\": 4680, \"questions\": [ \"a\", \"b\", \"c\" ] }, { \"number\": 4681, \"questions\": [ \"d\" ] } ] }");
+    if (!obj) {
+        fprintf(stderr, "Failed to parse: %s\n", cjson_error_string());
+        return -1;
+    }
+
+    // Compiled once, evaluated as often as needed.
+    cjson_path* numbers = cjson_path_compile("shows>*>number");
+    cjson_path* last = cjson_path_compile("/shows/0/questions/2");
+    if (!numbers || !last) {
+        fprintf(stderr, "Failed to compile path: %s\n", cjson_error_string());
+        return -1;
+    }
+
+    cjson_value* matches[8];
+    size_t count = cjson_path_select(numbers, obj, matches, 8);
+    for (size_t i = 0; i < count && i < 8; ++i) {
+        printf("Show number: %d\n", cjson_get_integer(matches[i]));
+    }
+
+    cjson_value* question = cjson_path_get(last, obj);
+    if (question) {
+        printf("Last question of the first show: %s\n", cjson_get_string(question));
+    }
+
+    cjson_value* first = cjson_search_path(obj, "shows>[-1]>questions>[0]");
+    if (first) {
+        printf("First question of the last show: %s\n", cjson_get_string(first));
+    }
+
+    cjson_path_free(numbers);
+    cjson_path_free(last);
+    cjson_free_value(obj);
+    cjson_shutdown();
+    return 0;
+}
@@ -0,0 +1,63 @@
+#include "cjson/cjson.h"
+#include <stdio.h>
+#include <string.h>
+
+// Parses input keeping only what the given paths (separated by spaces, at most 4) select, and compares the result.
+int expect(const char* input, const char* paths, const char* expected)
+{
+	cjson_path* compiled[4];
+	size_t count = 0;
+	char steps[128];
+	snprintf(steps, sizeof(steps), "%s", paths);
+	for (char* path = strtok(steps, " "); path && count < 4; path = strtok(NULL, " ")) {
+		compiled[count] = cjson_path_compile(path);
+		if (!compiled[count++]) {
+			fprintf(stderr, "Failed to compile %s: %s\n", path, cjson_error_string());
+			return 0;
+		}
+	}
+
+	cjson_value* projected = cjson_parse_projected(input, strlen(input), compiled, count);
+	char* buf = projected ? cjson_stringify(projected) : NULL;
+	int ok = buf && strcmp(buf, expected) == 0;
+	if (!ok) {
+		fprintf(stderr, "Projecting %s over %s gave %s, expected %s\n", paths, input, buf ? buf : cjson_error_string(), expected);
+	}
+
+	free(buf);
+	cjson_free_value(projected);
+	for (size_t i = 0; i < count; ++i) {
+		cjson_path_free(compiled[i]);
+	}
+	return ok;
+}
+
+int main()
+{
+	const char* record = "{\"id\":1,\"blob\":[\"} ]\",{\"x\":[1,2,3]}],\"ts\":99,\"payload\":{\"user\":\"u1\",\"body\":{\"big\":true}}}";
+	if (!expect(record, "id ts payload>user", "{\"id\":1,\"ts\":99,\"payload\":{\"user\":\"u1\"}}")) {
+		return 1;
+	}
+	printf("Projected the id, ts and user out of a record\n");
+
+	// Containers in which nothing was selected are dropped, those at which a path ends are kept whole (even when empty).
+	if (!expect("{\"a\":[],\"b\":{\"y\":1},\"c\":{\"z\":2},\"d\":{\"y\":{\"q\":[]}}}", "*>y", "{\"b\":{\"y\":1},\"d\":{\"y\":{\"q\":[]}}}")
+		|| !expect("{\"e\":[],\"f\":{},\"g\":1}", "e f", "{\"e\":[],\"f\":{}}")
+		|| !expect("{\"items\":[{\"v\":1},{\"w\":2},[],{\"v\":3}]}", "items>[*]>v", "{\"items\":[{\"v\":1},{\"v\":3}]}")
+		|| !expect("{\"deep\":{\"er\":{\"est\":[]}}}", "deep>er>est>[0]", "{}")
+		|| !expect("[{},{\"v\":1},{},{},{\"v\":2},{},{},{},{},{},{\"v\":3},{}]", "[*]>v", "[{\"v\":1},{\"v\":2},{\"v\":3}]")) {
+		return 1;
+	}
+	printf("Containers without a selected value are dropped\n");
+
+	// Selected elements move up when others are skipped, and the root is kept even when nothing was selected.
+	if (!expect("[0,[1,2],3,4]", "[1] [3]", "[[1,2],4]")
+		|| !expect("[0,1,2,3,4]", "[1:3]", "[1,2]")
+		|| !expect("{\"a\":1}", "missing", "{}")) {
+		return 1;
+	}
+	printf("Selected elements move up, the root always stays\n");
+
+	cjson_shutdown();
+	return 0;
+}
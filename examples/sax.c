@@ -0,0 +1,128 @@
+#include "cjson/cjson.h"
+#include <stdio.h>
+#include <string.h>
+
+// Writes every event to a log, and skips or aborts at the keys it is told to.
+typedef struct {
+	char log[512];
+	const char* skip_key;
+	const char* abort_key;
+	int skip_arrays;
+} recorder;
+
+void record(recorder* r, const char* event, const char* text, size_t len)
+{
+	size_t used = strlen(r->log);
+	snprintf(r->log + used, sizeof(r->log) - used, used ? " %s%.*s" : "%s%.*s", event, (int)len, text);
+}
+
+int key_is(const char* key, size_t len, const char* name)
+{
+	return name && strlen(name) == len && memcmp(key, name, len) == 0;
+}
+
+cjson_sax_result on_start_object(void* user) { record(user, "{", "", 0); return cjson_sax_continue; }
+cjson_sax_result on_end_object(void* user) { record(user, "}", "", 0); return cjson_sax_continue; }
+cjson_sax_result on_end_array(void* user) { record(user, "]", "", 0); return cjson_sax_continue; }
+cjson_sax_result on_string(void* user, const char* str, size_t len) { record(user, "s:", str, len); return cjson_sax_continue; }
+cjson_sax_result on_boolean(void* user, int value) { record(user, value ? "true" : "false", "", 0); return cjson_sax_continue; }
+cjson_sax_result on_null(void* user) { record(user, "null", "", 0); return cjson_sax_continue; }
+
+cjson_sax_result on_start_array(void* user)
+{
+	recorder* r = user;
+	record(r, "[", "", 0);
+	return r->skip_arrays ? cjson_sax_skip : cjson_sax_continue;
+}
+
+cjson_sax_result on_key(void* user, const char* key, size_t len)
+{
+	recorder* r = user;
+	record(r, "k:", key, len);
+	if (key_is(key, len, r->abort_key)) {
+		return cjson_sax_abort;
+	}
+	return key_is(key, len, r->skip_key) ? cjson_sax_skip : cjson_sax_continue;
+}
+
+cjson_sax_result on_integer(void* user, long long value)
+{
+	char digits[32];
+	record(user, "i:", digits, snprintf(digits, sizeof(digits), "%lld", value));
+	return cjson_sax_continue;
+}
+
+cjson_sax_result on_double(void* user, double value)
+{
+	char digits[32];
+	record(user, "d:", digits, snprintf(digits, sizeof(digits), "%g", value));
+	return cjson_sax_continue;
+}
+
+// Parses input with the recorder and compares its log, returns 1 when both the result and the log are as expected.
+int expect(const cjson_sax_handler* handler, recorder* r, const char* input, int ok, const char* log)
+{
+	r->log[0] = 0;
+	int parsed = cjson_sax_parse(input, handler, r);
+	if (parsed != ok || strcmp(r->log, log) != 0) {
+		fprintf(stderr, "Parsing %s returned %d (%s) and logged\n  %s\nexpected\n  %s\n", input, parsed, cjson_error_string(), r->log, log);
+		return 0;
+	}
+	return 1;
+}
+
+int main()
+{
+	cjson_sax_handler handler = { 0 };
+	handler.on_start_object = on_start_object;
+	handler.on_end_object = on_end_object;
+	handler.on_start_array = on_start_array;
+	handler.on_end_array = on_end_array;
+	handler.on_key = on_key;
+	handler.on_string = on_string;
+	handler.on_integer = on_integer;
+	handler.on_double = on_double;
+	handler.on_boolean = on_boolean;
+	handler.on_null = on_null;
+
+	const char* input = "{\"id\":7,\"payload\":{\"text\":\"} ] {\",\"list\":[1,[2]]},\"tags\":[\"a\",null],\"big\":18446744073709551615,\"ok\":true}";
+	recorder r = { "", NULL, NULL, 0 };
+
+	// Every value is reported in order, integers above LLONG_MAX go to on_double as on_uint64 is not set.
+	if (!expect(&handler, &r, input, 1, "{ k:id i:7 k:payload { k:text s:} ] { k:list [ i:1 [ i:2 ] ] } k:tags [ s:a null ] k:big d:1.84467e+19 k:ok true }")) {
+		return 1;
+	}
+	printf("Events: %s\n", r.log);
+
+	// Skipping at a key passes over its whole value, brackets inside of strings included.
+	r.skip_key = "payload";
+	if (!expect(&handler, &r, input, 1, "{ k:id i:7 k:payload k:tags [ s:a null ] k:big d:1.84467e+19 k:ok true }")) {
+		return 1;
+	}
+
+	// Skipping at the start of a container reports neither its contents nor its end.
+	r.skip_key = NULL;
+	r.skip_arrays = 1;
+	if (!expect(&handler, &r, "{\"a\":[1,[2]],\"b\":{\"c\":[3]},\"d\":4}", 1, "{ k:a [ k:b { k:c [ } k:d i:4 }")) {
+		return 1;
+	}
+	printf("Skipped: %s\n", r.log);
+
+	// Aborting stops at once and fails the parse.
+	r.skip_arrays = 0;
+	r.abort_key = "tags";
+	if (!expect(&handler, &r, input, 0, "{ k:id i:7 k:payload { k:text s:} ] { k:list [ i:1 [ i:2 ] ] } k:tags") || cjson_error_code() != cjson_error_code_aborted) {
+		return 1;
+	}
+	printf("Aborted: %s\n", cjson_error_string());
+
+	// A skipped container that is never closed is still an error.
+	r.abort_key = NULL;
+	r.skip_key = "payload";
+	if (!expect(&handler, &r, "{\"payload\":{\"a\":[1}", 0, "{ k:payload") || cjson_error_code() != cjson_error_code_syntax_unclosed_value) {
+		return 1;
+	}
+
+	cjson_shutdown();
+	return 0;
+}
@@ -0,0 +1,121 @@
+#include "cjson/cjson.h"
+#include <stdio.h>
+#include <string.h>
+
+// Damages a copy of the tape by storing value (little-endian) at field of node, a node is 16 bytes: its flags,
+// the amount of nodes it spans and its payload (for strings the offset of the characters, relative to the node).
+// Returns 1 when the damaged tape is rejected as invalid.
+int rejects_damage(const cjson_buffer* buffer, const cjson_tape_node* node, size_t field, unsigned int value)
+{
+	char* copy = malloc(buffer->length);
+	memcpy(copy, buffer->data, buffer->length);
+	unsigned char* p = (unsigned char*)copy + ((const char*)node - buffer->data) + field;
+	for (int i = 0; i < 4; ++i) {
+		p[i] = (unsigned char)(value >> (i * 8));
+	}
+
+	cjson_tape* tape = cjson_tape_load(copy, buffer->length);
+	int rejected = !tape && cjson_error_code() == cjson_error_code_invalid_tape;
+	cjson_free_tape(tape);
+	free(copy);
+	return rejected;
+}
+
+int main()
+{
+	cjson_value* obj = cjson_parse("{\"shows\":[{\"number\":4680,\"air_date\":\"2004-12-31\"},{\"number\":4681,\"air_date\":\"2005-01-03\"}],\"final\":true}");
+	if (!obj) {
+		fprintf(stderr, "Failed to parse: %s\n", cjson_error_string());
+		return 1;
+	}
+	char* expected = cjson_stringify(obj);
+
+	cjson_buffer buffer = { 0 };
+	if (!cjson_tape_encode(obj, &buffer)) {
+		fprintf(stderr, "Failed to encode: %s\n", cjson_error_string());
+		return 1;
+	}
+
+	// The tape is used straight from the buffer, nothing is decoded.
+	cjson_tape* tape = cjson_tape_load(buffer.data, buffer.length);
+	if (!tape) {
+		fprintf(stderr, "Failed to load: %s\n", cjson_error_string());
+		return 1;
+	}
+
+	const cjson_tape_node* root = cjson_tape_root(tape);
+	const cjson_tape_node* shows = cjson_tape_search_item(root, "shows");
+	CJSON_TAPE_ARRAY_FOR_EACH(shows, show, {
+		CJSON_TAPE_OBJECT_FOR_EACH(show, key, value, {
+			if (cjson_tape_is_string(value)) {
+				printf("%.*s: %s\n", (int)key_len, key, cjson_tape_get_string(value, NULL));
+			}
+			else {
+				printf("%.*s: %lld\n", (int)key_len, key, cjson_tape_get_int64(value));
+			}
+		})
+	})
+
+	// Converting the tape back gives the original value.
+	cjson_value* back = cjson_tape_to_value(root);
+	char* buf = back ? cjson_stringify(back) : NULL;
+	if (!buf || strcmp(buf, expected) != 0) {
+		fprintf(stderr, "Round trip gave %s\n", buf ? buf : cjson_error_string());
+		return 1;
+	}
+	printf("Round trip: %s\n", buf);
+	free(buf);
+	cjson_free_value(back);
+
+	// Nodes are found in the buffer itself, as the tape was not copied.
+	const cjson_tape_node* first_show = cjson_tape_array_at(shows, 0);
+	const cjson_tape_node* air_date = cjson_tape_search_item(first_show, "air_date");
+	const cjson_tape_node* final_key = cjson_tape_next(cjson_tape_next(cjson_tape_first(root)));
+
+	// Damage is rejected when loading, so that the accessors never read out of bounds.
+	if (!rejects_damage(&buffer, shows, 4, 1000)) {
+		fprintf(stderr, "An array spanning past its object was accepted\n");
+		return 1;
+	}
+	if (!rejects_damage(&buffer, first_show, 4, 2)) {
+		fprintf(stderr, "An object spanning fewer nodes than its members was accepted\n");
+		return 1;
+	}
+	if (!rejects_damage(&buffer, air_date, 8, (unsigned int)buffer.length)) {
+		fprintf(stderr, "A string past the end of the tape was accepted\n");
+		return 1;
+	}
+	if (!rejects_damage(&buffer, air_date, 8, 0)) {
+		fprintf(stderr, "A string among the nodes was accepted\n");
+		return 1;
+	}
+	if (!rejects_damage(&buffer, final_key, 0, cjson_string)) {
+		fprintf(stderr, "A string where a key belongs was accepted\n");
+		return 1;
+	}
+	if (cjson_tape_load(buffer.data, buffer.length - 1)) {
+		fprintf(stderr, "A truncated tape was accepted\n");
+		return 1;
+	}
+	printf("Damaged tapes are rejected: %s\n", cjson_error_string());
+	cjson_free_tape(tape);
+
+	// Tapes written to a file are mapped when they are loaded.
+	if (!cjson_tape_write_file(obj, "example.tape") || !(tape = cjson_tape_load_file("example.tape"))) {
+		fprintf(stderr, "Failed to write or load example.tape: %s\n", cjson_error_string());
+		return 1;
+	}
+	if (!cjson_tape_true(cjson_tape_search_item(cjson_tape_root(tape), "final"))) {
+		fprintf(stderr, "Tape loaded from file lost \"final\"\n");
+		return 1;
+	}
+	printf("Loaded from file, %d shows\n", cjson_tape_length(cjson_tape_search_item(cjson_tape_root(tape), "shows")));
+	cjson_free_tape(tape);
+	remove("example.tape");
+
+	free(expected);
+	cjson_buffer_free(&buffer);
+	cjson_free_value(obj);
+	cjson_shutdown();
+	return 0;
+}